@@ -0,0 +1,253 @@
+// benchmark/Workload.h - 基准测试使用的随机数、key 分布、负载定义与延迟直方图
+#pragma once
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace bench {
+
+// xorshift64*：每个线程持有一个实例。glibc 的 rand() 内部有一把全局锁，
+// 多线程调用时自身就是争用点，会污染测得的吞吐
+class FastRandom {
+ public:
+  explicit FastRandom(std::uint64_t seed) : state_(mix(seed) | 1) {}
+
+  std::uint64_t next() {
+    state_ ^= state_ >> 12;
+    state_ ^= state_ << 25;
+    state_ ^= state_ >> 27;
+    return state_ * 0x2545F4914F6CDD1DULL;
+  }
+
+  // [0, n) 内的整数，n 远小于 2^64 时取模带来的偏差可以忽略
+  std::uint64_t uniform(std::uint64_t n) { return next() % n; }
+
+  // [0, 1) 内的浮点数
+  double next_double() {
+    return static_cast<double>(next() >> 11) * 0x1.0p-53;
+  }
+
+  // splitmix64 的终结函数，也用于把 Zipfian 的名次打散到整个 key 空间
+  static std::uint64_t mix(std::uint64_t x) {
+    x += 0x9E3779B97F4A7C15ULL;
+    x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+    return x ^ (x >> 31);
+  }
+
+ private:
+  std::uint64_t state_;
+};
+
+// YCSB 使用的 Zipfian 生成器（Gray et al., "Quickly Generating Billion-Record
+// Synthetic Databases"）：返回 [0, n) 内的名次，名次 0 最热。
+// 构造时计算 zeta(n)，为 O(n)；next 不修改状态，可被多个线程共享
+class ZipfianGenerator {
+ public:
+  explicit ZipfianGenerator(std::uint64_t n, double theta = 0.99)
+      : n_(std::max<std::uint64_t>(n, 1)), theta_(theta) {
+    zeta_n_ = zeta(n_, theta_);
+    double zeta2 = zeta(2, theta_);
+    alpha_ = 1.0 / (1.0 - theta_);
+    eta_ = (1.0 - std::pow(2.0 / static_cast<double>(n_), 1.0 - theta_)) /
+           (1.0 - zeta2 / zeta_n_);
+    half_pow_theta_ = 1.0 + std::pow(0.5, theta_);
+  }
+
+  std::uint64_t next(FastRandom& rng) const {
+    double u = rng.next_double();
+    double uz = u * zeta_n_;
+    if (uz < 1.0) return 0;
+    if (uz < half_pow_theta_) return 1;
+    auto rank = static_cast<std::uint64_t>(
+        static_cast<double>(n_) * std::pow(eta_ * u - eta_ + 1.0, alpha_));
+    return std::min(rank, n_ - 1);
+  }
+
+ private:
+  static double zeta(std::uint64_t n, double theta) {
+    double sum = 0;
+    for (std::uint64_t i = 1; i <= n; ++i) {
+      sum += 1.0 / std::pow(static_cast<double>(i), theta);
+    }
+    return sum;
+  }
+
+  std::uint64_t n_;
+  double theta_;
+  double zeta_n_ = 0;
+  double alpha_ = 0;
+  double eta_ = 0;
+  double half_pow_theta_ = 0;
+};
+
+enum class Distribution {
+  kUniform,     // 均匀分布
+  kZipfian,     // Zipfian，热点 key 经哈希打散到整个 key 空间
+  kSequential,  // 每个线程从各自的起点按 key 顺序访问
+  kLatest,      // Zipfian，越新插入的 key 越热（YCSB D）
+};
+
+inline const char* distribution_name(Distribution d) {
+  switch (d) {
+    case Distribution::kUniform:
+      return "uniform";
+    case Distribution::kZipfian:
+      return "zipfian";
+    case Distribution::kSequential:
+      return "sequential";
+    case Distribution::kLatest:
+      return "latest";
+  }
+  return "?";
+}
+
+// 按分布选出下一个 key 的编号，每个线程一个实例
+class KeyChooser {
+ public:
+  KeyChooser(Distribution dist, const ZipfianGenerator* zipf,
+             std::uint64_t cursor)
+      : dist_(dist), zipf_(zipf), cursor_(cursor) {}
+
+  // count 为当前已有的 key 数，返回 [0, count) 内的编号
+  std::uint64_t next(FastRandom& rng, std::uint64_t count) {
+    switch (dist_) {
+      case Distribution::kUniform:
+        return rng.uniform(count);
+      case Distribution::kZipfian:
+        return FastRandom::mix(zipf_->next(rng)) % count;
+      case Distribution::kSequential:
+        return cursor_++ % count;
+      case Distribution::kLatest:
+        // 生成器按装载时的 key 数构造，后续插入只占少数，名次超出时回绕
+        return count - 1 - zipf_->next(rng) % count;
+    }
+    return 0;
+  }
+
+ private:
+  Distribution dist_;
+  const ZipfianGenerator* zipf_;
+  std::uint64_t cursor_;
+};
+
+enum class Op { kRead, kUpdate, kInsert, kScan, kReadModifyWrite };
+
+// YCSB 风格的读写比例，各项之和为 1
+struct Workload {
+  const char* name;
+  const char* description;
+  double read;
+  double update;
+  double insert;
+  double scan;
+  double read_modify_write;
+  bool latest;  // 读请求是否偏向最近插入的 key
+
+  Op choose(double u) const {
+    if (u < read) return Op::kRead;
+    u -= read;
+    if (u < update) return Op::kUpdate;
+    u -= update;
+    if (u < insert) return Op::kInsert;
+    u -= insert;
+    if (u < scan) return Op::kScan;
+    return Op::kReadModifyWrite;
+  }
+};
+
+inline const std::vector<Workload>& ycsb_workloads() {
+  static const std::vector<Workload> workloads = {
+      {"a", "50% read / 50% update", 0.5, 0.5, 0, 0, 0, false},
+      {"b", "95% read / 5% update", 0.95, 0.05, 0, 0, 0, false},
+      {"c", "100% read", 1.0, 0, 0, 0, 0, false},
+      {"d", "95% read latest / 5% insert", 0.95, 0, 0.05, 0, 0, true},
+      {"e", "95% scan / 5% insert", 0, 0, 0.05, 0.95, 0, false},
+      {"f", "50% read / 50% read-modify-write", 0.5, 0, 0, 0, 0.5, false},
+  };
+  return workloads;
+}
+
+// 对数-线性分桶的延迟直方图（单位 ns）：每个 2 的幂区间再均分为 16 个桶，
+// 相对误差不超过 1/16，覆盖整个 uint64 范围只需 976 个桶。
+// 每个线程记录自己的直方图，结束后合并，记录路径上没有同步
+class LatencyHistogram {
+ public:
+  static constexpr int kSubBits = 4;
+  static constexpr std::uint64_t kSub = 1ULL << kSubBits;
+  static constexpr std::size_t kBuckets = (64 - kSubBits + 1) * kSub;
+
+  LatencyHistogram() : counts_(kBuckets, 0) {}
+
+  void record(std::uint64_t ns) {
+    ++counts_[index(ns)];
+    ++count_;
+    sum_ += ns;
+    max_ = std::max(max_, ns);
+  }
+
+  void merge(const LatencyHistogram& other) {
+    for (std::size_t i = 0; i < kBuckets; ++i) counts_[i] += other.counts_[i];
+    count_ += other.count_;
+    sum_ += other.sum_;
+    max_ = std::max(max_, other.max_);
+  }
+
+  std::uint64_t count() const { return count_; }
+  std::uint64_t max() const { return max_; }
+  double mean() const {
+    return count_ == 0 ? 0.0 : static_cast<double>(sum_) / count_;
+  }
+
+  // 第 q 分位（0 < q <= 1）所在桶的上界，不超过记录到的最大值
+  std::uint64_t percentile(double q) const {
+    if (count_ == 0) return 0;
+    auto target = static_cast<std::uint64_t>(
+        std::ceil(q * static_cast<double>(count_)));
+    target = std::clamp<std::uint64_t>(target, 1, count_);
+    std::uint64_t seen = 0;
+    for (std::size_t i = 0; i < kBuckets; ++i) {
+      seen += counts_[i];
+      if (seen >= target) return std::min(upper_bound(i), max_);
+    }
+    return max_;
+  }
+
+ private:
+  static std::size_t index(std::uint64_t v) {
+    if (v < kSub) return static_cast<std::size_t>(v);
+    int exp = std::bit_width(v) - 1;
+    std::uint64_t sub = (v >> (exp - kSubBits)) & (kSub - 1);
+    return static_cast<std::size_t>((exp - kSubBits + 1) * kSub + sub);
+  }
+
+  static std::uint64_t upper_bound(std::size_t i) {
+    if (i < kSub) return i;
+    int exp = static_cast<int>(i / kSub) + kSubBits - 1;
+    std::uint64_t lower = (kSub + i % kSub) << (exp - kSubBits);
+    return lower + (1ULL << (exp - kSubBits)) - 1;
+  }
+
+  std::vector<std::uint64_t> counts_;
+  std::uint64_t count_ = 0;
+  std::uint64_t sum_ = 0;
+  std::uint64_t max_ = 0;
+};
+
+// 固定长度的 key："k" 后接补零的十进制编号，字典序与编号顺序一致。
+// 复用调用方的缓冲区，长度不超过 SSO 容量时不分配内存
+inline void format_key(std::uint64_t id, std::size_t key_size,
+                       std::string& out) {
+  out.assign(key_size, '0');
+  out[0] = 'k';
+  for (std::size_t i = key_size; i > 1 && id != 0; --i) {
+    out[i - 1] = static_cast<char>('0' + id % 10);
+    id /= 10;
+  }
+}
+
+}  // namespace bench
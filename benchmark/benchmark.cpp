@@ -0,0 +1,502 @@
+/**
+ * benchmark.cpp - SkipList / KVStore 基准测试
+ *
+ * 对每种组合（引擎 × key 分布 × 线程数 × 负载）：
+ * 1. 新建引擎，多线程装载 records 条记录（输出为 load 行）；
+ * 2. 按 YCSB A–F 的读写比例执行 ops 次操作。
+ * 每次操作单独计时，输出吞吐与 p50 / p99 / p999 / max 延迟。
+ * 随机数为每个线程独立的 xorshift，不使用带全局锁的 rand()。
+ * 以 -DSKIPLIST_METRICS=ON 构建并传入 --metrics 时，最后输出全部运行
+ * 累计的分阶段耗时（见 Metrics.h），如插入的加锁 / 查找 / 分配 / 链接。
+ *
+ * 用法示例：
+ *   ./skiplist_bench --engine=skiplist,skiplist-dist --threads=1,4,16 \
+ *       --workload=a,b,c,e --dist=uniform,zipfian --value-size=100
+ * --help 列出全部参数
+ */
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <memory>
+#include <numeric>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "DistributedSharedMutex.h"
+#include "KVStore.h"
+#include "LockFreeSkipList.h"
+#include "Metrics.h"
+#include "SkipList.h"
+#include "Workload.h"
+
+namespace {
+
+using Key = std::string;
+using Value = std::string;
+using Clock = std::chrono::steady_clock;
+
+// key 都以 'k' 开头，"l" 大于所有 key，作为 scan 的右边界
+const Key kScanEnd = "l";
+
+struct Config {
+  std::vector<std::string> engines = {"skiplist"};
+  std::vector<std::string> workloads = {"a", "b", "c"};
+  std::vector<bench::Distribution> dists = {bench::Distribution::kUniform,
+                                            bench::Distribution::kZipfian};
+  std::vector<int> threads;
+  std::uint64_t records = 100000;
+  std::uint64_t ops = 1000000;
+  std::size_t key_size = 16;
+  std::size_t value_size = 100;
+  std::size_t scan_length = 100;  // scan 的条数在 [1, scan_length] 内均匀选取
+  std::size_t shards = 16;        // kvstore 引擎的分片数
+  double zipf_theta = 0.99;
+  std::string dir = "/tmp";       // kvstore 引擎的快照目录
+  bool csv = false;
+  bool metrics = false;  // 最后输出 Metrics.h 的分阶段耗时
+};
+
+// ---------- 被测引擎 ----------
+// 统一为 get / put / scan 三个操作，scan 返回访问的条数
+
+template <typename List>
+class SkipListEngine {
+ public:
+  static constexpr bool kSupportsScan = true;
+
+  explicit SkipListEngine(const Config&) {}
+
+  bool get(const Key& key, Value& value) {
+    return list_.search_element(key, value);
+  }
+  void put(const Key& key, const Value& value) {
+    list_.insert_element(key, value);
+  }
+  std::size_t scan(const Key& key, std::size_t limit) {
+    return list_.scan(key, kScanEnd, limit,
+                      [](const Key&, const Value&) { return true; });
+  }
+
+ private:
+  List list_;
+};
+
+class LockFreeEngine {
+ public:
+  static constexpr bool kSupportsScan = false;
+
+  explicit LockFreeEngine(const Config&) {}
+
+  bool get(const Key& key, Value& value) {
+    return list_.search_element(key, value);
+  }
+  void put(const Key& key, const Value& value) {
+    list_.insert_element(key, value);
+  }
+  std::size_t scan(const Key&, std::size_t) { return 0; }
+
+ private:
+  LockFreeSkipList<Key, Value> list_;
+};
+
+// 快照文件放在 config.dir 下，析构前清空，避免析构时的 dump 计入测量之外的耗时
+class KVStoreEngine {
+ public:
+  static constexpr bool kSupportsScan = true;
+
+  explicit KVStoreEngine(const Config& config)
+      : path_(make_path(config)), store_(path_, make_options(config)) {}
+
+  ~KVStoreEngine() {
+    store_.clear();
+    store_.wait_dump();
+  }
+
+  bool get(const Key& key, Value& value) { return store_.get(key, value); }
+  void put(const Key& key, const Value& value) { store_.put(key, value); }
+  std::size_t scan(const Key& key, std::size_t limit) {
+    return store_.scan(key, kScanEnd, limit,
+                       [](const Key&, const Value&) { return true; });
+  }
+
+  static void remove_files(const Config& config) {
+    std::error_code ec;
+    std::filesystem::remove(make_path(config), ec);
+  }
+
+ private:
+  static std::string make_path(const Config& config) {
+    return config.dir + "/skiplist_bench_store";
+  }
+  static KVStoreOptions<Key> make_options(const Config& config) {
+    KVStoreOptions<Key> options;
+    options.shard_count = config.shards;
+    return options;
+  }
+
+  std::string path_;
+  KVStore<Key, Value> store_;
+};
+
+// ---------- 执行 ----------
+
+struct Result {
+  double seconds = 0;
+  bench::LatencyHistogram latency;
+};
+
+// 启动 threads 个线程同时执行 body(tid, histogram)，返回总耗时与合并的直方图
+template <typename Body>
+Result run_threads(int threads, Body body) {
+  std::vector<bench::LatencyHistogram> histograms(threads);
+  std::atomic<int> ready{0};
+  std::atomic<bool> go{false};
+  std::vector<std::thread> workers;
+  workers.reserve(threads);
+  for (int t = 0; t < threads; ++t) {
+    workers.emplace_back([&, t] {
+      ready.fetch_add(1);
+      while (!go.load(std::memory_order_acquire)) std::this_thread::yield();
+      body(t, histograms[t]);
+    });
+  }
+  while (ready.load() != threads) std::this_thread::yield();
+  auto start = Clock::now();
+  go.store(true, std::memory_order_release);
+  for (auto& w : workers) w.join();
+  Result result;
+  result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  for (auto& h : histograms) result.latency.merge(h);
+  return result;
+}
+
+inline std::uint64_t elapsed_ns(Clock::time_point start) {
+  return static_cast<std::uint64_t>(
+      std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() -
+                                                           start)
+          .count());
+}
+
+// 装载 [0, records)：顺序分布下每个线程按升序插入连续的一段，
+// 其余分布先打乱插入顺序（打乱在计时开始前完成）
+template <typename Engine>
+Result load(Engine& engine, const Config& config, int threads,
+            bench::Distribution dist, const Value& value) {
+  std::vector<std::vector<std::uint64_t>> ids(threads);
+  for (int t = 0; t < threads; ++t) {
+    std::uint64_t begin = config.records * t / threads;
+    std::uint64_t end = config.records * (t + 1) / threads;
+    ids[t].resize(end - begin);
+    std::iota(ids[t].begin(), ids[t].end(), begin);
+    if (dist != bench::Distribution::kSequential) {
+      std::shuffle(ids[t].begin(), ids[t].end(), std::mt19937_64(t + 1));
+    }
+  }
+  return run_threads(threads, [&](int t, bench::LatencyHistogram& latency) {
+    Key key;
+    for (std::uint64_t id : ids[t]) {
+      bench::format_key(id, config.key_size, key);
+      auto start = Clock::now();
+      engine.put(key, value);
+      latency.record(elapsed_ns(start));
+    }
+  });
+}
+
+template <typename Engine>
+Result run_workload(Engine& engine, const Config& config, int threads,
+                    const bench::Workload& workload, bench::Distribution dist,
+                    const Value& value) {
+  bench::ZipfianGenerator zipf(config.records, config.zipf_theta);
+  // 已分配的 key 编号数；插入先领取编号再写入，读到尚未写入的编号时为一次未命中
+  std::atomic<std::uint64_t> key_count{config.records};
+  return run_threads(threads, [&](int t, bench::LatencyHistogram& latency) {
+    bench::FastRandom rng(0x5EED + t);
+    bench::KeyChooser chooser(dist, &zipf, config.records * t / threads);
+    std::uint64_t ops =
+        config.ops * (t + 1) / threads - config.ops * t / threads;
+    Key key;
+    Value out;
+    for (std::uint64_t i = 0; i < ops; ++i) {
+      bench::Op op = workload.choose(rng.next_double());
+      std::uint64_t id =
+          op == bench::Op::kInsert
+              ? key_count.fetch_add(1, std::memory_order_relaxed)
+              : chooser.next(rng, key_count.load(std::memory_order_relaxed));
+      bench::format_key(id, config.key_size, key);
+      auto start = Clock::now();
+      switch (op) {
+        case bench::Op::kRead:
+          engine.get(key, out);
+          break;
+        case bench::Op::kUpdate:
+        case bench::Op::kInsert:
+          engine.put(key, value);
+          break;
+        case bench::Op::kScan:
+          engine.scan(key, 1 + rng.uniform(config.scan_length));
+          break;
+        case bench::Op::kReadModifyWrite:
+          engine.get(key, out);
+          engine.put(key, value);
+          break;
+      }
+      latency.record(elapsed_ns(start));
+    }
+  });
+}
+
+// ---------- 输出 ----------
+
+void print_header(const Config& config) {
+  if (config.csv) {
+    std::printf(
+        "engine,workload,dist,threads,ops,seconds,ops_per_sec,avg_us,p50_us,"
+        "p99_us,p999_us,max_us\n");
+    return;
+  }
+  std::printf("%-14s %-5s %-10s %7s %10s %9s %12s %9s %9s %9s %9s %10s\n",
+              "engine", "wl", "dist", "threads", "ops", "time", "ops/s",
+              "avg(us)", "p50(us)", "p99(us)", "p999(us)", "max(us)");
+}
+
+void print_row(const Config& config, const std::string& engine,
+               const std::string& workload, bench::Distribution dist,
+               int threads, const Result& r) {
+  const auto& h = r.latency;
+  double qps = r.seconds > 0 ? static_cast<double>(h.count()) / r.seconds : 0;
+  auto us = [](std::uint64_t ns) { return static_cast<double>(ns) / 1000.0; };
+  const char* fmt =
+      config.csv ? "%s,%s,%s,%d,%llu,%.4f,%.0f,%.3f,%.3f,%.3f,%.3f,%.3f\n"
+                 : "%-14s %-5s %-10s %7d %10llu %8.2fs %12.0f %9.2f %9.2f "
+                   "%9.2f %9.2f %10.1f\n";
+  std::printf(fmt, engine.c_str(), workload.c_str(),
+              bench::distribution_name(dist), threads,
+              static_cast<unsigned long long>(h.count()), r.seconds, qps,
+              h.mean() / 1000.0, us(h.percentile(0.5)), us(h.percentile(0.99)),
+              us(h.percentile(0.999)), us(h.max()));
+  std::fflush(stdout);
+}
+
+// 全部运行累计的分阶段耗时，每个（操作, 阶段）一行
+void print_metrics(const Config& config) {
+  if (!metrics::kEnabled) {
+    std::cerr << "--metrics needs a build with -DSKIPLIST_METRICS=ON"
+              << std::endl;
+    return;
+  }
+  std::printf(config.csv ? "\nop,phase,count,avg_ns,p50_ns,p99_ns,p999_ns,"
+                           "max_ns\n"
+                         : "\n%-12s %-9s %12s %10s %10s %10s %10s %12s\n",
+              "op", "phase", "count", "avg(ns)", "p50(ns)", "p99(ns)",
+              "p999(ns)", "max(ns)");
+  const char* fmt = config.csv ? "%s,%s,%llu,%.0f,%llu,%llu,%llu,%llu\n"
+                               : "%-12s %-9s %12llu %10.0f %10llu %10llu "
+                                 "%10llu %12llu\n";
+  metrics::Registry::shared().for_each(
+      [&](const metrics::PointName& name, const metrics::HistogramData& h) {
+        auto ull = [](std::uint64_t v) {
+          return static_cast<unsigned long long>(v);
+        };
+        std::printf(fmt, name.op, name.phase, ull(h.count), h.mean(),
+                    ull(h.percentile(0.5)), ull(h.percentile(0.99)),
+                    ull(h.percentile(0.999)), ull(h.max));
+      });
+}
+
+template <typename Engine>
+void bench_engine(const Config& config, const std::string& name) {
+  const Value value(config.value_size, 'v');
+  for (bench::Distribution dist : config.dists) {
+    for (int threads : config.threads) {
+      bool loaded_row = false;
+      for (const std::string& wl_name : config.workloads) {
+        const auto& all = bench::ycsb_workloads();
+        auto wl = std::find_if(all.begin(), all.end(), [&](const auto& w) {
+          return wl_name == w.name;
+        });
+        if (wl->scan > 0 && !Engine::kSupportsScan) {
+          std::cerr << name << " does not support scan, skipping workload "
+                    << wl_name << std::endl;
+          continue;
+        }
+        // 每个负载使用新的引擎，避免前一个负载的插入影响后一个
+        auto engine = std::make_unique<Engine>(config);
+        Result loaded = load(*engine, config, threads, dist, value);
+        if (!loaded_row) {
+          print_row(config, name, "load", dist, threads, loaded);
+          loaded_row = true;
+        }
+        bench::Distribution run_dist =
+            wl->latest ? bench::Distribution::kLatest : dist;
+        Result r = run_workload(*engine, config, threads, *wl, run_dist, value);
+        print_row(config, name, wl->name, run_dist, threads, r);
+      }
+    }
+  }
+}
+
+// ---------- 命令行 ----------
+
+std::vector<std::string> split(const std::string& s) {
+  std::vector<std::string> parts;
+  std::size_t begin = 0;
+  while (begin <= s.size()) {
+    std::size_t end = s.find(',', begin);
+    if (end == std::string::npos) end = s.size();
+    if (end > begin) parts.push_back(s.substr(begin, end - begin));
+    begin = end + 1;
+  }
+  return parts;
+}
+
+void print_usage(const char* prog) {
+  std::cout
+      << "Usage: " << prog << " [options]\n"
+      << "  --engine=LIST      skiplist, skiplist-dist, lockfree, kvstore"
+         " (default skiplist)\n"
+      << "  --workload=LIST    YCSB workloads a-f (default a,b,c)\n"
+      << "  --dist=LIST        uniform, zipfian, sequential"
+         " (default uniform,zipfian)\n"
+      << "  --threads=LIST     thread counts (default 1,2,4,... up to the"
+         " number of cores)\n"
+      << "  --records=N        records loaded before each workload"
+         " (default 100000)\n"
+      << "  --ops=N            operations per workload (default 1000000)\n"
+      << "  --key-size=N       key length in bytes (default 16)\n"
+      << "  --value-size=N     value length in bytes (default 100)\n"
+      << "  --scan-length=N    max records per scan (default 100)\n"
+      << "  --shards=N         kvstore shard count (default 16)\n"
+      << "  --zipf-theta=X     Zipfian skew (default 0.99)\n"
+      << "  --dir=PATH         kvstore snapshot directory (default /tmp)\n"
+      << "  --csv              print CSV instead of a table\n"
+      << "  --metrics          print per-phase latencies at the end"
+         " (needs -DSKIPLIST_METRICS=ON)\n";
+}
+
+bool parse_args(int argc, char* argv[], Config& config) {
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    std::size_t eq = arg.find('=');
+    std::string name = arg.substr(0, eq);
+    std::string value = eq == std::string::npos ? "" : arg.substr(eq + 1);
+    if (name == "--help" || name == "-h") {
+      print_usage(argv[0]);
+      std::exit(0);
+    } else if (name == "--csv") {
+      config.csv = true;
+    } else if (name == "--metrics") {
+      config.metrics = true;
+    } else if (name == "--engine") {
+      config.engines = split(value);
+    } else if (name == "--workload") {
+      config.workloads = split(value);
+    } else if (name == "--dist") {
+      config.dists.clear();
+      for (const auto& d : split(value)) {
+        if (d == "uniform") {
+          config.dists.push_back(bench::Distribution::kUniform);
+        } else if (d == "zipfian") {
+          config.dists.push_back(bench::Distribution::kZipfian);
+        } else if (d == "sequential") {
+          config.dists.push_back(bench::Distribution::kSequential);
+        } else {
+          std::cerr << "unknown distribution: " << d << std::endl;
+          return false;
+        }
+      }
+    } else if (name == "--threads") {
+      config.threads.clear();
+      for (const auto& t : split(value)) {
+        config.threads.push_back(std::max(1, std::atoi(t.c_str())));
+      }
+    } else if (name == "--records") {
+      config.records = std::strtoull(value.c_str(), nullptr, 10);
+    } else if (name == "--ops") {
+      config.ops = std::strtoull(value.c_str(), nullptr, 10);
+    } else if (name == "--key-size") {
+      config.key_size = std::strtoull(value.c_str(), nullptr, 10);
+    } else if (name == "--value-size") {
+      config.value_size = std::strtoull(value.c_str(), nullptr, 10);
+    } else if (name == "--scan-length") {
+      config.scan_length = std::strtoull(value.c_str(), nullptr, 10);
+    } else if (name == "--shards") {
+      config.shards = std::strtoull(value.c_str(), nullptr, 10);
+    } else if (name == "--zipf-theta") {
+      config.zipf_theta = std::atof(value.c_str());
+    } else if (name == "--dir") {
+      config.dir = value;
+    } else {
+      std::cerr << "unknown option: " << arg << std::endl;
+      return false;
+    }
+  }
+
+  if (config.threads.empty()) {
+    int cores = std::max(1u, std::thread::hardware_concurrency());
+    for (int t = 1; t < cores; t *= 2) config.threads.push_back(t);
+    config.threads.push_back(cores);
+  }
+  for (const auto& w : config.workloads) {
+    const auto& all = bench::ycsb_workloads();
+    if (std::none_of(all.begin(), all.end(),
+                     [&](const auto& wl) { return w == wl.name; })) {
+      std::cerr << "unknown workload: " << w << std::endl;
+      return false;
+    }
+  }
+  if (config.records == 0 || config.scan_length == 0 || config.shards == 0) {
+    std::cerr << "--records, --scan-length and --shards must be positive"
+              << std::endl;
+    return false;
+  }
+  if (config.zipf_theta <= 0 || config.zipf_theta >= 1) {
+    std::cerr << "--zipf-theta must be in (0, 1)" << std::endl;
+    return false;
+  }
+  // 编号最大为 records + ops（全部为插入时），位数加上前缀 'k' 不能超过 key 长度
+  std::size_t digits = std::to_string(config.records + config.ops).size();
+  if (config.key_size < digits + 1) {
+    std::cerr << "--key-size must be at least " << digits + 1 << std::endl;
+    return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  Config config;
+  if (!parse_args(argc, argv, config)) {
+    print_usage(argv[0]);
+    return 1;
+  }
+
+  print_header(config);
+  for (const std::string& engine : config.engines) {
+    if (engine == "skiplist") {
+      bench_engine<SkipListEngine<SkipList<Key, Value>>>(config, engine);
+    } else if (engine == "skiplist-dist") {
+      using List = SkipList<Key, Value, HeapNodeAllocator, MAX_LEVEL,
+                            std::less<Key>, P_FACTOR, DistributedSharedMutex>;
+      bench_engine<SkipListEngine<List>>(config, engine);
+    } else if (engine == "lockfree") {
+      bench_engine<LockFreeEngine>(config, engine);
+    } else if (engine == "kvstore") {
+      bench_engine<KVStoreEngine>(config, engine);
+      KVStoreEngine::remove_files(config);
+    } else {
+      std::cerr << "unknown engine: " << engine << std::endl;
+      return 1;
+    }
+  }
+  if (config.metrics) print_metrics(config);
+  return 0;
+}
@@ -0,0 +1,206 @@
+/**
+ * compression_test.cpp - LZ4 压缩与 value 压缩的测试
+ *
+ * lz4::compress / decompress 对空输入、短于最小匹配长度的输入、重复模式、
+ * 随机字节、偏移接近 64KB 的长距离匹配等输入往返一致；压缩结果的任意
+ * 真前缀与错误的原始长度都必须解压失败。逐个翻转压缩结果的位之后解压
+ * 可以成功（字面量被改写）或失败，但不能越过 raw_size 写出缓冲区，
+ * 缓冲区之后的哨兵字节保持不变。
+ * 最后开启 value_compression_threshold，KVStore 的 get / scan 与
+ * dump() 后重新加载都交出原值。
+ * 出错时返回非零，由 ctest 运行
+ *
+ * 用法示例：
+ *   ./skiplist_compression_test
+ */
+#include <cstdint>
+#include <filesystem>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "Compression.h"
+#include "KVStore.h"
+#include "Workload.h"
+
+namespace {
+
+namespace fs = std::filesystem;
+
+constexpr std::size_t kGuard = 64;
+constexpr char kGuardByte = '\x5A';
+
+// 解压到 raw_size 字节的缓冲区，其后的哨兵被改写时置 overrun
+bool decompress_guarded(const std::string& compressed, std::size_t raw_size,
+                        std::string& out, bool& overrun) {
+  std::vector<char> buffer(raw_size + kGuard, kGuardByte);
+  bool ok = lz4::decompress(compressed.data(), compressed.size(),
+                            buffer.data(), raw_size);
+  overrun = false;
+  for (std::size_t i = raw_size; i < buffer.size(); ++i) {
+    if (buffer[i] != kGuardByte) overrun = true;
+  }
+  out.assign(buffer.data(), raw_size);
+  return ok;
+}
+
+std::vector<std::pair<std::string, std::string>> make_inputs() {
+  bench::FastRandom random(3);
+  std::vector<std::pair<std::string, std::string>> inputs;
+  inputs.emplace_back("empty", "");
+  inputs.emplace_back("one byte", "x");
+  inputs.emplace_back("short", "abcabcabcab");
+  inputs.emplace_back("zeros", std::string(100000, '\0'));
+  std::string pattern;
+  while (pattern.size() < 50000) pattern += "{\"id\":42,\"name\":\"skiplist\"}";
+  inputs.emplace_back("pattern", pattern);
+  std::string noise;
+  for (int i = 0; i < 20000; ++i) {
+    noise.push_back(static_cast<char>(random.next()));
+  }
+  inputs.emplace_back("random", noise);
+  // 同一段随机字节相隔接近最大偏移再次出现
+  std::string far = noise.substr(0, 4000);
+  for (std::size_t i = 0; far.size() < 65530; ++i) {
+    far.push_back(static_cast<char>('a' + i % 7));
+  }
+  far += noise.substr(0, 4000) + noise.substr(0, 4000);
+  inputs.emplace_back("far match", far);
+  std::string mixed;
+  for (int i = 0; i < 3000; ++i) {
+    mixed += "key" + std::to_string(random.uniform(100));
+    if (random.uniform(3) == 0) mixed.push_back(static_cast<char>(i));
+  }
+  inputs.emplace_back("mixed", mixed);
+  return inputs;
+}
+
+bool run_round_trip(const std::string& name, const std::string& input) {
+  std::string compressed;
+  lz4::compress(input.data(), input.size(), compressed);
+  bool ok = true;
+  bool overrun = false;
+  std::string out;
+  if (!decompress_guarded(compressed, input.size(), out, overrun) ||
+      overrun || out != input) {
+    std::cerr << name << ": round trip failed" << std::endl;
+    ok = false;
+  }
+  // 原始长度不符时不能报告成功
+  std::string ignored;
+  if (decompress_guarded(compressed, input.size() + 1, ignored, overrun) ||
+      overrun ||
+      (!input.empty() &&
+       (decompress_guarded(compressed, input.size() - 1, ignored, overrun) ||
+        overrun))) {
+    std::cerr << name << ": accepted a wrong raw size" << std::endl;
+    ok = false;
+  }
+  // 截断的输入：输出不完整，必须失败（空输入的空前缀恰好是合法的）
+  std::size_t step = compressed.size() / 512 + 1;
+  for (std::size_t n = input.empty() ? compressed.size() : 0;
+       n < compressed.size() && ok; n += step) {
+    std::string prefix = compressed.substr(0, n);
+    if (decompress_guarded(prefix, input.size(), ignored, overrun) ||
+        overrun) {
+      std::cerr << name << ": accepted a " << n << " byte prefix"
+                << std::endl;
+      ok = false;
+    }
+  }
+  // 翻转一位：token、长度与偏移被改写时要么失败，要么仍然恰好写满
+  std::size_t bits = compressed.size() * 8;
+  std::size_t bit_step = bits / 4096 + 1;
+  for (std::size_t bit = 0; bit < bits && ok; bit += bit_step) {
+    std::string damaged = compressed;
+    damaged[bit / 8] = static_cast<char>(damaged[bit / 8] ^ (1 << bit % 8));
+    decompress_guarded(damaged, input.size(), ignored, overrun);
+    if (overrun) {
+      std::cerr << name << ": bit " << bit << " wrote past the buffer"
+                << std::endl;
+      ok = false;
+    }
+  }
+  std::cout << "lz4 " << name << " (" << input.size() << " -> "
+            << compressed.size() << ") " << (ok ? "ok" : "FAILED")
+            << std::endl;
+  return ok;
+}
+
+bool check_store(KVStore<std::string, std::string>& store,
+                 const std::map<std::string, std::string>& expected) {
+  bool ok = true;
+  for (const auto& [key, value] : expected) {
+    std::string found;
+    if (!store.get(key, found) || found != value) {
+      std::cerr << "get(" << key << ") returned a wrong value" << std::endl;
+      ok = false;
+      break;
+    }
+  }
+  std::size_t scanned = 0;
+  auto it = expected.begin();
+  store.scan("", "~", 0, [&](const std::string& key, const std::string& value) {
+    if (it == expected.end() || it->first != key || it->second != value) {
+      ok = false;
+    } else {
+      ++it;
+    }
+    ++scanned;
+  });
+  if (scanned != expected.size()) ok = false;
+  return ok;
+}
+
+bool run_value_compression(const fs::path& root) {
+  std::string path = (root / "values").string();
+  KVStoreOptions<std::string> options;
+  options.shard_count = 2;
+  options.value_compression_threshold = 32;
+  std::map<std::string, std::string> expected;
+  bench::FastRandom random(11);
+  bool ok = true;
+  {
+    KVStore<std::string, std::string> store(path, options);
+    for (int i = 0; i < 5000; ++i) {
+      std::string key = "k" + std::to_string(random.uniform(4000));
+      // 短于阈值、可压缩与不可压缩的 value 都有
+      std::string value;
+      std::uint64_t kind = random.uniform(3);
+      std::size_t n = kind == 0 ? random.uniform(32) : 32 + random.uniform(400);
+      for (std::size_t j = 0; j < n; ++j) {
+        value.push_back(kind == 1 ? static_cast<char>('a' + j % 5)
+                                  : static_cast<char>(random.next()));
+      }
+      store.put(key, value);
+      expected[key] = value;
+    }
+    ok = check_store(store, expected);
+    ok = store.dump() && ok;
+  }
+  {
+    KVStore<std::string, std::string> store(path, options);
+    ok = check_store(store, expected) && ok;
+  }
+  std::cout << "value compression " << (ok ? "ok" : "FAILED") << std::endl;
+  return ok;
+}
+
+}  // namespace
+
+int main() {
+  std::string name =
+      "skiplist_compression_test_" + std::to_string(std::random_device{}());
+  fs::path root = fs::temp_directory_path() / name;
+  fs::create_directories(root);
+  bool ok = true;
+  for (const auto& [input_name, input] : make_inputs()) {
+    ok = run_round_trip(input_name, input) && ok;
+  }
+  ok = run_value_compression(root) && ok;
+  std::error_code ec;
+  if (ok) fs::remove_all(root, ec);
+  return ok ? 0 : 1;
+}
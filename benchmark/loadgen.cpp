@@ -0,0 +1,517 @@
+/**
+ * loadgen.cpp - skiplist_server（或任何 Redis 兼容服务）的负载生成器
+ *
+ * 与 skiplist_bench 使用相同的 key 格式、分布与 YCSB 负载（见 Workload.h），
+ * 测量包含网络、协议解析与批量执行在内的端到端吞吐与延迟：
+ * 1. 用 SET 装载 records 条记录（输出为 load 行，--no-load 时跳过）；
+ * 2. 按负载的读写比例发送 ops 次操作：读为 GET，更新 / 插入为 SET，
+ *    扫描为 SCAN key l COUNT n，读-改-写为 GET 后接 SET。
+ * 每个线程负责 connections / threads 个连接，每个连接一次发出 pipeline 个
+ * 操作，全部回复到达后再发下一批（闭环）；一次操作的延迟从所在批次发出
+ * 计到它的最后一条回复到达。
+ *
+ * 用法示例：
+ *   ./skiplist_loadgen --port=6380 --connections=64 --pipeline=16 \
+ *       --workload=a,b,c --dist=zipfian
+ * --help 列出全部参数
+ */
+#include <arpa/inet.h>
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <iostream>
+#include <numeric>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Resp.h"
+#include "Workload.h"
+
+namespace {
+
+using Clock = std::chrono::steady_clock;
+
+struct Config {
+  std::string host = "127.0.0.1";
+  int port = 6380;
+  std::vector<std::string> workloads = {"a", "b", "c"};
+  std::vector<bench::Distribution> dists = {bench::Distribution::kUniform};
+  int threads = 1;
+  int connections = 16;
+  std::size_t pipeline = 1;
+  std::uint64_t records = 100000;
+  std::uint64_t ops = 1000000;
+  std::size_t key_size = 16;
+  std::size_t value_size = 100;
+  std::size_t scan_length = 100;
+  double zipf_theta = 0.99;
+  bool load = true;
+  bool csv = false;
+};
+
+struct Result {
+  double seconds = 0;
+  bench::LatencyHistogram latency;
+  std::uint64_t errors = 0;
+};
+
+// ---------- 连接 ----------
+
+struct Pending {
+  Clock::time_point start;
+  int replies;  // 还未收到的回复数
+};
+
+struct Connection {
+  int fd = -1;
+  std::string in;
+  std::size_t parsed = 0;
+  std::deque<Pending> pending;
+};
+
+int connect_to(const Config& config) {
+  addrinfo hints{};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  addrinfo* result = nullptr;
+  std::string port = std::to_string(config.port);
+  if (::getaddrinfo(config.host.c_str(), port.c_str(), &hints, &result) != 0) {
+    std::cerr << "cannot resolve " << config.host << std::endl;
+    return -1;
+  }
+  int fd = -1;
+  for (addrinfo* ai = result; ai != nullptr && fd < 0; ai = ai->ai_next) {
+    fd = ::socket(ai->ai_family, ai->ai_socktype, ai->ai_protocol);
+    if (fd >= 0 && ::connect(fd, ai->ai_addr, ai->ai_addrlen) != 0) {
+      ::close(fd);
+      fd = -1;
+    }
+  }
+  ::freeaddrinfo(result);
+  if (fd < 0) {
+    std::cerr << "cannot connect to " << config.host << ":" << config.port
+              << ": " << std::strerror(errno) << std::endl;
+    return -1;
+  }
+  int one = 1;
+  ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  return fd;
+}
+
+bool send_all(int fd, const std::string& data) {
+  std::size_t sent = 0;
+  while (sent < data.size()) {
+    ssize_t n = ::send(fd, data.data() + sent, data.size() - sent,
+                       MSG_NOSIGNAL);
+    if (n < 0 && errno == EINTR) continue;
+    if (n <= 0) return false;
+    sent += static_cast<std::size_t>(n);
+  }
+  return true;
+}
+
+// 读取并处理 conn 上已到达的回复，连接断开或协议错误时返回 false
+bool receive(Connection& conn, bench::LatencyHistogram& latency,
+             std::uint64_t& errors) {
+  char buffer[64 << 10];
+  ssize_t n = ::recv(conn.fd, buffer, sizeof(buffer), 0);
+  if (n < 0 && errno == EINTR) return true;
+  if (n <= 0) {
+    std::cerr << "connection closed by server" << std::endl;
+    return false;
+  }
+  conn.in.append(buffer, static_cast<std::size_t>(n));
+  const char* end = conn.in.data() + conn.in.size();
+  for (;;) {
+    std::size_t consumed = 0;
+    bool is_error = false;
+    resp::Parse r = resp::skip_reply(conn.in.data() + conn.parsed, end,
+                                     consumed, &is_error);
+    if (r == resp::Parse::kIncomplete) break;
+    if (r == resp::Parse::kError || conn.pending.empty()) {
+      std::cerr << "malformed reply from server" << std::endl;
+      return false;
+    }
+    conn.parsed += consumed;
+    errors += is_error;
+    Pending& front = conn.pending.front();
+    if (--front.replies == 0) {
+      latency.record(static_cast<std::uint64_t>(
+          std::chrono::duration_cast<std::chrono::nanoseconds>(Clock::now() -
+                                                               front.start)
+              .count()));
+      conn.pending.pop_front();
+    }
+  }
+  conn.in.erase(0, conn.parsed);
+  conn.parsed = 0;
+  return true;
+}
+
+// 每个线程在自己的连接上发送 ops_per_thread[t] 次操作，
+// next(t, out) 把一次操作的命令追加到 out 并返回其回复数
+template <typename Next>
+Result run_threads(const Config& config,
+                   const std::vector<std::uint64_t>& ops_per_thread,
+                   Next next) {
+  const int threads = static_cast<int>(ops_per_thread.size());
+  std::vector<bench::LatencyHistogram> histograms(threads);
+  std::vector<std::uint64_t> errors(threads, 0);
+  std::atomic<int> ready{0};
+  std::atomic<bool> go{false};
+  std::atomic<bool> failed{false};
+  std::vector<std::thread> workers;
+  for (int t = 0; t < threads; ++t) {
+    workers.emplace_back([&, t] {
+      int count = config.connections * (t + 1) / threads -
+                  config.connections * t / threads;
+      std::vector<Connection> conns(std::max(count, 1));
+      for (auto& conn : conns) {
+        conn.fd = connect_to(config);
+        if (conn.fd < 0) failed.store(true);
+      }
+      ready.fetch_add(1);
+      while (!go.load(std::memory_order_acquire)) std::this_thread::yield();
+      std::uint64_t remaining = ops_per_thread[t];
+      std::vector<pollfd> fds(conns.size());
+      std::string batch;
+      bool ok = !failed.load();
+      while (ok) {
+        // 给空闲的连接发出下一批
+        for (auto& conn : conns) {
+          if (!conn.pending.empty() || remaining == 0) continue;
+          batch.clear();
+          auto start = Clock::now();
+          for (std::size_t i = 0; i < config.pipeline && remaining > 0; ++i) {
+            conn.pending.push_back({start, next(t, batch)});
+            --remaining;
+          }
+          if (!send_all(conn.fd, batch)) {
+            std::cerr << "send failed: " << std::strerror(errno) << std::endl;
+            ok = false;
+            break;
+          }
+        }
+        std::size_t waiting = 0;
+        for (std::size_t i = 0; i < conns.size(); ++i) {
+          fds[i] = {conns[i].fd, POLLIN, 0};
+          waiting += conns[i].pending.size();
+        }
+        if (!ok || waiting == 0) break;
+        if (::poll(fds.data(), fds.size(), -1) < 0 && errno != EINTR) break;
+        for (std::size_t i = 0; i < conns.size() && ok; ++i) {
+          if (fds[i].revents != 0) {
+            ok = receive(conns[i], histograms[t], errors[t]);
+          }
+        }
+      }
+      if (!ok) failed.store(true);
+      for (auto& conn : conns) {
+        if (conn.fd >= 0) ::close(conn.fd);
+      }
+    });
+  }
+  while (ready.load() != threads) std::this_thread::yield();
+  auto start = Clock::now();
+  go.store(true, std::memory_order_release);
+  for (auto& w : workers) w.join();
+  Result result;
+  result.seconds = std::chrono::duration<double>(Clock::now() - start).count();
+  for (auto& h : histograms) result.latency.merge(h);
+  result.errors = std::accumulate(errors.begin(), errors.end(),
+                                  std::uint64_t{0});
+  if (failed.load()) std::exit(1);
+  return result;
+}
+
+// 线程 t 的份额：把 total 尽量均匀地分给各线程
+std::vector<std::uint64_t> split_ops(std::uint64_t total, int threads) {
+  std::vector<std::uint64_t> ops(threads);
+  for (int t = 0; t < threads; ++t) {
+    ops[t] = total * (t + 1) / threads - total * t / threads;
+  }
+  return ops;
+}
+
+// 装载 [0, records)：顺序分布下每个线程按升序写入连续的一段，
+// 其余分布先打乱写入顺序（打乱在计时开始前完成）
+Result load(const Config& config, bench::Distribution dist,
+            const std::string& value) {
+  const int threads = config.threads;
+  std::vector<std::vector<std::uint64_t>> ids(threads);
+  for (int t = 0; t < threads; ++t) {
+    std::uint64_t begin = config.records * t / threads;
+    std::uint64_t end = config.records * (t + 1) / threads;
+    ids[t].resize(end - begin);
+    std::iota(ids[t].begin(), ids[t].end(), begin);
+    if (dist != bench::Distribution::kSequential) {
+      std::shuffle(ids[t].begin(), ids[t].end(), std::mt19937_64(t + 1));
+    }
+  }
+  std::vector<std::size_t> positions(threads, 0);
+  std::vector<std::string> keys(threads);
+  return run_threads(config, split_ops(config.records, threads),
+                     [&](int t, std::string& out) {
+                       bench::format_key(ids[t][positions[t]++],
+                                         config.key_size, keys[t]);
+                       resp::put_command(out, {"SET", keys[t], value});
+                       return 1;
+                     });
+}
+
+struct ThreadState {
+  bench::FastRandom rng;
+  bench::KeyChooser chooser;
+  std::string key;
+};
+
+Result run_workload(const Config& config, const bench::Workload& workload,
+                    bench::Distribution dist, const std::string& value) {
+  const int threads = config.threads;
+  bench::ZipfianGenerator zipf(config.records, config.zipf_theta);
+  // 已分配的 key 编号数；插入先领取编号再写入
+  std::atomic<std::uint64_t> key_count{config.records};
+  std::vector<ThreadState> states;
+  for (int t = 0; t < threads; ++t) {
+    states.push_back({bench::FastRandom(0x5EED + t),
+                      bench::KeyChooser(dist, &zipf,
+                                        config.records * t / threads),
+                      std::string()});
+  }
+  return run_threads(
+      config, split_ops(config.ops, threads), [&](int t, std::string& out) {
+        ThreadState& s = states[t];
+        bench::Op op = workload.choose(s.rng.next_double());
+        std::uint64_t id =
+            op == bench::Op::kInsert
+                ? key_count.fetch_add(1, std::memory_order_relaxed)
+                : s.chooser.next(s.rng,
+                                 key_count.load(std::memory_order_relaxed));
+        bench::format_key(id, config.key_size, s.key);
+        switch (op) {
+          case bench::Op::kRead:
+            resp::put_command(out, {"GET", s.key});
+            return 1;
+          case bench::Op::kUpdate:
+          case bench::Op::kInsert:
+            resp::put_command(out, {"SET", s.key, value});
+            return 1;
+          case bench::Op::kScan: {
+            // key 都以 'k' 开头，"l" 大于所有 key
+            std::string count =
+                std::to_string(1 + s.rng.uniform(config.scan_length));
+            resp::put_command(out, {"SCAN", s.key, "l", "COUNT", count});
+            return 1;
+          }
+          case bench::Op::kReadModifyWrite:
+            resp::put_command(out, {"GET", s.key});
+            resp::put_command(out, {"SET", s.key, value});
+            return 2;
+        }
+        return 0;
+      });
+}
+
+// ---------- 输出 ----------
+
+void print_header(const Config& config) {
+  if (config.csv) {
+    std::printf(
+        "workload,dist,threads,connections,pipeline,ops,seconds,ops_per_sec,"
+        "avg_us,p50_us,p99_us,p999_us,max_us,errors\n");
+    return;
+  }
+  std::printf("%-5s %-10s %7s %5s %5s %10s %9s %12s %9s %9s %9s %9s %10s\n",
+              "wl", "dist", "threads", "conns", "pipe", "ops", "time", "ops/s",
+              "avg(us)", "p50(us)", "p99(us)", "p999(us)", "max(us)");
+}
+
+void print_row(const Config& config, const std::string& workload,
+               bench::Distribution dist, const Result& r) {
+  const auto& h = r.latency;
+  double qps = r.seconds > 0 ? static_cast<double>(h.count()) / r.seconds : 0;
+  auto us = [](std::uint64_t ns) { return static_cast<double>(ns) / 1000.0; };
+  const char* fmt =
+      config.csv
+          ? "%s,%s,%d,%d,%zu,%llu,%.4f,%.0f,%.3f,%.3f,%.3f,%.3f,%.3f,%llu\n"
+          : "%-5s %-10s %7d %5d %5zu %10llu %8.2fs %12.0f %9.2f %9.2f "
+            "%9.2f %9.2f %10.1f\n";
+  std::printf(fmt, workload.c_str(), bench::distribution_name(dist),
+              config.threads, config.connections, config.pipeline,
+              static_cast<unsigned long long>(h.count()), r.seconds, qps,
+              h.mean() / 1000.0, us(h.percentile(0.5)), us(h.percentile(0.99)),
+              us(h.percentile(0.999)), us(h.max()),
+              static_cast<unsigned long long>(r.errors));
+  if (!config.csv && r.errors > 0) {
+    std::fprintf(stderr, "%llu error replies\n",
+                 static_cast<unsigned long long>(r.errors));
+  }
+  std::fflush(stdout);
+}
+
+// ---------- 命令行 ----------
+
+std::vector<std::string> split(const std::string& s) {
+  std::vector<std::string> parts;
+  std::size_t begin = 0;
+  while (begin <= s.size()) {
+    std::size_t end = s.find(',', begin);
+    if (end == std::string::npos) end = s.size();
+    if (end > begin) parts.push_back(s.substr(begin, end - begin));
+    begin = end + 1;
+  }
+  return parts;
+}
+
+void print_usage(const char* prog) {
+  std::cout
+      << "Usage: " << prog << " [options]\n"
+      << "  --host=HOST        server address (default 127.0.0.1)\n"
+      << "  --port=N           server port (default 6380)\n"
+      << "  --workload=LIST    YCSB workloads a-f (default a,b,c)\n"
+      << "  --dist=LIST        uniform, zipfian, sequential"
+         " (default uniform)\n"
+      << "  --threads=N        client threads (default 1)\n"
+      << "  --connections=N    connections spread over the threads"
+         " (default 16)\n"
+      << "  --pipeline=N       operations in flight per connection"
+         " (default 1)\n"
+      << "  --records=N        records loaded before the workloads"
+         " (default 100000)\n"
+      << "  --ops=N            operations per workload (default 1000000)\n"
+      << "  --key-size=N       key length in bytes (default 16)\n"
+      << "  --value-size=N     value length in bytes (default 100)\n"
+      << "  --scan-length=N    max records per scan (default 100)\n"
+      << "  --zipf-theta=X     Zipfian skew (default 0.99)\n"
+      << "  --no-load          skip the load phase (data already present)\n"
+      << "  --csv              print CSV instead of a table\n";
+}
+
+bool parse_args(int argc, char* argv[], Config& config) {
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    std::size_t eq = arg.find('=');
+    std::string name = arg.substr(0, eq);
+    std::string value = eq == std::string::npos ? "" : arg.substr(eq + 1);
+    if (name == "--help" || name == "-h") {
+      print_usage(argv[0]);
+      std::exit(0);
+    } else if (name == "--csv") {
+      config.csv = true;
+    } else if (name == "--no-load") {
+      config.load = false;
+    } else if (name == "--host") {
+      config.host = value;
+    } else if (name == "--port") {
+      config.port = std::atoi(value.c_str());
+    } else if (name == "--workload") {
+      config.workloads = split(value);
+    } else if (name == "--dist") {
+      config.dists.clear();
+      for (const auto& d : split(value)) {
+        if (d == "uniform") {
+          config.dists.push_back(bench::Distribution::kUniform);
+        } else if (d == "zipfian") {
+          config.dists.push_back(bench::Distribution::kZipfian);
+        } else if (d == "sequential") {
+          config.dists.push_back(bench::Distribution::kSequential);
+        } else {
+          std::cerr << "unknown distribution: " << d << std::endl;
+          return false;
+        }
+      }
+    } else if (name == "--threads") {
+      config.threads = std::max(1, std::atoi(value.c_str()));
+    } else if (name == "--connections") {
+      config.connections = std::max(1, std::atoi(value.c_str()));
+    } else if (name == "--pipeline") {
+      config.pipeline =
+          std::max<std::size_t>(1, std::strtoull(value.c_str(), nullptr, 10));
+    } else if (name == "--records") {
+      config.records = std::strtoull(value.c_str(), nullptr, 10);
+    } else if (name == "--ops") {
+      config.ops = std::strtoull(value.c_str(), nullptr, 10);
+    } else if (name == "--key-size") {
+      config.key_size = std::strtoull(value.c_str(), nullptr, 10);
+    } else if (name == "--value-size") {
+      config.value_size = std::strtoull(value.c_str(), nullptr, 10);
+    } else if (name == "--scan-length") {
+      config.scan_length = std::strtoull(value.c_str(), nullptr, 10);
+    } else if (name == "--zipf-theta") {
+      config.zipf_theta = std::atof(value.c_str());
+    } else {
+      std::cerr << "unknown option: " << arg << std::endl;
+      return false;
+    }
+  }
+
+  // 每个线程至少一个连接
+  config.connections = std::max(config.connections, config.threads);
+  for (const auto& w : config.workloads) {
+    const auto& all = bench::ycsb_workloads();
+    if (std::none_of(all.begin(), all.end(),
+                     [&](const auto& wl) { return w == wl.name; })) {
+      std::cerr << "unknown workload: " << w << std::endl;
+      return false;
+    }
+  }
+  if (config.records == 0 || config.scan_length == 0) {
+    std::cerr << "--records and --scan-length must be positive" << std::endl;
+    return false;
+  }
+  if (config.zipf_theta <= 0 || config.zipf_theta >= 1) {
+    std::cerr << "--zipf-theta must be in (0, 1)" << std::endl;
+    return false;
+  }
+  // 编号最大为 records + ops（全部为插入时），
+  // 位数加上前缀 'k' 不能超过 key 长度
+  std::size_t digits = std::to_string(config.records + config.ops).size();
+  if (config.key_size < digits + 1) {
+    std::cerr << "--key-size must be at least " << digits + 1 << std::endl;
+    return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  Config config;
+  if (!parse_args(argc, argv, config)) {
+    print_usage(argv[0]);
+    return 1;
+  }
+
+  const std::string value(config.value_size, 'v');
+  print_header(config);
+  // 与进程内基准不同，服务端的数据在负载之间保留：
+  // 每种分布装载一次，其后的负载依次在同一份数据上执行
+  for (bench::Distribution dist : config.dists) {
+    if (config.load) print_row(config, "load", dist, load(config, dist, value));
+    for (const std::string& wl_name : config.workloads) {
+      const auto& all = bench::ycsb_workloads();
+      auto wl = std::find_if(all.begin(), all.end(),
+                             [&](const auto& w) { return wl_name == w.name; });
+      bench::Distribution run_dist =
+          wl->latest ? bench::Distribution::kLatest : dist;
+      print_row(config, wl->name, run_dist,
+                run_workload(config, *wl, run_dist, value));
+    }
+  }
+  return 0;
+}
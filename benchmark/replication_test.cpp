@@ -0,0 +1,176 @@
+/**
+ * replication_test.cpp - 主从复制的全量与增量同步测试
+ *
+ * 在本机端口上启动 ReplicationPrimary，副本依次经历：
+ *   1. 第一次连接，全量同步已有数据；
+ *   2. 保持连接，持续应用主节点新的 put / del；
+ *   3. 断开后主节点写入少量数据，重连时从断开处继续（增量同步）；
+ *   4. 断开后主节点写入超出复制积压的数据，重连时重新全量同步。
+ * 每一步都等副本追上后按序比对两边的全部记录；全量同步以快照替换副本的
+ * 快照文件（inode 改变），增量同步不会，据此区分两种同步方式。
+ * 出错时返回非零，由 ctest 运行
+ *
+ * 用法示例：
+ *   ./skiplist_replication_test --port=27100
+ */
+#include <sys/stat.h>
+
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <filesystem>
+#include <iostream>
+#include <random>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "Replication.h"
+#include "Workload.h"
+
+namespace {
+
+namespace fs = std::filesystem;
+
+using Store = KVStore<std::string, std::string>;
+using Records = std::vector<std::pair<std::string, std::string>>;
+
+constexpr std::uint64_t kKeys = 4000;
+constexpr std::size_t kBacklog = 256 * 1024;
+
+std::string key_of(std::uint64_t i) {
+  std::string digits = std::to_string(i);
+  return "key" + std::string(6 - digits.size(), '0') + digits;
+}
+
+Records dump_records(Store& store) {
+  Records records;
+  store.scan("", "~", 0, [&](const std::string& key, const std::string& value) {
+    records.emplace_back(key, value);
+  });
+  return records;
+}
+
+// 随机写入 n 次，最后写入哨兵 key，副本读到它时已应用之前的全部记录
+void write_batch(Store& primary, bench::FastRandom& random, int n,
+                 std::size_t value_size, const std::string& sentinel) {
+  for (int i = 0; i < n; ++i) {
+    std::string key = key_of(random.uniform(kKeys));
+    if (random.uniform(5) == 0) {
+      primary.del(key);
+    } else {
+      primary.put(key, std::string(value_size, static_cast<char>(
+                                                   'a' + random.uniform(26))));
+    }
+  }
+  primary.put("sentinel", sentinel);
+}
+
+bool wait_synced(Store& primary, Store& replica, const std::string& sentinel) {
+  auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(30);
+  std::string value;
+  while (!replica.get("sentinel", value) || value != sentinel) {
+    if (std::chrono::steady_clock::now() > deadline) {
+      std::cerr << "replica did not catch up with " << sentinel << std::endl;
+      return false;
+    }
+    std::this_thread::sleep_for(std::chrono::milliseconds(20));
+  }
+  Records expected = dump_records(primary);
+  Records actual = dump_records(replica);
+  if (expected != actual) {
+    std::cerr << "replica has " << actual.size() << " records, primary "
+              << expected.size() << std::endl;
+    return false;
+  }
+  return true;
+}
+
+// 快照文件的 inode，不存在时为 0
+std::uint64_t inode_of(const std::string& path) {
+  struct stat st;
+  return ::stat(path.c_str(), &st) == 0 ? static_cast<std::uint64_t>(st.st_ino)
+                                        : 0;
+}
+
+bool report(const char* step, bool ok) {
+  std::cout << step << " " << (ok ? "ok" : "FAILED") << std::endl;
+  return ok;
+}
+
+bool run(const fs::path& root, int port) {
+  KVStoreOptions<std::string> primary_options;
+  primary_options.shard_count = 4;
+  primary_options.wal_mode = WalMode::kNoSync;
+  primary_options.replication_backlog = kBacklog;
+  Store primary((root / "primary").string(), primary_options);
+  Store replica_store((root / "replica").string());
+  const std::string replica_path = replica_store.path();
+
+  bench::FastRandom random(9);
+  write_batch(primary, random, 5000, 20, "initial");
+  ReplicationPrimary<std::string, std::string> source(primary);
+  if (!source.start("127.0.0.1", port)) return false;
+  Replica<std::string, std::string> replica(replica_store, "127.0.0.1", port);
+
+  replica.start();
+  bool ok = report("full sync",
+                   wait_synced(primary, replica_store, "initial") &&
+                       inode_of(replica_path) != 0);
+
+  write_batch(primary, random, 3000, 20, "streamed");
+  ok = report("streaming", wait_synced(primary, replica_store, "streamed")) &&
+       ok;
+
+  // 断开期间的写入仍在复制积压中
+  replica.stop();
+  std::uint64_t inode = inode_of(replica_path);
+  write_batch(primary, random, 500, 20, "continued");
+  replica.start();
+  bool partial = wait_synced(primary, replica_store, "continued");
+  if (partial && inode_of(replica_path) != inode) {
+    std::cerr << "reconnect within the backlog did a full sync" << std::endl;
+    partial = false;
+  }
+  ok = report("partial resync", partial) && ok;
+
+  // 断开期间的写入超出复制积压，只能全量同步
+  replica.stop();
+  inode = inode_of(replica_path);
+  write_batch(primary, random, 4000, 200, "resynced");
+  replica.start();
+  bool full = wait_synced(primary, replica_store, "resynced");
+  if (full && inode_of(replica_path) == inode) {
+    std::cerr << "reconnect past the backlog did not full sync" << std::endl;
+    full = false;
+  }
+  ok = report("full resync", full) && ok;
+  replica.stop();
+  source.stop();
+  return ok;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  // 默认端口随机选取，避免与并行运行的其他测试冲突
+  int port = 20000 + static_cast<int>(std::random_device{}() % 20000);
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    if (arg.rfind("--port=", 0) == 0) {
+      port = std::atoi(arg.c_str() + 7);
+    } else {
+      std::cerr << "Usage: " << argv[0] << " [--port=N]" << std::endl;
+      return 1;
+    }
+  }
+  std::string name =
+      "skiplist_replication_test_" + std::to_string(std::random_device{}());
+  fs::path root = fs::temp_directory_path() / name;
+  fs::create_directories(root);
+  bool ok = run(root, port);
+  std::error_code ec;
+  if (ok) fs::remove_all(root, ec);
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,291 @@
+/**
+ * snapshot_test.cpp - 二进制快照的读写测试
+ *
+ * 对每种快照压缩方式（kNone / kKeys / kLz4）、哈希与范围分片、
+ * 三种加载方式（kEager 单线程与多线程、kMmapHydrate、kMmapReadOnly）：
+ * 随机写入与删除后 dump()，重新打开，逐个 get、整体 scan 与 export_text
+ * 都与 std::map 中的预期一致。
+ * 再把快照中间的一个字节翻转：SnapshotReader 与 MmapSnapshot 的遍历
+ * 必须返回 false 且只交出损坏之前的有序前缀，各加载方式打开损坏的快照
+ * 不崩溃，读到的 value 都是正确的。
+ * 出错时返回非零，由 ctest 运行
+ *
+ * 用法示例：
+ *   ./skiplist_snapshot_test
+ */
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "KVStore.h"
+#include "Workload.h"
+
+namespace {
+
+namespace fs = std::filesystem;
+
+using Store = KVStore<std::string, std::string>;
+using Expected = std::map<std::string, std::string>;
+
+constexpr std::uint64_t kKeys = 60000;
+
+std::string key_of(std::uint64_t i) {
+  std::string digits = std::to_string(i);
+  return "user" + std::string(8 - digits.size(), '0') + digits;
+}
+
+// 一半 value 是重复的短模式（可压缩），一半是随机字节
+std::string value_of(bench::FastRandom& random) {
+  std::string value;
+  if (random.uniform(2) == 0) {
+    for (int i = 0; i < 12; ++i) value += "field" + std::to_string(i % 3);
+  } else {
+    std::size_t n = 20 + random.uniform(80);
+    for (std::size_t i = 0; i < n; ++i) {
+      value.push_back(static_cast<char>('a' + random.uniform(26)));
+    }
+  }
+  return value;
+}
+
+fs::path fresh_dir(const fs::path& root, const std::string& name) {
+  fs::path dir = root / name;
+  std::error_code ec;
+  fs::remove_all(dir, ec);
+  fs::create_directories(dir);
+  return dir;
+}
+
+Expected fill(Store& store) {
+  bench::FastRandom random(7);
+  Expected expected;
+  for (std::uint64_t i = 0; i < kKeys; ++i) {
+    std::string key = key_of(random.uniform(kKeys));
+    std::string value = value_of(random);
+    store.put(key, value);
+    expected[key] = value;
+  }
+  for (std::uint64_t i = 0; i < kKeys / 10; ++i) {
+    std::string key = key_of(random.uniform(kKeys));
+    store.del(key);
+    expected.erase(key);
+  }
+  return expected;
+}
+
+bool check_store(Store& store, const Expected& expected) {
+  bool ok = true;
+  for (std::uint64_t i = 0; i < kKeys && ok; ++i) {
+    std::string key = key_of(i);
+    std::string value;
+    bool found = store.get(key, value);
+    auto it = expected.find(key);
+    if (found != (it != expected.end()) || (found && value != it->second)) {
+      std::cerr << "get(" << key << ") returned " << found << std::endl;
+      ok = false;
+    }
+  }
+  // scan 与 export_text 都按 key 升序交出全部记录
+  std::vector<std::pair<std::string, std::string>> scanned;
+  store.scan(key_of(0), key_of(kKeys), 0,
+             [&](const std::string& key, const std::string& value) {
+               scanned.emplace_back(key, value);
+             });
+  if (scanned != std::vector<std::pair<std::string, std::string>>(
+                     expected.begin(), expected.end())) {
+    std::cerr << "scan returned " << scanned.size() << " records, expected "
+              << expected.size() << std::endl;
+    ok = false;
+  }
+  std::string text_path = store.path() + ".txt";
+  std::string text;
+  for (const auto& [key, value] : expected) text += key + ":" + value + "\n";
+  if (!store.export_text(text_path)) {
+    ok = false;
+  } else {
+    std::ifstream in(text_path, std::ios::binary);
+    std::string exported((std::istreambuf_iterator<char>(in)),
+                         std::istreambuf_iterator<char>());
+    if (exported != text) {
+      std::cerr << "export_text differs from the expected records"
+                << std::endl;
+      ok = false;
+    }
+  }
+  return ok;
+}
+
+struct Layout {
+  const char* name;
+  PartitionMode partition;
+};
+
+const char* compression_name(SnapshotCompression compression) {
+  switch (compression) {
+    case SnapshotCompression::kNone: return "none";
+    case SnapshotCompression::kKeys: return "keys";
+    case SnapshotCompression::kLz4: return "lz4";
+  }
+  return "?";
+}
+
+KVStoreOptions<std::string> make_options(SnapshotCompression compression,
+                                         PartitionMode partition) {
+  KVStoreOptions<std::string> options;
+  options.snapshot_compression = compression;
+  options.partition = partition;
+  if (partition == PartitionMode::kHash) {
+    options.shard_count = 4;
+  } else {
+    options.range_split_keys = {key_of(kKeys / 4), key_of(kKeys / 2),
+                                key_of(kKeys / 4 * 3)};
+  }
+  return options;
+}
+
+bool run_round_trip(const fs::path& root, SnapshotCompression compression,
+                    const Layout& layout) {
+  std::string name =
+      std::string(compression_name(compression)) + "_" + layout.name;
+  fs::path dir = fresh_dir(root, name);
+  std::string path = (dir / "db").string();
+  KVStoreOptions<std::string> options =
+      make_options(compression, layout.partition);
+  Expected expected;
+  bool ok = true;
+  {
+    Store store(path, options);
+    expected = fill(store);
+    ok = store.dump();
+  }
+  struct Load {
+    const char* name;
+    LoadMode mode;
+    std::size_t threads;
+  };
+  for (const Load& load : {Load{"eager", LoadMode::kEager, 1},
+                           Load{"parallel", LoadMode::kEager, 2},
+                           Load{"hydrate", LoadMode::kMmapHydrate, 1},
+                           Load{"readonly", LoadMode::kMmapReadOnly, 1}}) {
+    options.load_mode = load.mode;
+    options.load_threads = load.threads;
+    Store store(path, options);
+    bool loaded = check_store(store, expected);
+    if (!loaded) std::cerr << "load " << load.name << " failed" << std::endl;
+    ok = loaded && ok;
+  }
+  std::cout << "round trip " << name << " " << (ok ? "ok" : "FAILED")
+            << std::endl;
+  return ok;
+}
+
+// 遍历的结果必须是 expected 的有序前缀，并以 false 结束
+template <typename Reader>
+bool check_prefix(Reader& reader, const Expected& expected) {
+  auto it = expected.begin();
+  bool prefix = true;
+  std::size_t count = 0;
+  bool completed = reader.for_each([&](std::string& key, std::string& value) {
+    if (it == expected.end() || it->first != key || it->second != value) {
+      prefix = false;
+    } else {
+      ++it;
+      ++count;
+    }
+  });
+  if (completed || !prefix || count == expected.size()) {
+    std::cerr << "corrupted snapshot: completed " << completed << ", prefix "
+              << prefix << ", " << count << " records" << std::endl;
+    return false;
+  }
+  return true;
+}
+
+bool run_corruption(const fs::path& root, SnapshotCompression compression) {
+  std::string name = std::string("corrupt_") + compression_name(compression);
+  fs::path dir = fresh_dir(root, name);
+  std::string path = (dir / "db").string();
+  KVStoreOptions<std::string> options =
+      make_options(compression, PartitionMode::kHash);
+  Expected expected;
+  {
+    Store store(path, options);
+    expected = fill(store);
+  }
+  // 文件中间是某个 block 的负载，翻转之后该 block 的 CRC 不再匹配
+  std::string damaged = (dir / "damaged").string();
+  fs::copy_file(path, damaged);
+  {
+    std::fstream file(damaged, std::ios::in | std::ios::out |
+                                   std::ios::binary);
+    auto pos = static_cast<std::streamoff>(fs::file_size(damaged) / 2);
+    char c = 0;
+    file.seekg(pos);
+    file.get(c);
+    file.seekp(pos);
+    file.put(static_cast<char>(c ^ 0x04));
+  }
+  bool ok = true;
+  {
+    SnapshotReader<std::string, std::string> reader;
+    ok = reader.open(damaged) && check_prefix(reader, expected);
+  }
+  {
+    MmapSnapshot<std::string, std::string> mapped;
+    ok = mapped.open(damaged) && check_prefix(mapped, expected) && ok;
+  }
+  for (LoadMode mode : {LoadMode::kEager, LoadMode::kMmapHydrate,
+                        LoadMode::kMmapReadOnly}) {
+    fs::copy_file(damaged, path, fs::copy_options::overwrite_existing);
+    options.load_mode = mode;
+    Store store(path, options);
+    std::size_t found = 0;
+    for (std::uint64_t i = 0; i < kKeys; ++i) {
+      std::string key = key_of(i);
+      std::string value;
+      if (!store.get(key, value)) continue;
+      ++found;
+      auto it = expected.find(key);
+      if (it == expected.end() || it->second != value) {
+        std::cerr << "get(" << key << ") returned a wrong value" << std::endl;
+        ok = false;
+        break;
+      }
+    }
+    if (found == expected.size()) {
+      std::cerr << "corrupted block was loaded" << std::endl;
+      ok = false;
+    }
+  }
+  std::cout << name << " " << (ok ? "ok" : "FAILED") << std::endl;
+  return ok;
+}
+
+}  // namespace
+
+int main() {
+  std::string name =
+      "skiplist_snapshot_test_" + std::to_string(std::random_device{}());
+  fs::path root = fs::temp_directory_path() / name;
+  fs::create_directories(root);
+  bool ok = true;
+  for (SnapshotCompression compression :
+       {SnapshotCompression::kNone, SnapshotCompression::kKeys,
+        SnapshotCompression::kLz4}) {
+    for (const Layout& layout : {Layout{"hash", PartitionMode::kHash},
+                                 Layout{"range", PartitionMode::kRange}}) {
+      ok = run_round_trip(root, compression, layout) && ok;
+    }
+    ok = run_corruption(root, compression) && ok;
+  }
+  std::error_code ec;
+  if (ok) fs::remove_all(root, ec);
+  return ok ? 0 : 1;
+}
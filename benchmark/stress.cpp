@@ -0,0 +1,169 @@
+/**
+ * stress.cpp - SkipList 并发正确性压力测试
+ *
+ * 多个线程在互相交错的 key 上随机插入 / 删除 / 查找：线程 t 只写
+ * key % threads == t 的 key，并在本地记录这些 key 的预期状态，每次查找都
+ * 与预期比对；全部结束后按序遍历，校验 key 严格递增且个数与预期一致。
+ * 每个线程的 key 大致递增（每次前进几格，到头后回绕），开启 finger search
+ * 时本线程保存的路径会被其他线程的插入 / 删除打断，覆盖路径过时的情形。
+ * 同样的负载也在 LockFreeSkipList 上运行一次。
+ * 出错时返回非零，由 ctest 运行；配合 -fsanitize=address / thread 使用效果最好
+ *
+ * 用法示例：
+ *   ./skiplist_stress --threads=4 --ops=200000 --keys=4096
+ */
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "LockFreeSkipList.h"
+#include "SkipList.h"
+#include "Workload.h"
+
+namespace {
+
+using List = SkipList<std::uint64_t, std::uint64_t>;
+using LockFreeList = LockFreeSkipList<std::uint64_t, std::uint64_t>;
+
+struct Config {
+  int threads = 4;
+  std::uint64_t ops = 200000;  // 每个线程
+  std::uint64_t keys = 4096;   // key 空间大小
+};
+
+// 线程 t 的第 slot 个 key
+std::uint64_t key_of(const Config& config, std::uint64_t slot, int t) {
+  return slot * config.threads + t;
+}
+
+// 返回本线程写入后仍存在的 key 数，发现错误时置 failed
+template <typename ListType>
+std::size_t run_worker(ListType& list, const Config& config, int t,
+                       std::atomic<bool>& failed) {
+  bench::FastRandom random(t + 1);
+  const std::uint64_t slots = config.keys / config.threads;
+  std::vector<bool> present(slots, false);
+  std::size_t live = 0;
+  std::uint64_t slot = random.uniform(slots);
+  for (std::uint64_t i = 0; i < config.ops && !failed.load(); ++i) {
+    // 核数少时线程按时间片轮流运行，路径难得被别人打断；主动让出以增加交错
+    if (random.uniform(8) == 0) std::this_thread::yield();
+    slot = (slot + random.uniform(4)) % slots;
+    std::uint64_t key = key_of(config, slot, t);
+    std::uint64_t op = random.uniform(10);
+    if (op < 4) {
+      list.insert_element(key, key);
+      if (!present[slot]) ++live;
+      present[slot] = true;
+    } else if (op < 7) {
+      bool deleted = list.delete_element(key);
+      if (deleted != present[slot]) {
+        std::cerr << "delete_element(" << key << ") returned " << deleted
+                  << std::endl;
+        failed.store(true);
+      }
+      if (present[slot]) --live;
+      present[slot] = false;
+    } else {
+      std::uint64_t value = 0;
+      bool found = list.search_element(key, value);
+      if (found != present[slot] || (found && value != key)) {
+        std::cerr << "search_element(" << key << ") returned " << found
+                  << std::endl;
+        failed.store(true);
+      }
+    }
+  }
+  return live;
+}
+
+template <typename ListType>
+bool run(ListType& list, const Config& config, const char* name) {
+  std::atomic<bool> failed{false};
+  std::vector<std::size_t> live(config.threads, 0);
+  std::vector<std::thread> threads;
+  for (int t = 0; t < config.threads; ++t) {
+    threads.emplace_back([&, t] {
+      live[t] = run_worker(list, config, t, failed);
+    });
+  }
+  for (auto& thread : threads) thread.join();
+
+  std::size_t expected = 0;
+  for (std::size_t n : live) expected += n;
+  std::size_t count = 0;
+  bool ordered = true;
+  {
+    bool first = true;
+    std::uint64_t prev = 0;
+    list.process_all([&](const std::uint64_t& key, const std::uint64_t&) {
+      if (!first && key <= prev) ordered = false;
+      prev = key;
+      first = false;
+      ++count;
+    });
+  }
+  const auto size = static_cast<std::size_t>(list.size());
+  if (!ordered) std::cerr << "keys are out of order" << std::endl;
+  if (count != expected || size != expected) {
+    std::cerr << "expected " << expected << " keys, iterated " << count
+              << ", size() " << size << std::endl;
+  }
+  bool ok = !failed.load() && ordered && count == expected &&
+            size == expected;
+  std::cout << name << (ok ? "ok" : "FAILED") << std::endl;
+  return ok;
+}
+
+bool parse_args(int argc, char* argv[], Config& config) {
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    std::size_t eq = arg.find('=');
+    std::string name = arg.substr(0, eq);
+    std::string value = eq == std::string::npos ? "" : arg.substr(eq + 1);
+    if (name == "--threads") {
+      config.threads = std::atoi(value.c_str());
+    } else if (name == "--ops") {
+      config.ops = std::strtoull(value.c_str(), nullptr, 10);
+    } else if (name == "--keys") {
+      config.keys = std::strtoull(value.c_str(), nullptr, 10);
+    } else {
+      std::cerr << "unknown option: " << arg << std::endl;
+      return false;
+    }
+  }
+  if (config.threads <= 0 ||
+      config.keys < static_cast<std::uint64_t>(config.threads)) {
+    std::cerr << "--threads must be positive and not exceed --keys"
+              << std::endl;
+    return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  Config config;
+  if (!parse_args(argc, argv, config)) {
+    std::cerr << "Usage: " << argv[0]
+              << " [--threads=N] [--ops=N] [--keys=N]" << std::endl;
+    return 1;
+  }
+  bool ok = true;
+  for (bool finger : {false, true}) {
+    List list;
+    list.set_finger_search(finger);
+    ok = run(list, config, finger ? "finger search " : "plain search  ") &&
+         ok;
+  }
+  {
+    LockFreeList list;
+    ok = run(list, config, "lock-free     ") && ok;
+  }
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,156 @@
+/**
+ * tiered_test.cpp - 分层存储（LSM）的正确性测试
+ *
+ * 开启 memtable_bytes 后随机 put / del，并穿插 dump()（把内存表写成有序表）
+ * 与 compact()（合并全部有序表），删除的 key 常常位于较旧的有序表中；
+ * 每一轮之后逐个 get、整体 scan 与 export_text 都与 std::map 中的预期
+ * 一致。之后重新打开，从清单恢复的有序表与回放的日志给出同样的结果。
+ * 分别在关闭与开启快照压缩（有序表前缀压缩）时运行一次。
+ * 出错时返回非零，由 ctest 运行
+ *
+ * 用法示例：
+ *   ./skiplist_tiered_test
+ */
+#include <algorithm>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <iterator>
+#include <map>
+#include <random>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "KVStore.h"
+#include "Workload.h"
+
+namespace {
+
+namespace fs = std::filesystem;
+
+using Store = KVStore<std::string, std::string>;
+using Expected = std::map<std::string, std::string>;
+
+constexpr std::uint64_t kKeys = 5000;
+
+std::string key_of(std::uint64_t i) {
+  std::string digits = std::to_string(i);
+  return "item" + std::string(6 - digits.size(), '0') + digits;
+}
+
+bool check_store(Store& store, const Expected& expected) {
+  bool ok = true;
+  for (std::uint64_t i = 0; i < kKeys && ok; ++i) {
+    std::string key = key_of(i);
+    std::string value;
+    bool found = store.get(key, value);
+    auto it = expected.find(key);
+    if (found != (it != expected.end()) || (found && value != it->second)) {
+      std::cerr << "get(" << key << ") returned " << found << std::endl;
+      ok = false;
+    }
+  }
+  std::vector<std::pair<std::string, std::string>> scanned;
+  store.scan(key_of(0), key_of(kKeys), 0,
+             [&](const std::string& key, const std::string& value) {
+               scanned.emplace_back(key, value);
+             });
+  if (scanned != std::vector<std::pair<std::string, std::string>>(
+                     expected.begin(), expected.end())) {
+    std::cerr << "scan returned " << scanned.size() << " records, expected "
+              << expected.size() << std::endl;
+    ok = false;
+  }
+  std::string text_path = store.path() + ".txt";
+  std::string text;
+  for (const auto& [key, value] : expected) text += key + ":" + value + "\n";
+  if (!store.export_text(text_path)) {
+    ok = false;
+  } else {
+    std::ifstream in(text_path, std::ios::binary);
+    std::string exported((std::istreambuf_iterator<char>(in)),
+                         std::istreambuf_iterator<char>());
+    if (exported != text) {
+      std::cerr << "export_text differs from the expected records"
+                << std::endl;
+      ok = false;
+    }
+  }
+  return ok;
+}
+
+bool run(const fs::path& root, SnapshotCompression compression) {
+  const char* name =
+      compression == SnapshotCompression::kNone ? "plain" : "prefix";
+  fs::path dir = root / name;
+  std::error_code ec;
+  fs::remove_all(dir, ec);
+  fs::create_directories(dir);
+  std::string path = (dir / "db").string();
+  KVStoreOptions<std::string> options;
+  options.shard_count = 2;
+  options.memtable_bytes = 64 * 1024;
+  options.compaction_trigger = 2;
+  options.wal_mode = WalMode::kNoSync;
+  options.snapshot_compression = compression;
+
+  bench::FastRandom random(5);
+  Expected expected;
+  bool ok = true;
+  std::size_t max_tables = 0;
+  {
+    Store store(path, options);
+    for (int round = 0; round < 8 && ok; ++round) {
+      for (int i = 0; i < 3000; ++i) {
+        std::string key = key_of(random.uniform(kKeys));
+        if (random.uniform(4) == 0) {
+          store.del(key);
+          expected.erase(key);
+        } else {
+          std::string value = std::to_string(round) + "-" + std::to_string(i);
+          store.put(key, value);
+          expected[key] = value;
+        }
+      }
+      ok = store.dump();
+      max_tables = std::max(max_tables, store.table_count());
+      if (round % 3 == 2) store.compact();
+      ok = check_store(store, expected) && ok;
+    }
+    // 最后一轮的写入只在内存表与日志中
+    for (int i = 0; i < 500; ++i) {
+      std::string key = key_of(random.uniform(kKeys));
+      store.del(key);
+      expected.erase(key);
+    }
+    ok = check_store(store, expected) && ok;
+  }
+  if (max_tables == 0) {
+    std::cerr << "no sorted table was written" << std::endl;
+    ok = false;
+  }
+  for (int reopen = 0; reopen < 2 && ok; ++reopen) {
+    Store store(path, options);
+    ok = check_store(store, expected);
+    if (reopen == 0) store.compact();
+  }
+  std::cout << "tiered " << name << " " << (ok ? "ok" : "FAILED")
+            << std::endl;
+  return ok;
+}
+
+}  // namespace
+
+int main() {
+  std::string name =
+      "skiplist_tiered_test_" + std::to_string(std::random_device{}());
+  fs::path root = fs::temp_directory_path() / name;
+  fs::create_directories(root);
+  bool ok = run(root, SnapshotCompression::kNone);
+  ok = run(root, SnapshotCompression::kKeys) && ok;
+  std::error_code ec;
+  if (ok) fs::remove_all(root, ec);
+  return ok ? 0 : 1;
+}
@@ -0,0 +1,329 @@
+/**
+ * wal_test.cpp - 预写日志的崩溃恢复测试
+ *
+ * 对每种 WalMode：用 WriteAheadLog 写入一串 put / del / clear 记录并关闭，
+ * 再把日志尾部截断一半、追加垃圾字节或翻转中间某条记录的一位，
+ * 校验 KVStore 回放出恰好是有效前缀的结果、把日志截到有效长度，
+ * 并且截断后继续追加的记录能被回放。
+ * 另外模拟检查点失败后残留的 <path>.wal.old：两次 dump() 都在写快照时失败，
+ * 第二次 rotate 把当前日志追加到旧日志之后；此时复制出全部文件当作崩溃现场，
+ * 重新打开后数据不能丢失，之后的 dump() 成功并删除旧日志。
+ * 出错时返回非零，由 ctest 运行
+ *
+ * 用法示例：
+ *   ./skiplist_wal_test
+ */
+#include <chrono>
+#include <cstdint>
+#include <cstdio>
+#include <filesystem>
+#include <iostream>
+#include <map>
+#include <random>
+#include <string>
+#include <vector>
+
+#include "KVStore.h"
+#include "Workload.h"
+
+namespace {
+
+namespace fs = std::filesystem;
+
+using Store = KVStore<std::string, std::string>;
+using Log = WriteAheadLog<std::string, std::string>;
+using Expected = std::map<std::string, std::string>;
+
+constexpr std::uint64_t kKeys = 200;
+
+struct Op {
+  wal::RecordType type;
+  std::string key;
+  std::string value;
+};
+
+std::string key_of(std::uint64_t i) {
+  std::string digits = std::to_string(i);
+  return "key" + std::string(6 - digits.size(), '0') + digits;
+}
+
+// 每个用例使用独立的空目录
+fs::path fresh_dir(const fs::path& root, const std::string& name) {
+  fs::path dir = root / name;
+  std::error_code ec;
+  fs::remove_all(dir, ec);
+  fs::create_directories(dir);
+  return dir;
+}
+
+std::vector<Op> make_ops(std::size_t n) {
+  bench::FastRandom random(42);
+  std::vector<Op> ops;
+  for (std::size_t i = 0; i < n; ++i) {
+    std::string key = key_of(random.uniform(kKeys));
+    if (i == n / 4) {
+      ops.push_back({wal::kClear, "", ""});
+    } else if (random.uniform(5) == 0) {
+      ops.push_back({wal::kDelete, key, ""});
+    } else {
+      ops.push_back({wal::kPut, key, "v" + std::to_string(i)});
+    }
+  }
+  return ops;
+}
+
+// 前 n 条记录回放后的预期内容
+Expected apply_prefix(const std::vector<Op>& ops, std::size_t n) {
+  Expected expected;
+  for (std::size_t i = 0; i < n; ++i) {
+    if (ops[i].type == wal::kPut) {
+      expected[ops[i].key] = ops[i].value;
+    } else if (ops[i].type == wal::kDelete) {
+      expected.erase(ops[i].key);
+    } else {
+      expected.clear();
+    }
+  }
+  return expected;
+}
+
+bool check_store(Store& store, const Expected& expected) {
+  bool ok = store.size() == expected.size();
+  for (std::uint64_t i = 0; i < kKeys && ok; ++i) {
+    std::string key = key_of(i);
+    std::string value;
+    bool found = store.get(key, value);
+    auto it = expected.find(key);
+    if (found != (it != expected.end()) || (found && value != it->second)) {
+      std::cerr << "get(" << key << ") returned " << found << std::endl;
+      ok = false;
+    }
+  }
+  if (store.size() != expected.size()) {
+    std::cerr << "expected " << expected.size() << " keys, size() "
+              << store.size() << std::endl;
+  }
+  return ok;
+}
+
+// 回放 path，返回有效记录数
+std::size_t count_records(const std::string& path, std::uint64_t& valid) {
+  std::size_t count = 0;
+  wal::replay<std::string, std::string>(
+      path,
+      [&](wal::RecordType, std::string&, std::string&, std::int64_t) {
+        ++count;
+      },
+      valid);
+  return count;
+}
+
+const char* mode_name(WalMode mode) {
+  switch (mode) {
+    case WalMode::kOff: return "off";
+    case WalMode::kNoSync: return "nosync";
+    case WalMode::kSync: return "sync";
+    case WalMode::kPeriodic: return "periodic";
+    case WalMode::kAsync: return "async";
+  }
+  return "?";
+}
+
+enum class Damage { kTorn, kGarbage, kBitFlip };
+
+// 写入全部记录后按 damage 破坏日志，返回仍然有效的记录数
+std::size_t write_damaged(const std::string& wal_path,
+                          const std::vector<Op>& ops,
+                          std::vector<std::uint64_t>& ends, Damage damage) {
+  std::uint64_t offset = 0;
+  for (const Op& op : ops) {
+    std::string record;
+    wal::encode<std::string, std::string>(
+        record, op.type, op.type == wal::kClear ? nullptr : &op.key,
+        op.type == wal::kPut ? &op.value : nullptr);
+    offset += record.size();
+    ends.push_back(offset);
+  }
+  {
+    // 以 kSync 写出，与打开日志时的模式无关
+    Log log;
+    log.open(wal_path, WalMode::kSync, std::chrono::milliseconds(10), 0);
+    for (const Op& op : ops) {
+      std::uint64_t seq =
+          log.append(op.type, op.type == wal::kClear ? nullptr : &op.key,
+                     op.type == wal::kPut ? &op.value : nullptr);
+      log.commit(seq);
+    }
+    log.close();
+  }
+  std::size_t n = ops.size();
+  if (damage == Damage::kTorn) {
+    // 最后一条记录只写出了一部分
+    fs::resize_file(wal_path, ends[n - 1] - 3);
+    return n - 1;
+  }
+  std::FILE* file = std::fopen(wal_path.c_str(), "r+b");
+  if (damage == Damage::kGarbage) {
+    std::fseek(file, 0, SEEK_END);
+    for (int i = 0; i < 13; ++i) std::fputc(0xA5 ^ i, file);
+    std::fclose(file);
+    return n;
+  }
+  // 翻转中间一条记录的一位，之后的记录全部作废
+  std::size_t bad = n / 2;
+  long pos = static_cast<long>(ends[bad - 1] + wal::kRecordHeaderSize + 1);
+  std::fseek(file, pos, SEEK_SET);
+  int c = std::fgetc(file);
+  std::fseek(file, pos, SEEK_SET);
+  std::fputc(c ^ 0x10, file);
+  std::fclose(file);
+  return bad;
+}
+
+bool run_replay(const fs::path& root, WalMode mode, Damage damage) {
+  static const char* kDamageNames[] = {"torn", "garbage", "bitflip"};
+  std::string name = std::string(mode_name(mode)) + "_" +
+                     kDamageNames[static_cast<int>(damage)];
+  fs::path dir = fresh_dir(root, name);
+  std::string path = (dir / "db").string();
+  std::string wal_path = path + ".wal";
+  std::vector<Op> ops = make_ops(500);
+  std::vector<std::uint64_t> ends;
+  std::size_t valid = write_damaged(wal_path, ops, ends, damage);
+  Expected expected = apply_prefix(ops, valid);
+
+  bool ok = true;
+  {
+    KVStoreOptions<std::string> options;
+    options.wal_mode = mode;
+    options.wal_sync_interval = std::chrono::milliseconds(10);
+    Store store(path, options);
+    ok = check_store(store, expected);
+    // 打开日志的模式下无效尾部已被截掉
+    if (mode != WalMode::kOff && fs::file_size(wal_path) != ends[valid - 1]) {
+      std::cerr << "WAL not truncated to " << ends[valid - 1] << " bytes, is "
+                << fs::file_size(wal_path) << std::endl;
+      ok = false;
+    }
+  }
+  // 析构时的 dump() 已包含全部修改
+  if (ok) {
+    Store store(path);
+    ok = check_store(store, expected);
+  }
+
+  // 截到有效长度后继续追加，新记录紧跟在有效前缀之后
+  std::string copy = (dir / "copy.wal").string();
+  {
+    std::vector<std::uint64_t> copy_ends;
+    std::size_t copy_valid = write_damaged(copy, ops, copy_ends, damage);
+    std::uint64_t size = 0;
+    count_records(copy, size);
+    Log log;
+    log.open(copy, mode == WalMode::kOff ? WalMode::kSync : mode,
+             std::chrono::milliseconds(10), size);
+    std::string key = "extra";
+    std::string value = "value";
+    log.commit(log.append(wal::kPut, &key, &value));
+    log.close();
+    std::size_t records = count_records(copy, size);
+    if (records != copy_valid + 1 || size != fs::file_size(copy)) {
+      std::cerr << "replayed " << records << " records after append, "
+                << "expected " << copy_valid + 1 << std::endl;
+      ok = false;
+    }
+  }
+  std::cout << "replay " << name << " " << (ok ? "ok" : "FAILED")
+            << std::endl;
+  return ok;
+}
+
+void put_range(Store& store, Expected& expected, const std::string& prefix,
+               int n) {
+  for (int i = 0; i < n; ++i) {
+    std::string key = key_of(i * 4);
+    std::string value = prefix + std::to_string(i);
+    store.put(key, value);
+    expected[key] = value;
+  }
+}
+
+// 复制 dir 中的全部文件到 to，相当于此刻崩溃后留在磁盘上的内容
+void copy_files(const fs::path& dir, const fs::path& to) {
+  for (const auto& entry : fs::directory_iterator(dir)) {
+    if (entry.is_regular_file()) {
+      fs::copy_file(entry.path(), to / entry.path().filename(),
+                    fs::copy_options::overwrite_existing);
+    }
+  }
+}
+
+bool run_old_wal(const fs::path& root) {
+  fs::path dir = fresh_dir(root, "old_wal");
+  fs::path crash = fresh_dir(root, "old_wal_crash");
+  std::string path = (dir / "db").string();
+  KVStoreOptions<std::string> options;
+  options.wal_mode = WalMode::kSync;
+  Expected expected;
+  bool ok = true;
+  {
+    Store store(path, options);
+    put_range(store, expected, "a", 40);
+    ok = store.dump() && ok;
+    // 临时快照的路径被目录占用，之后的 dump() 在写快照时失败
+    fs::create_directory(path + ".tmp");
+    put_range(store, expected, "b", 30);
+    store.del(key_of(0));
+    expected.erase(key_of(0));
+    ok = !store.dump() && ok;
+    if (!fs::exists(path + ".wal.old")) {
+      std::cerr << "old WAL missing after a failed dump" << std::endl;
+      ok = false;
+    }
+    // 旧日志仍然存在：rotate 把当前日志追加到其后
+    put_range(store, expected, "c", 20);
+    ok = !store.dump() && ok;
+    put_range(store, expected, "d", 10);
+    copy_files(dir, crash);
+    fs::remove(path + ".tmp");
+  }
+  std::string crash_path = (crash / "db").string();
+  {
+    Store store(crash_path, options);
+    ok = check_store(store, expected) && ok;
+    // 回放了旧日志的实例第一次检查点成功后删除旧日志
+    store.put(key_of(1), "e");
+    expected[key_of(1)] = "e";
+    ok = store.dump() && ok;
+    if (fs::exists(crash_path + ".wal.old")) {
+      std::cerr << "old WAL left after a successful dump" << std::endl;
+      ok = false;
+    }
+  }
+  {
+    Store store(crash_path);
+    ok = check_store(store, expected) && ok;
+  }
+  std::cout << "old WAL at startup " << (ok ? "ok" : "FAILED") << std::endl;
+  return ok;
+}
+
+}  // namespace
+
+int main() {
+  std::string name =
+      "skiplist_wal_test_" + std::to_string(std::random_device{}());
+  fs::path root = fs::temp_directory_path() / name;
+  fs::create_directories(root);
+  bool ok = true;
+  for (WalMode mode : {WalMode::kOff, WalMode::kNoSync, WalMode::kSync,
+                       WalMode::kPeriodic, WalMode::kAsync}) {
+    for (Damage damage : {Damage::kTorn, Damage::kGarbage, Damage::kBitFlip}) {
+      ok = run_replay(root, mode, damage) && ok;
+    }
+  }
+  ok = run_old_wal(root) && ok;
+  std::error_code ec;
+  if (ok) fs::remove_all(root, ec);
+  return ok ? 0 : 1;
+}
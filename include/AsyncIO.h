@@ -0,0 +1,748 @@
+// include/AsyncIO.h - 持久化使用的异步文件 I/O 引擎
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <future>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <new>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <cerrno>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// Linux 上默认使用 io_uring（直接通过系统调用，不依赖 liburing），
+// 定义 SKIPLIST_NO_IO_URING 可强制使用线程池
+#if defined(__linux__) && !defined(SKIPLIST_NO_IO_URING) && \
+    __has_include(<linux/io_uring.h>)
+#define SKIPLIST_IO_URING 1
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#endif
+
+#include "Metrics.h"
+
+namespace aio {
+
+// O_DIRECT 要求内存地址、长度与文件偏移都按块对齐，统一按页对齐
+constexpr std::size_t kAlignment = 4096;
+
+// 按 kAlignment 对齐、容量固定的缓冲区
+class AlignedBuffer {
+ public:
+  AlignedBuffer() = default;
+  explicit AlignedBuffer(std::size_t capacity)
+      : data_(static_cast<char*>(::operator new(
+            capacity, std::align_val_t(kAlignment)))),
+        capacity_(capacity) {}
+  ~AlignedBuffer() { release(); }
+
+  AlignedBuffer(AlignedBuffer&& other) noexcept
+      : data_(std::exchange(other.data_, nullptr)),
+        size_(std::exchange(other.size_, 0)),
+        capacity_(std::exchange(other.capacity_, 0)) {}
+  AlignedBuffer& operator=(AlignedBuffer&& other) noexcept {
+    if (this != &other) {
+      release();
+      data_ = std::exchange(other.data_, nullptr);
+      size_ = std::exchange(other.size_, 0);
+      capacity_ = std::exchange(other.capacity_, 0);
+    }
+    return *this;
+  }
+
+  char* data() { return data_; }
+  const char* data() const { return data_; }
+  std::size_t size() const { return size_; }
+  std::size_t capacity() const { return capacity_; }
+  std::size_t room() const { return capacity_ - size_; }
+
+  // 追加至多 room() 字节，返回实际追加的字节数
+  std::size_t append(const char* p, std::size_t n) {
+    n = std::min(n, room());
+    std::memcpy(data_ + size_, p, n);
+    size_ += n;
+    return n;
+  }
+
+  // 以 0 填充到 kAlignment 的整数倍（O_DIRECT 写出最后一块时使用）
+  void pad() {
+    std::size_t padded = (size_ + kAlignment - 1) / kAlignment * kAlignment;
+    std::memset(data_ + size_, 0, padded - size_);
+    size_ = padded;
+  }
+
+  void clear() { size_ = 0; }
+
+ private:
+  void release() {
+    if (data_ != nullptr) {
+      ::operator delete(data_, std::align_val_t(kAlignment));
+    }
+    data_ = nullptr;
+  }
+
+  char* data_ = nullptr;
+  std::size_t size_ = 0;
+  std::size_t capacity_ = 0;
+};
+
+enum class Op { kRead, kWrite, kSync };
+
+// 一次 I/O 请求。读写 [data, data + size)，offset 为 -1 时从文件的当前位置
+// 读写（O_APPEND 打开时即追加到末尾）；kSync 为 fdatasync。
+// 完成时调用 done(result)：读写的总字节数（读到文件末尾时可能小于 size），
+// 失败时为 -errno。短读写由引擎继续提交剩余部分，调用方无需处理
+struct Request {
+  Op op = Op::kWrite;
+  int fd = -1;
+  char* data = nullptr;
+  std::size_t size = 0;
+  std::int64_t offset = -1;
+  std::function<void(long)> done;
+};
+
+// 异步 I/O 引擎：submit() 只把请求交给内核（io_uring）或线程池后立即返回，
+// 完成回调在引擎的线程中执行。
+// - 请求之间不保证顺序，需要先写后同步时在写的回调中再提交同步；
+// - 回调应当很短，不能等待同一个引擎上的其他请求完成，但可以提交新请求；
+// - 线程池也用于 io_uring 不可用（内核过旧或被禁用）的情况
+class Engine {
+ public:
+  // 进程内共享的引擎，第一次使用时创建。有意不析构：全局的 KVStore
+  // 在进程退出、静态对象析构时落盘，仍需要使用它
+  static Engine& shared() {
+    static Engine* engine = new Engine();
+    return *engine;
+  }
+
+  explicit Engine(std::size_t threads = 2, unsigned queue_depth = 256) {
+#if defined(SKIPLIST_IO_URING)
+    if (ring_.open(queue_depth)) {
+      reaper_ = std::thread([this] { reap_loop(); });
+      return;
+    }
+#else
+    (void)queue_depth;
+#endif
+    for (std::size_t i = 0; i < std::max<std::size_t>(threads, 1); ++i) {
+      workers_.emplace_back([this] { work_loop(); });
+    }
+  }
+
+  // 等待所有已提交的请求完成
+  ~Engine() {
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      idle_cv_.wait(lock, [this] { return in_flight_ == 0; });
+      stop_ = true;
+    }
+    cv_.notify_all();
+    for (std::thread& worker : workers_) worker.join();
+#if defined(SKIPLIST_IO_URING)
+    if (reaper_.joinable()) {
+      if (ring_.submit_stop()) {
+        reaper_.join();
+      } else {
+        // 没有在途请求，reaper_ 阻塞在内核中不会再访问环，放弃等待它
+        std::cerr << "Cannot stop the io_uring reaper thread" << std::endl;
+        reaper_.detach();
+      }
+    }
+#endif
+  }
+
+  Engine(const Engine&) = delete;
+  Engine& operator=(const Engine&) = delete;
+
+  bool uses_io_uring() const {
+#if defined(SKIPLIST_IO_URING)
+    return ring_.is_open();
+#else
+    return false;
+#endif
+  }
+
+  void submit(Request request) {
+#if defined(_WIN32)
+    if (request.done) request.done(-1);  // 暂不支持 Windows
+#else
+    auto* pending = new Pending{std::move(request), 0, {}};
+    {
+      std::unique_lock<std::mutex> lock(mutex_);
+      // 在途请求数不超过完成队列的容量；回调中提交的后续请求不等待，
+      // 否则引擎线程会等待自己（io_uring 的完成队列满时由内核暂存）
+      if (!on_engine_thread()) {
+        idle_cv_.wait(lock, [this] { return in_flight_ < max_in_flight(); });
+      }
+      ++in_flight_;
+#if defined(SKIPLIST_IO_URING)
+      if (ring_.is_open()) {
+        long error = ring_.submit(pending);
+        if (error == 0) return;
+        // 回调可能再提交请求，在锁外结束
+        lock.unlock();
+        finish(pending, error);
+        return;
+      }
+#endif
+      queue_.push_back(pending);
+    }
+    cv_.notify_one();
+#endif
+  }
+
+  // 以 future 返回结果的便捷版本；data 在完成前必须保持有效
+  std::future<long> write(int fd, const char* data, std::size_t size,
+                          std::int64_t offset) {
+    return submit_future(Op::kWrite, fd, const_cast<char*>(data), size, offset);
+  }
+  std::future<long> read(int fd, char* data, std::size_t size,
+                         std::int64_t offset) {
+    return submit_future(Op::kRead, fd, data, size, offset);
+  }
+  std::future<long> sync(int fd) {
+    return submit_future(Op::kSync, fd, nullptr, 0, -1);
+  }
+
+ private:
+  struct Pending {
+    Request request;
+    std::size_t transferred;  // 已完成的字节数
+    // 提交时 release、完成时 acquire：经由内核传递的先后关系
+    // 对 ThreadSanitizer 等工具可见，代价相对系统调用可以忽略
+    std::atomic<bool> submitted{false};
+  };
+
+  static bool& on_engine_thread() {
+    static thread_local bool flag = false;
+    return flag;
+  }
+
+  std::future<long> submit_future(Op op, int fd, char* data, std::size_t size,
+                                  std::int64_t offset) {
+    auto promise = std::make_shared<std::promise<long>>();
+    std::future<long> future = promise->get_future();
+    submit({op, fd, data, size, offset,
+            [promise](long result) { promise->set_value(result); }});
+    return future;
+  }
+
+  std::size_t max_in_flight() const {
+#if defined(SKIPLIST_IO_URING)
+    if (ring_.is_open()) return ring_.cq_entries();
+#endif
+    return static_cast<std::size_t>(-1);
+  }
+
+  // 一次系统调用完成了 result 字节（或失败）后调用：
+  // 还有剩余时返回 true，由调用方继续提交
+  static bool advance(Pending* pending, long result, long& final_result) {
+    Request& request = pending->request;
+    if (result < 0) {
+      final_result = result;
+      return false;
+    }
+    pending->transferred += static_cast<std::size_t>(result);
+    bool more = request.op != Op::kSync && result > 0 &&
+                pending->transferred < request.size;
+    final_result = static_cast<long>(pending->transferred);
+    return more;
+  }
+
+  void finish(Pending* pending, long result) {
+    if (pending->request.done) pending->request.done(result);
+    delete pending;
+    std::lock_guard<std::mutex> guard(mutex_);
+    --in_flight_;
+    idle_cv_.notify_all();
+  }
+
+#if !defined(_WIN32)
+  // 线程池：同步地执行一个请求的全部系统调用
+  static long execute(Pending* pending) {
+    Request& request = pending->request;
+    long result = 0;
+    for (;;) {
+      char* p = request.data + pending->transferred;
+      std::size_t left = request.size - pending->transferred;
+      const auto done = static_cast<std::int64_t>(pending->transferred);
+      std::int64_t offset = request.offset < 0 ? -1 : request.offset + done;
+      long n;
+      if (request.op == Op::kSync) {
+#if defined(__APPLE__)
+        n = ::fsync(request.fd);
+#else
+        n = ::fdatasync(request.fd);
+#endif
+      } else if (request.op == Op::kWrite) {
+        n = offset < 0 ? ::write(request.fd, p, left)
+                       : ::pwrite(request.fd, p, left, offset);
+      } else {
+        n = offset < 0 ? ::read(request.fd, p, left)
+                       : ::pread(request.fd, p, left, offset);
+      }
+      if (n < 0) {
+        if (errno == EINTR) continue;
+        n = -errno;
+      }
+      if (!advance(pending, n, result)) return result;
+    }
+  }
+#endif
+
+  void work_loop() {
+#if !defined(_WIN32)
+    on_engine_thread() = true;
+    std::unique_lock<std::mutex> lock(mutex_);
+    for (;;) {
+      cv_.wait(lock, [this] { return stop_ || !queue_.empty(); });
+      if (queue_.empty()) return;  // stop_ 且没有剩余请求
+      Pending* pending = queue_.front();
+      queue_.pop_front();
+      lock.unlock();
+      finish(pending, execute(pending));
+      lock.lock();
+    }
+#endif
+  }
+
+#if defined(SKIPLIST_IO_URING)
+  // 直接基于系统调用的最小 io_uring 封装：提交时持有 Engine::mutex_，
+  // 完成队列只由 reaper_ 线程消费
+  class Ring {
+   public:
+    ~Ring() { close(); }
+
+    bool open(unsigned entries) {
+      io_uring_params params;
+      std::memset(&params, 0, sizeof(params));
+      fd_ = static_cast<int>(::syscall(__NR_io_uring_setup, entries, &params));
+      if (fd_ < 0) return false;
+      // 写到当前文件位置（offset 为 -1）需要 IORING_FEAT_RW_CUR_POS
+      if ((params.features & IORING_FEAT_RW_CUR_POS) == 0 ||
+          (params.features & IORING_FEAT_NODROP) == 0) {
+        close();
+        return false;
+      }
+      sq_size_ = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+      cq_size_ =
+          params.cq_off.cqes + params.cq_entries * sizeof(io_uring_cqe);
+      bool single = (params.features & IORING_FEAT_SINGLE_MMAP) != 0;
+      if (single) sq_size_ = cq_size_ = std::max(sq_size_, cq_size_);
+      sq_ring_ = map(sq_size_, IORING_OFF_SQ_RING);
+      cq_ring_ = single ? sq_ring_ : map(cq_size_, IORING_OFF_CQ_RING);
+      sqes_size_ = params.sq_entries * sizeof(io_uring_sqe);
+      void* sqes = map(sqes_size_, IORING_OFF_SQES);
+      if (sq_ring_ == nullptr || cq_ring_ == nullptr || sqes == nullptr) {
+        if (sqes != nullptr) ::munmap(sqes, sqes_size_);
+        close();
+        return false;
+      }
+      sqes_ = static_cast<io_uring_sqe*>(sqes);
+      char* sq = static_cast<char*>(sq_ring_);
+      char* cq = static_cast<char*>(cq_ring_);
+      sq_head_ = reinterpret_cast<unsigned*>(sq + params.sq_off.head);
+      sq_tail_ = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+      sq_mask_ = *reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+      sq_array_ = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+      cq_head_ = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+      cq_tail_ = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+      cq_mask_ = *reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+      cqes_ = reinterpret_cast<io_uring_cqe*>(cq + params.cq_off.cqes);
+      cq_entries_ = params.cq_entries;
+      return true;
+    }
+
+    bool is_open() const { return sqes_ != nullptr; }
+    std::size_t cq_entries() const { return cq_entries_; }
+
+    // 提交 pending 中从 transferred 开始的剩余部分；调用方持有提交锁。
+    // 每次只提交一项并立即进入内核，提交队列不会积压。
+    // 成功返回 0；内核拒绝提交时撤回该项并返回 -errno，
+    // 不会产生完成项，由调用方结束请求
+    long submit(Pending* pending) {
+      const Request& request = pending->request;
+      unsigned tail = *sq_tail_;
+      unsigned index = tail & sq_mask_;
+      io_uring_sqe* sqe = &sqes_[index];
+      std::memset(sqe, 0, sizeof(*sqe));
+      sqe->fd = request.fd;
+      sqe->user_data = reinterpret_cast<std::uint64_t>(pending);
+      if (request.op == Op::kSync) {
+        sqe->opcode = IORING_OP_FSYNC;
+        sqe->fsync_flags = IORING_FSYNC_DATASYNC;
+      } else {
+        sqe->opcode =
+            request.op == Op::kWrite ? IORING_OP_WRITE : IORING_OP_READ;
+        char* data = request.data + pending->transferred;
+        sqe->addr = reinterpret_cast<std::uint64_t>(data);
+        sqe->len = static_cast<unsigned>(std::min<std::size_t>(
+            request.size - pending->transferred, 1u << 30));
+        sqe->off = request.offset < 0
+                       ? static_cast<std::uint64_t>(-1)
+                       : static_cast<std::uint64_t>(request.offset) +
+                             pending->transferred;
+      }
+      sq_array_[index] = index;
+      pending->submitted.store(true, std::memory_order_release);
+      return enter(tail);
+    }
+
+    // user_data 为 0 的 NOP 通知 reaper_ 退出；提交失败时返回 false
+    bool submit_stop() {
+      unsigned tail = *sq_tail_;
+      unsigned index = tail & sq_mask_;
+      std::memset(&sqes_[index], 0, sizeof(io_uring_sqe));
+      sqes_[index].opcode = IORING_OP_NOP;
+      sq_array_[index] = index;
+      return enter(tail) == 0;
+    }
+
+    // 取出一个完成项，没有时阻塞等待
+    void wait(std::uint64_t& user_data, int& result) {
+      for (;;) {
+        unsigned head = *cq_head_;
+        unsigned tail = std::atomic_ref<unsigned>(*cq_tail_).load(
+            std::memory_order_acquire);
+        if (head != tail) {
+          const io_uring_cqe& cqe = cqes_[head & cq_mask_];
+          user_data = cqe.user_data;
+          result = cqe.res;
+          std::atomic_ref<unsigned>(*cq_head_).store(head + 1,
+                                                     std::memory_order_release);
+          return;
+        }
+        ::syscall(__NR_io_uring_enter, fd_, 0, 1, IORING_ENTER_GETEVENTS,
+                  nullptr, 0);
+      }
+    }
+
+   private:
+    // 发布位于 tail 的一项并进入内核，暂时性的错误重试。
+    // 其他错误时内核没有取走该项（头部未越过它），撤回尾部并返回 -errno
+    long enter(unsigned tail) {
+      std::atomic_ref<unsigned>(*sq_tail_).store(tail + 1,
+                                                 std::memory_order_release);
+      for (;;) {
+        if (::syscall(__NR_io_uring_enter, fd_, 1, 0, 0, nullptr, 0) >= 0) {
+          return 0;
+        }
+        if (errno != EINTR && errno != EAGAIN && errno != EBUSY) break;
+      }
+      long error = -errno;
+      // 已被取走的项照常产生完成项
+      if (std::atomic_ref<unsigned>(*sq_head_).load(
+              std::memory_order_acquire) != tail) {
+        return 0;
+      }
+      std::atomic_ref<unsigned>(*sq_tail_).store(tail,
+                                                 std::memory_order_release);
+      return error;
+    }
+
+    void* map(std::size_t size, off_t offset) {
+      void* p = ::mmap(nullptr, size, PROT_READ | PROT_WRITE,
+                       MAP_SHARED | MAP_POPULATE, fd_, offset);
+      return p == MAP_FAILED ? nullptr : p;
+    }
+
+    void close() {
+      if (sqes_ != nullptr) ::munmap(sqes_, sqes_size_);
+      if (cq_ring_ != nullptr && cq_ring_ != sq_ring_) {
+        ::munmap(cq_ring_, cq_size_);
+      }
+      if (sq_ring_ != nullptr) ::munmap(sq_ring_, sq_size_);
+      if (fd_ >= 0) ::close(fd_);
+      sqes_ = nullptr;
+      sq_ring_ = cq_ring_ = nullptr;
+      fd_ = -1;
+    }
+
+    int fd_ = -1;
+    void* sq_ring_ = nullptr;
+    void* cq_ring_ = nullptr;
+    std::size_t sq_size_ = 0;
+    std::size_t cq_size_ = 0;
+    std::size_t sqes_size_ = 0;
+    io_uring_sqe* sqes_ = nullptr;
+    unsigned* sq_head_ = nullptr;
+    unsigned* sq_tail_ = nullptr;
+    unsigned sq_mask_ = 0;
+    unsigned* sq_array_ = nullptr;
+    unsigned* cq_head_ = nullptr;
+    unsigned* cq_tail_ = nullptr;
+    unsigned cq_mask_ = 0;
+    io_uring_cqe* cqes_ = nullptr;
+    std::size_t cq_entries_ = 0;
+  };
+
+  void reap_loop() {
+    on_engine_thread() = true;
+    for (;;) {
+      std::uint64_t user_data;
+      int res;
+      ring_.wait(user_data, res);
+      if (user_data == 0) return;
+      auto* pending = reinterpret_cast<Pending*>(user_data);
+      pending->submitted.load(std::memory_order_acquire);
+      long result;
+      if (res == -EINTR || res == -EAGAIN || advance(pending, res, result)) {
+        {
+          std::lock_guard<std::mutex> guard(mutex_);
+          result = ring_.submit(pending);
+        }
+        if (result == 0) continue;
+      }
+      finish(pending, result);
+    }
+  }
+
+  Ring ring_;
+  std::thread reaper_;
+#endif
+
+  std::mutex mutex_;
+  std::condition_variable cv_;       // 线程池等待新请求
+  std::condition_variable idle_cv_;  // 等待在途请求减少
+  std::deque<Pending*> queue_;
+  std::size_t in_flight_ = 0;
+  bool stop_ = false;
+  std::vector<std::thread> workers_;
+};
+
+// 顺序写文件：数据先复制进对齐的缓冲区，写满时把整块交给引擎异步写出、
+// 换另一块继续写，调用方编码下一块数据时上一块正在写盘。
+// direct 为 true 时以 O_DIRECT 打开，绕过页缓存（文件系统不支持时退化为
+// 普通写）；最后不足一块对齐长度的部分补 0 写出后再截断到实际长度。
+// close() 在关闭前 fdatasync，调用方随后 rename 替换旧文件时数据已经落盘
+class FileWriter {
+ public:
+  explicit FileWriter(std::size_t buffer_size = 1 << 20,
+                      Engine& engine = Engine::shared())
+      : engine_(engine),
+        buffer_size_((std::max(buffer_size, kAlignment) + kAlignment - 1) /
+                     kAlignment * kAlignment) {}
+  ~FileWriter() { close(); }
+
+  FileWriter(const FileWriter&) = delete;
+  FileWriter& operator=(const FileWriter&) = delete;
+
+  bool open(const std::string& path, bool direct = false) {
+    close();
+    path_ = path;
+    offset_ = 0;
+    failed_.store(false, std::memory_order_relaxed);
+    patches_.clear();
+#if defined(_WIN32)
+    (void)direct;
+    out_.open(path, std::ios::binary | std::ios::trunc);
+    return out_.is_open();
+#else
+    const int flags = O_WRONLY | O_CREAT | O_TRUNC;
+    direct_ = false;
+#if defined(O_DIRECT)
+    if (direct) {
+      fd_ = ::open(path.c_str(), flags | O_DIRECT, 0644);
+      direct_ = fd_ >= 0;
+    }
+#else
+    (void)direct;
+#endif
+    if (fd_ < 0) fd_ = ::open(path.c_str(), flags, 0644);
+    if (fd_ < 0) return false;
+    for (AlignedBuffer& buffer : buffers_) {
+      if (buffer.capacity() == 0) buffer = AlignedBuffer(buffer_size_);
+      buffer.clear();
+    }
+    current_ = 0;
+    return true;
+#endif
+  }
+
+  bool is_open() const {
+#if defined(_WIN32)
+    return out_.is_open();
+#else
+    return fd_ >= 0;
+#endif
+  }
+
+  bool direct() const { return direct_; }
+
+  // 已写入（含缓冲中）的字节数
+  std::uint64_t size() const {
+#if defined(_WIN32)
+    return offset_;
+#else
+    return offset_ + buffers_[current_].size();
+#endif
+  }
+
+  void write(const char* p, std::size_t n) {
+#if defined(_WIN32)
+    out_.write(p, static_cast<std::streamsize>(n));
+    offset_ += n;
+#else
+    while (n > 0) {
+      std::size_t copied = buffers_[current_].append(p, n);
+      p += copied;
+      n -= copied;
+      if (buffers_[current_].room() == 0) flush_current();
+    }
+#endif
+  }
+
+  // 在 close() 时覆盖 [offset, offset + data.size())，用于回填文件头
+  void patch(std::uint64_t offset, std::string data) {
+    patches_.emplace_back(offset, std::move(data));
+  }
+
+  bool good() const { return !failed_.load(std::memory_order_acquire); }
+
+  // 写出剩余数据、应用回填、同步并关闭；任何 I/O 错误都返回 false
+  bool close() {
+#if defined(_WIN32)
+    if (!out_.is_open()) return good();
+    for (const auto& [offset, data] : patches_) {
+      out_.seekp(static_cast<std::streamoff>(offset));
+      out_.write(data.data(), static_cast<std::streamsize>(data.size()));
+    }
+    patches_.clear();
+    out_.close();
+    if (out_.fail()) failed_.store(true, std::memory_order_relaxed);
+    return good();
+#else
+    if (fd_ < 0) return good();
+    const std::uint64_t total = size();
+    AlignedBuffer& tail = buffers_[current_];
+    if (tail.size() > 0) {
+      if (direct_) tail.pad();
+      flush_current();
+    }
+    wait_idle();
+    if (direct_ && ::ftruncate(fd_, static_cast<off_t>(total)) != 0) {
+      failed_.store(true, std::memory_order_relaxed);
+    }
+    if (!patches_.empty()) {
+      // O_DIRECT 不能写未对齐的小块，回填通过普通的文件描述符进行
+      int fd = direct_ ? ::open(path_.c_str(), O_WRONLY) : fd_;
+      for (const auto& [offset, data] : patches_) {
+        if (fd < 0 || ::pwrite(fd, data.data(), data.size(),
+                               static_cast<off_t>(offset)) !=
+                          static_cast<ssize_t>(data.size())) {
+          failed_.store(true, std::memory_order_relaxed);
+        }
+      }
+      if (fd >= 0 && fd != fd_) ::close(fd);
+      patches_.clear();
+    }
+#if defined(__APPLE__)
+    if (::fsync(fd_) != 0) failed_.store(true, std::memory_order_relaxed);
+#else
+    if (::fdatasync(fd_) != 0) failed_.store(true, std::memory_order_relaxed);
+#endif
+    if (::close(fd_) != 0) failed_.store(true, std::memory_order_relaxed);
+    fd_ = -1;
+    offset_ = total;
+    return good();
+#endif
+  }
+
+ private:
+#if !defined(_WIN32)
+  // 把当前块交给引擎写出，等另一块写完后切换过去
+  void flush_current() {
+    AlignedBuffer& buffer = buffers_[current_];
+    const std::size_t size = buffer.size();
+    {
+      std::lock_guard<std::mutex> guard(mutex_);
+      busy_[current_] = true;
+    }
+    const std::size_t index = current_;
+    engine_.submit({Op::kWrite, fd_, buffer.data(), size,
+                    static_cast<std::int64_t>(offset_),
+                    [this, index, size](long result) {
+                      std::lock_guard<std::mutex> guard(mutex_);
+                      if (result != static_cast<long>(size)) {
+                        failed_.store(true, std::memory_order_release);
+                      }
+                      busy_[index] = false;
+                      cv_.notify_all();
+                    }});
+    offset_ += size;
+    current_ ^= 1;
+    SKIPLIST_METRICS_TIMER(timer);
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [this] { return !busy_[current_]; });
+    SKIPLIST_METRICS_LAP(timer, kFileIoWait);
+    buffers_[current_].clear();
+  }
+
+  void wait_idle() {
+    SKIPLIST_METRICS_TIMER(timer);
+    std::unique_lock<std::mutex> lock(mutex_);
+    cv_.wait(lock, [this] { return !busy_[0] && !busy_[1]; });
+    SKIPLIST_METRICS_LAP(timer, kFileIoWait);
+  }
+#endif
+
+  Engine& engine_;
+  std::size_t buffer_size_;
+  std::string path_;
+  std::uint64_t offset_ = 0;  // 已交给引擎的字节数
+  std::atomic<bool> failed_{false};
+  std::vector<std::pair<std::uint64_t, std::string>> patches_;
+#if defined(_WIN32)
+  std::ofstream out_;
+#else
+  int fd_ = -1;
+  AlignedBuffer buffers_[2];
+  std::size_t current_ = 0;
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  bool busy_[2] = {false, false};  // 对应的块正在写出
+#endif
+  bool direct_ = false;
+};
+
+// 同步 path 指向的文件或目录，用于不经过 FileWriter 写出的小文件
+inline bool sync_path(const std::string& path) {
+#if defined(_WIN32)
+  (void)path;
+  return true;
+#else
+  int fd = ::open(path.c_str(), O_RDONLY);
+  if (fd < 0) return false;
+  bool ok = ::fsync(fd) == 0;
+  ::close(fd);
+  return ok;
+#endif
+}
+
+// 同步 path 所在的目录，使其中的 rename、创建与删除在掉电后仍然有效；
+// 文件本身的数据需另行同步（见 FileWriter::close）
+inline bool sync_parent_directory(const std::string& path) {
+  std::filesystem::path dir = std::filesystem::path(path).parent_path();
+  return sync_path(dir.empty() ? std::string(".") : dir.string());
+}
+
+}  // namespace aio
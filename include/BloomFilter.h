@@ -0,0 +1,150 @@
+// include/BloomFilter.h - 分块 Bloom filter 与稳定的 key 哈希
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+#include "Serializer.h"
+
+namespace bloom {
+
+// 把 64 位整数打散（splitmix64 的终结函数）
+inline std::uint64_t mix64(std::uint64_t x) {
+  x = (x ^ (x >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  x = (x ^ (x >> 27)) * 0x94D049BB133111EBULL;
+  return x ^ (x >> 31);
+}
+
+// 字节串的 64 位哈希：每次吸收 8 字节。过滤器会写入文件，
+// 哈希值必须与平台和运行无关，不能使用 std::hash
+inline std::uint64_t hash_bytes(const char* data, std::size_t n) {
+  std::uint64_t h = 0x9E3779B97F4A7C15ULL ^ (n * 0xC2B2AE3D27D4EB4FULL);
+  while (n >= 8) {
+    h = mix64(h ^ serial::decode_fixed<std::uint64_t>(data));
+    data += 8;
+    n -= 8;
+  }
+  std::uint64_t tail = 0;
+  for (std::size_t i = 0; i < n; ++i) {
+    tail |= static_cast<std::uint64_t>(static_cast<unsigned char>(data[i]))
+            << (8 * i);
+  }
+  return mix64(h ^ tail);
+}
+
+// key 的哈希：字符串直接哈希字节，整数与枚举打散其值，
+// 其他类型哈希其序列化结果
+template <typename K>
+std::uint64_t hash_key(const K& key) {
+  if constexpr (std::is_convertible_v<const K&, std::string_view>) {
+    std::string_view view(key);
+    return hash_bytes(view.data(), view.size());
+  } else if constexpr (std::is_integral_v<K> || std::is_enum_v<K>) {
+    return mix64(static_cast<std::uint64_t>(key) + 0x9E3779B97F4A7C15ULL);
+  } else {
+    std::string bytes;
+    Serializer<K>::write(bytes, key);
+    return hash_bytes(bytes.data(), bytes.size());
+  }
+}
+
+// 无需特化 Serializer 即可由 hash_key 计算哈希的类型：
+// 字符串、算术类型、枚举，以及支持 operator<< 的类型
+template <typename K>
+concept hashable =
+    std::is_convertible_v<const K&, std::string_view> ||
+    std::is_arithmetic_v<K> || std::is_enum_v<K> ||
+    requires(std::ostream& out, const K& key) { out << key; };
+
+}  // namespace bloom
+
+// 分块 Bloom filter：位数组按 512 位（一条 cache line）分块，
+// 哈希值的高 32 位选块，低 32 位在块内生成全部探测位，
+// 一次查询只访问一条 cache line。
+// 代价是同样位数下误判率略高于标准 Bloom filter：每个 key 10 位时约 1%。
+// 序列化格式：块数据 | 探测次数 u8，可以直接在映射内存上查询（见 may_contain）
+class BloomFilter {
+ public:
+  static constexpr std::size_t kBlockBytes = 64;
+
+  BloomFilter() = default;
+
+  // 为约 n 个 key 构造空过滤器，每个 key 占 bits_per_key 位
+  BloomFilter(std::size_t n, int bits_per_key) {
+    bits_per_key = std::max(bits_per_key, 1);
+    // 探测次数取 bits_per_key · ln2 时误判率最低
+    int probes = static_cast<int>(bits_per_key * 0.69 + 0.5);
+    probes = std::clamp(probes, 1, 30);
+    std::size_t bits = std::max<std::size_t>(n, 1) * bits_per_key;
+    std::size_t blocks = (bits + kBlockBytes * 8 - 1) / (kBlockBytes * 8);
+    data_.assign(blocks * kBlockBytes + 1, '\0');
+    data_.back() = static_cast<char>(probes);
+  }
+
+  // 从 serialize() 的结果恢复
+  explicit BloomFilter(std::string_view data) : data_(data) {}
+
+  bool empty() const { return data_.empty(); }
+
+  void add_hash(std::uint64_t h) {
+    if (data_.empty()) return;
+    char* block = data_.data() + block_offset(data_, h);
+    std::uint32_t g = static_cast<std::uint32_t>(h);
+    std::uint32_t delta = (g >> 17) | (g << 15);
+    for (int i = 0; i < probes(data_); ++i) {
+      std::uint32_t bit = g & (kBlockBytes * 8 - 1);
+      block[bit >> 3] = static_cast<char>(block[bit >> 3] | (1 << (bit & 7)));
+      g += delta;
+    }
+  }
+
+  template <typename K>
+  void add(const K& key) {
+    add_hash(bloom::hash_key(key));
+  }
+
+  bool may_contain_hash(std::uint64_t h) const {
+    return may_contain(data_, h);
+  }
+
+  template <typename K>
+  bool may_contain(const K& key) const {
+    return may_contain(data_, bloom::hash_key(key));
+  }
+
+  // 在序列化的过滤器上查询；data 为空或格式不对时总是返回 true
+  static bool may_contain(std::string_view data, std::uint64_t h) {
+    if (data.size() <= kBlockBytes || (data.size() - 1) % kBlockBytes != 0) {
+      return true;
+    }
+    const char* block = data.data() + block_offset(data, h);
+    std::uint32_t g = static_cast<std::uint32_t>(h);
+    std::uint32_t delta = (g >> 17) | (g << 15);
+    for (int i = 0; i < probes(data); ++i) {
+      std::uint32_t bit = g & (kBlockBytes * 8 - 1);
+      if ((block[bit >> 3] & (1 << (bit & 7))) == 0) return false;
+      g += delta;
+    }
+    return true;
+  }
+
+  const std::string& serialize() const { return data_; }
+
+ private:
+  static std::size_t block_offset(std::string_view data, std::uint64_t h) {
+    std::uint64_t blocks = (data.size() - 1) / kBlockBytes;
+    // (hi · blocks) >> 32 把 32 位哈希均匀映射到 [0, blocks)，无需取模
+    return static_cast<std::size_t>(((h >> 32) * blocks) >> 32) * kBlockBytes;
+  }
+
+  static int probes(std::string_view data) {
+    return static_cast<unsigned char>(data.back());
+  }
+
+  std::string data_;
+};
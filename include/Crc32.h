@@ -0,0 +1,81 @@
+// include/Crc32.h - CRC32C (Castagnoli) 校验，用于快照与日志的数据块校验
+#pragma once
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__SSE4_2__)
+#include <nmmintrin.h>
+#endif
+
+namespace crc32c {
+
+namespace detail {
+
+// slicing-by-8 查表法：每次处理 8 字节
+inline const std::array<std::array<std::uint32_t, 256>, 8>& tables() {
+  static const auto kTables = [] {
+    std::array<std::array<std::uint32_t, 256>, 8> t{};
+    for (std::uint32_t i = 0; i < 256; ++i) {
+      std::uint32_t crc = i;
+      for (int j = 0; j < 8; ++j) {
+        crc = (crc >> 1) ^ (0x82F63B78u & (0u - (crc & 1u)));
+      }
+      t[0][i] = crc;
+    }
+    for (std::uint32_t i = 0; i < 256; ++i) {
+      for (int k = 1; k < 8; ++k) {
+        t[k][i] = (t[k - 1][i] >> 8) ^ t[0][t[k - 1][i] & 0xFF];
+      }
+    }
+    return t;
+  }();
+  return kTables;
+}
+
+}  // namespace detail
+
+// 在 crc 的基础上继续累加 data，初始值为 0
+inline std::uint32_t extend(std::uint32_t crc, const void* data,
+                            std::size_t n) {
+  const unsigned char* p = static_cast<const unsigned char*>(data);
+  crc = ~crc;
+#if defined(__SSE4_2__)
+  // 支持 SSE4.2 时使用硬件 CRC32 指令
+  while (n >= 8) {
+    std::uint64_t word;
+    std::memcpy(&word, p, 8);
+    crc = static_cast<std::uint32_t>(_mm_crc32_u64(crc, word));
+    p += 8;
+    n -= 8;
+  }
+  while (n > 0) {
+    crc = _mm_crc32_u8(crc, *p++);
+    --n;
+  }
+#else
+  const auto& t = detail::tables();
+  while (n >= 8) {
+    std::uint32_t lo = crc ^ (static_cast<std::uint32_t>(p[0]) |
+                              static_cast<std::uint32_t>(p[1]) << 8 |
+                              static_cast<std::uint32_t>(p[2]) << 16 |
+                              static_cast<std::uint32_t>(p[3]) << 24);
+    crc = t[7][lo & 0xFF] ^ t[6][(lo >> 8) & 0xFF] ^ t[5][(lo >> 16) & 0xFF] ^
+          t[4][lo >> 24] ^ t[3][p[4]] ^ t[2][p[5]] ^ t[1][p[6]] ^ t[0][p[7]];
+    p += 8;
+    n -= 8;
+  }
+  while (n > 0) {
+    crc = (crc >> 8) ^ t[0][(crc ^ *p++) & 0xFF];
+    --n;
+  }
+#endif
+  return ~crc;
+}
+
+inline std::uint32_t value(const void* data, std::size_t n) {
+  return extend(0, data, n);
+}
+
+}  // namespace crc32c
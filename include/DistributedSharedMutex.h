@@ -0,0 +1,164 @@
+// include/DistributedSharedMutex.h - 读者计数按线程分散的读写锁
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// 满足标准 SharedMutex 要求，可直接用于 std::shared_lock / std::unique_lock。
+//
+// std::shared_mutex 的读者计数位于同一条 cache line，每次加读锁都要对它做
+// 原子写，核数多时这条 cache line 在各核（乃至各 socket）之间来回迁移，
+// 读吞吐随线程数增加而停滞。这里把读者计数拆成若干独占 cache line 的槽，
+// 每个线程固定使用其中一个：
+// - 读者只对自己的槽做原子加减，另外读取一个只在写者进出时才改变的标志；
+// - 写者之间用 std::mutex 互斥，置位 writer_ 后等待所有槽归零。
+// 同一线程持有读锁时可以再次加读锁，不会与等待中的写者死锁。
+// 与 std::shared_mutex 一样，加锁与解锁必须在同一个线程中进行。
+// 代价是写者需要扫描全部槽，且每个实例占用 槽数 × kCacheLine 字节，
+// 适合读远多于写、实例数不多的场景
+class DistributedSharedMutex {
+ public:
+  static constexpr std::size_t kCacheLine = 64;
+  static constexpr std::size_t kMaxSlots = 64;
+
+  // slots 为 0 时按硬件线程数取整到 2 的幂（至多 kMaxSlots）
+  explicit DistributedSharedMutex(std::size_t slots = 0) {
+    if (slots == 0) {
+      slots = std::max<std::size_t>(1, std::thread::hardware_concurrency());
+    }
+    slots = std::bit_ceil(std::min(slots, kMaxSlots));
+    mask_ = slots - 1;
+    slots_ = std::make_unique<Slot[]>(slots);
+  }
+
+  DistributedSharedMutex(const DistributedSharedMutex&) = delete;
+  DistributedSharedMutex& operator=(const DistributedSharedMutex&) = delete;
+
+  // ---------- 独占锁 ----------
+  void lock() {
+    writer_mutex_.lock();
+    writer_.store(true, std::memory_order_seq_cst);
+    wait_readers();
+  }
+
+  bool try_lock() {
+    if (!writer_mutex_.try_lock()) return false;
+    writer_.store(true, std::memory_order_seq_cst);
+    for (std::size_t i = 0; i <= mask_; ++i) {
+      if (slots_[i].readers.load(std::memory_order_seq_cst) != 0) {
+        unlock();
+        return false;
+      }
+    }
+    return true;
+  }
+
+  void unlock() {
+    writer_.store(false, std::memory_order_seq_cst);
+    writer_.notify_all();
+    writer_mutex_.unlock();
+  }
+
+  // ---------- 共享锁 ----------
+  void lock_shared() {
+    Slot& slot = my_slot();
+    if (reenter()) {
+      // 本线程已持有读锁，写者一定还在等待它释放，直接进入
+      slot.readers.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    while (true) {
+      // 与写者构成 Dekker 式的同步：先公布自己，再检查写者
+      slot.readers.fetch_add(1, std::memory_order_seq_cst);
+      if (!writer_.load(std::memory_order_seq_cst)) break;
+      slot.readers.fetch_sub(1, std::memory_order_release);
+      writer_.wait(true, std::memory_order_acquire);
+    }
+    held().push_back({this, 1});
+  }
+
+  bool try_lock_shared() {
+    Slot& slot = my_slot();
+    if (reenter()) {
+      slot.readers.fetch_add(1, std::memory_order_relaxed);
+      return true;
+    }
+    slot.readers.fetch_add(1, std::memory_order_seq_cst);
+    if (writer_.load(std::memory_order_seq_cst)) {
+      slot.readers.fetch_sub(1, std::memory_order_release);
+      return false;
+    }
+    held().push_back({this, 1});
+    return true;
+  }
+
+  void unlock_shared() {
+    std::vector<Held>& list = held();
+    for (std::size_t i = 0; i < list.size(); ++i) {
+      if (list[i].mutex != this) continue;
+      if (--list[i].depth == 0) {
+        list[i] = list.back();
+        list.pop_back();
+      }
+      break;
+    }
+    my_slot().readers.fetch_sub(1, std::memory_order_release);
+  }
+
+ private:
+  struct alignas(kCacheLine) Slot {
+    std::atomic<std::int64_t> readers{0};
+  };
+
+  // 当前线程持有读锁的实例及重入次数；通常只有一两项，线性查找即可
+  struct Held {
+    const DistributedSharedMutex* mutex;
+    std::uint32_t depth;
+  };
+
+  static std::vector<Held>& held() {
+    static thread_local std::vector<Held> list;
+    return list;
+  }
+
+  // 线程第一次加锁时按顺序分配槽号，使线程均匀地分布到各个槽
+  static std::size_t thread_index() {
+    static std::atomic<std::size_t> next{0};
+    static thread_local std::size_t index =
+        next.fetch_add(1, std::memory_order_relaxed);
+    return index;
+  }
+
+  Slot& my_slot() { return slots_[thread_index() & mask_]; }
+
+  // 本线程已持有读锁时增加重入次数并返回 true
+  bool reenter() {
+    for (Held& h : held()) {
+      if (h.mutex == this) {
+        ++h.depth;
+        return true;
+      }
+    }
+    return false;
+  }
+
+  void wait_readers() {
+    for (std::size_t i = 0; i <= mask_; ++i) {
+      while (slots_[i].readers.load(std::memory_order_seq_cst) != 0) {
+        std::this_thread::yield();
+      }
+    }
+  }
+
+  std::unique_ptr<Slot[]> slots_;
+  std::size_t mask_ = 0;
+  // 写者进出时才修改，与上面只读的成员分开放在独立的 cache line
+  alignas(kCacheLine) std::atomic<bool> writer_{false};
+  std::mutex writer_mutex_;  // 写者之间互斥
+};
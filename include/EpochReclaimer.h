@@ -0,0 +1,165 @@
+// include/EpochReclaimer.h - 基于 epoch 的安全内存回收 (EBR)
+#pragma once
+#include <atomic>
+#include <cstdint>
+#include <vector>
+
+// 使用方式：
+//   auto guard = EpochReclaimer::instance().pin();  // 访问共享节点前进入临界区
+//   ... 读取 / 摘除节点 ...
+//   EpochReclaimer::instance().retire(node, deleter); // 摘除后延迟释放
+//
+// 原理：全局 epoch 单调递增，线程进入临界区时公布自己观察到的 epoch。
+// 只有当所有处于临界区的线程都已观察到当前 epoch 时，全局 epoch 才能前进。
+// 在 epoch r 被 retire 的对象，等全局 epoch 到达 r + 2 时，
+// 所有可能持有其引用的线程都已离开临界区，此时才真正释放。
+class EpochReclaimer {
+ public:
+  using Deleter = void (*)(void*);
+
+  // 进程级单例，所有无锁结构共享
+  static EpochReclaimer& instance() {
+    static EpochReclaimer reclaimer;
+    return reclaimer;
+  }
+
+  // RAII 临界区，可嵌套
+  class Guard {
+   public:
+    explicit Guard(EpochReclaimer* owner) : owner_(owner) { owner_->enter(); }
+    ~Guard() { owner_->exit(); }
+    Guard(const Guard&) = delete;
+    Guard& operator=(const Guard&) = delete;
+
+   private:
+    EpochReclaimer* owner_;
+  };
+
+  Guard pin() { return Guard(this); }
+
+  // 延迟释放 p：调用方必须保证 p 已无法被新的读者访问到
+  void retire(void* p, Deleter deleter) {
+    ThreadRecord* rec = local_record();
+    rec->retired.push_back({p, deleter, global_epoch_.load()});
+    if (rec->retired.size() >= kCollectThreshold) {
+      try_advance();
+      collect(rec);
+    }
+  }
+
+  EpochReclaimer(const EpochReclaimer&) = delete;
+  EpochReclaimer& operator=(const EpochReclaimer&) = delete;
+
+ private:
+  static constexpr std::uint64_t kIdle = UINT64_MAX;
+  static constexpr std::size_t kCollectThreshold = 128;
+
+  struct Retired {
+    void* ptr;
+    Deleter deleter;
+    std::uint64_t epoch;
+  };
+
+  // 每个线程一条记录，独占一个 cache line，避免读者之间互相干扰
+  struct alignas(64) ThreadRecord {
+    std::atomic<std::uint64_t> local_epoch{kIdle};
+    std::atomic<bool> in_use{false};
+    ThreadRecord* next = nullptr;  // 记录链表只增不删
+    // 以下字段只由持有该记录的线程访问
+    int nesting = 0;
+    std::vector<Retired> retired;  // 按 epoch 递增排列
+  };
+
+  // 线程退出时归还记录，未回收的对象留给下一个复用该记录的线程
+  struct LocalHandle {
+    EpochReclaimer* owner = nullptr;
+    ThreadRecord* rec = nullptr;
+    ~LocalHandle() {
+      if (rec != nullptr) {
+        owner->try_advance();
+        owner->collect(rec);
+        rec->in_use.store(false);
+      }
+    }
+  };
+
+  EpochReclaimer() = default;
+
+  ~EpochReclaimer() {
+    // 进程退出：所有线程都已结束，直接释放剩余对象
+    ThreadRecord* rec = records_.load();
+    while (rec != nullptr) {
+      for (const Retired& r : rec->retired) r.deleter(r.ptr);
+      ThreadRecord* next = rec->next;
+      delete rec;
+      rec = next;
+    }
+  }
+
+  ThreadRecord* local_record() {
+    static thread_local LocalHandle handle;
+    if (handle.rec == nullptr) {
+      handle.owner = this;
+      handle.rec = acquire_record();
+    }
+    return handle.rec;
+  }
+
+  ThreadRecord* acquire_record() {
+    // 优先复用已退出线程留下的记录
+    for (ThreadRecord* rec = records_.load(); rec != nullptr; rec = rec->next) {
+      bool expected = false;
+      if (!rec->in_use.load() &&
+          rec->in_use.compare_exchange_strong(expected, true)) {
+        return rec;
+      }
+    }
+    ThreadRecord* rec = new ThreadRecord();
+    rec->in_use.store(true);
+    ThreadRecord* head = records_.load();
+    do {
+      rec->next = head;
+    } while (!records_.compare_exchange_weak(head, rec));
+    return rec;
+  }
+
+  void enter() {
+    ThreadRecord* rec = local_record();
+    if (rec->nesting++ == 0) {
+      rec->local_epoch.store(global_epoch_.load());
+      // 公布 epoch 后才能读取共享指针
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+    }
+  }
+
+  void exit() {
+    ThreadRecord* rec = local_record();
+    if (--rec->nesting == 0) {
+      rec->local_epoch.store(kIdle, std::memory_order_release);
+    }
+  }
+
+  // 所有活跃线程都已观察到当前 epoch 时推进全局 epoch
+  void try_advance() {
+    std::uint64_t epoch = global_epoch_.load();
+    for (ThreadRecord* rec = records_.load(); rec != nullptr; rec = rec->next) {
+      std::uint64_t local = rec->local_epoch.load();
+      if (local != kIdle && local != epoch) return;
+    }
+    global_epoch_.compare_exchange_strong(epoch, epoch + 1);
+  }
+
+  // 释放 retire 时 epoch 落后全局 epoch 至少 2 的对象
+  void collect(ThreadRecord* rec) {
+    std::uint64_t epoch = global_epoch_.load();
+    std::size_t n = 0;
+    while (n < rec->retired.size() && rec->retired[n].epoch + 2 <= epoch) {
+      rec->retired[n].deleter(rec->retired[n].ptr);
+      ++n;
+    }
+    rec->retired.erase(rec->retired.begin(), rec->retired.begin() + n);
+  }
+
+  std::atomic<std::uint64_t> global_epoch_{0};
+  std::atomic<ThreadRecord*> records_{nullptr};
+};
@@ -0,0 +1,110 @@
+// include/ExpiryIndex.h - KVStore 分片中带过期时间的 key 的索引
+#pragma once
+#include <algorithm>
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <utility>
+#include <vector>
+
+#include "SkipList.h"
+
+// 每个 key 的过期时间保存两份：
+// - deadlines_ 按 key 排序，get 时 O(log m) 判断是否过期（m 为带过期时间的
+//   key 数），没有任何 key 设置过期时间时只需一次无锁的 size() 读取；
+// - timeline_ 按 (过期时间, key) 排序，过期的 key 总在最前面，
+//   清理的代价只与过期的 key 数有关，与数据总量无关。
+// 过期时间为 system_clock 的毫秒时间戳，重启后仍然有效。
+// 两个跳表各自加锁，可与读者并发；修改需由调用方串行化（KVStore 的分片写锁）
+template <typename K>
+class ExpiryIndex {
+ public:
+  using Entry = std::pair<std::int64_t, K>;
+
+  // 当前时间的毫秒时间戳
+  static std::int64_t now() {
+    return std::chrono::duration_cast<std::chrono::milliseconds>(
+               std::chrono::system_clock::now().time_since_epoch())
+        .count();
+  }
+
+  // 从现在起 ttl 之后的时间戳；ttl 不为正时立即过期
+  static std::int64_t deadline_after(std::chrono::milliseconds ttl) {
+    return now() + std::max<std::int64_t>(ttl.count(), 0);
+  }
+
+  bool empty() const { return deadlines_.size() == 0; }
+  std::size_t size() const { return deadlines_.size(); }
+
+  // 取得 key 的过期时间，未设置时返回 false；Q 为 K 或可透明比较的类型
+  template <typename Q>
+  bool deadline(const Q& key, std::int64_t& expire_at) {
+    if (empty()) return false;
+    return deadlines_.search_element(key, expire_at);
+  }
+
+  // key 设置了过期时间且不晚于 now
+  template <typename Q>
+  bool expired(const Q& key, std::int64_t now) {
+    std::int64_t expire_at;
+    return deadline(key, expire_at) && expire_at <= now;
+  }
+
+  // 设置或更新 key 的过期时间
+  void set(const K& key, std::int64_t expire_at) {
+    std::int64_t old;
+    if (deadlines_.search_element(key, old)) {
+      if (old == expire_at) return;
+      timeline_.delete_element(Entry(old, key));
+    }
+    deadlines_.insert_element(key, expire_at);
+    timeline_.insert_element(Entry(expire_at, key), 0);
+  }
+
+  // 清除 key 的过期时间，key 未设置时返回 false
+  bool erase(const K& key) {
+    std::int64_t old;
+    if (!deadline(key, old)) return false;
+    deadlines_.delete_element(key);
+    timeline_.delete_element(Entry(old, key));
+    return true;
+  }
+
+  // 按过期时间先后取出至多 limit 个不晚于 now 过期的 key，追加到 out，
+  // 并从索引中移除；返回取出的个数
+  std::size_t pop_expired(std::int64_t now, std::size_t limit,
+                          std::vector<K>& out) {
+    std::vector<Entry> entries;
+    for (auto it = timeline_.begin(); it.valid() && entries.size() < limit;
+         ++it) {
+      if (it.key().first > now) break;
+      entries.push_back(it.key());
+    }
+    // 迭代器持有读锁，销毁后才能删除
+    timeline_.delete_batch(entries.begin(), entries.end());
+    for (Entry& entry : entries) {
+      deadlines_.delete_element(entry.second);
+      out.push_back(std::move(entry.second));
+    }
+    return entries.size();
+  }
+
+  // 按 key 升序调用 func(key, expire_at)，遍历期间持有索引的读锁
+  template <typename Func>
+  void for_each(Func func) {
+    for (auto it = deadlines_.begin(); it.valid(); ++it) {
+      func(it.key(), it.value());
+    }
+  }
+
+  void clear() {
+    deadlines_.clear();
+    timeline_.clear();
+  }
+
+ private:
+  SkipList<K, std::int64_t, HeapNodeAllocator, MAX_LEVEL, std::less<>>
+      deadlines_;
+  SkipList<Entry, char, HeapNodeAllocator, MAX_LEVEL, std::less<>> timeline_;
+};
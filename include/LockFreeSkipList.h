@@ -0,0 +1,340 @@
+// include/LockFreeSkipList.h - 无锁并发跳表
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <vector>
+
+#include "EpochReclaimer.h"
+#include "SkipList.h"
+
+// 无锁跳表节点：forward 指针塔同样内联在节点之后，
+// 但每一层都是 std::atomic<uintptr_t>，最低位作为逻辑删除标记 (mark)。
+// value_ 通过指针原子替换，更新已存在的 key 时旧值交给 EpochReclaimer 回收。
+template <typename K, typename V>
+class LockFreeNode {
+ public:
+  using Link = std::atomic<std::uintptr_t>;
+
+  const K key_;
+  std::atomic<V*> value_;
+  const int node_level_;
+  // 插入线程与删除线程各持有一份引用，最后离开的一方负责 retire，
+  // 保证节点在插入线程仍在链接高层时不会被提前回收
+  std::atomic<int> pending_;
+
+  static LockFreeNode* create(const K& k, V* v, int level) {
+    void* mem = ::operator new(alloc_size(level));
+    LockFreeNode* node = new (mem) LockFreeNode(k, v, level);
+    for (int i = 0; i <= level; ++i) {
+      new (&node->tower()[i]) Link(0);
+    }
+    return node;
+  }
+
+  static void destroy(LockFreeNode* node) {
+    delete node->value_.load(std::memory_order_relaxed);
+    node->~LockFreeNode();
+    ::operator delete(static_cast<void*>(node));
+  }
+
+  // 供 EpochReclaimer 使用的类型擦除版本
+  static void destroy_erased(void* p) {
+    destroy(static_cast<LockFreeNode*>(p));
+  }
+  static void destroy_value(void* p) { delete static_cast<V*>(p); }
+
+  Link& link(int i) { return tower()[i]; }
+
+  // 指针与删除标记的打包 / 解包
+  static LockFreeNode* ptr(std::uintptr_t word) {
+    return reinterpret_cast<LockFreeNode*>(word & ~std::uintptr_t(1));
+  }
+  static bool marked(std::uintptr_t word) { return (word & 1) != 0; }
+  static std::uintptr_t pack(LockFreeNode* node, bool mark) {
+    return reinterpret_cast<std::uintptr_t>(node) | (mark ? 1 : 0);
+  }
+
+  LockFreeNode(const LockFreeNode&) = delete;
+  LockFreeNode& operator=(const LockFreeNode&) = delete;
+
+ private:
+  LockFreeNode(const K& k, V* v, int level)
+      : key_(k), value_(v), node_level_(level), pending_(2) {}
+  ~LockFreeNode() = default;
+
+  static constexpr std::size_t kTowerOffset =
+      (sizeof(LockFreeNode) + alignof(Link) - 1) & ~(alignof(Link) - 1);
+
+  static constexpr std::size_t alloc_size(int level) {
+    return kTowerOffset + sizeof(Link) * static_cast<std::size_t>(level + 1);
+  }
+
+  Link* tower() {
+    return reinterpret_cast<Link*>(reinterpret_cast<char*>(this) +
+                                   kTowerOffset);
+  }
+};
+
+// 与 SkipList 接口一致的无锁跳表 (Fraser / Herlihy-Shavit 算法)：
+// - 删除先自顶向下标记各层 forward 指针，第 0 层标记成功即为删除的线性化点，
+//   随后由 find() 沿途 CAS 摘除被标记的节点；
+// - 插入先 CAS 链接第 0 层，再逐层链接高层；
+// - 所有操作在 EpochReclaimer 临界区内执行，读者不会访问已释放的节点。
+template <typename K, typename V>
+class LockFreeSkipList {
+ private:
+  using NodeType = LockFreeNode<K, V>;
+
+  NodeType* header_;                   // 头节点
+  // 出现过的最高层，find 的下降起点；插入在链接新节点之前先抬高它，
+  // 以上的各层没有节点
+  std::atomic<int> current_level_{0};
+  std::atomic<int> element_count_{0};  // 元素个数
+
+  int get_random_level() {
+    return skiplist_detail::LevelGenerator<P_FACTOR>::next(
+        MAX_LEVEL, element_count_.load(std::memory_order_relaxed));
+  }
+
+  bool find(const K& key, NodeType** preds, NodeType** succs);
+  void retire(NodeType* node) {
+    EpochReclaimer::instance().retire(node, &NodeType::destroy_erased);
+  }
+
+ public:
+  LockFreeSkipList() {
+    K k{};
+    header_ = NodeType::create(k, nullptr, MAX_LEVEL);
+  }
+
+  LockFreeSkipList(const LockFreeSkipList&) = delete;
+  LockFreeSkipList& operator=(const LockFreeSkipList&) = delete;
+
+  // 析构时要求已没有其他线程访问该跳表
+  ~LockFreeSkipList() {
+    NodeType* node = NodeType::ptr(header_->link(0).load());
+    while (node != nullptr) {
+      NodeType* next = NodeType::ptr(node->link(0).load());
+      NodeType::destroy(node);
+      node = next;
+    }
+    NodeType::destroy(header_);
+  }
+
+  bool insert_element(const K& key, const V& value);  // 插入或更新
+  bool search_element(const K& key, V& value);        // 查找
+  bool delete_element(const K& key);                  // 删除
+  // 遍历所有未被删除的元素，不提供快照语义
+  template <typename Func>
+  void process_all(Func func);
+  // 逐个删除所有元素，可与其他操作并发
+  void clear();
+
+  int size() const { return element_count_.load(std::memory_order_relaxed); }
+};
+
+// 从 current_level_ 自顶向下定位 key 在每一层的前驱 preds 与后继 succs，
+// 沿途遇到被标记的节点就尝试物理摘除；CAS 失败说明前驱已变化，从头重试。
+// 更高的层填为头节点与空后继：调用方用到的层不超过它看到的 current_level_
+// （插入者自己抬高过，删除者经由节点的链接看到了插入者的抬高）
+template <typename K, typename V>
+bool LockFreeSkipList<K, V>::find(const K& key, NodeType** preds,
+                                  NodeType** succs) {
+retry:
+  NodeType* pred = header_;
+  NodeType* current = nullptr;
+  const int top = current_level_.load(std::memory_order_acquire);
+  for (int i = MAX_LEVEL; i > top; --i) {
+    preds[i] = header_;
+    succs[i] = nullptr;
+  }
+  for (int i = top; i >= 0; --i) {
+    current = NodeType::ptr(pred->link(i).load());
+    while (current != nullptr) {
+      std::uintptr_t succ = current->link(i).load();
+      while (NodeType::marked(succ)) {
+        // current 已被逻辑删除，将其从 pred 之后摘除
+        std::uintptr_t expected = NodeType::pack(current, false);
+        if (!pred->link(i).compare_exchange_strong(
+                expected, NodeType::pack(NodeType::ptr(succ), false))) {
+          goto retry;
+        }
+        current = NodeType::ptr(succ);
+        if (current == nullptr) break;
+        succ = current->link(i).load();
+      }
+      if (current == nullptr || !(current->key_ < key)) break;
+      pred = current;
+      current = NodeType::ptr(succ);
+    }
+    preds[i] = pred;
+    succs[i] = current;
+  }
+  return current != nullptr && current->key_ == key;
+}
+
+template <typename K, typename V>
+bool LockFreeSkipList<K, V>::search_element(const K& key, V& value) {
+  auto guard = EpochReclaimer::instance().pin();
+  NodeType* pred = header_;
+  NodeType* current = nullptr;
+
+  // 只读路径不做摘除，直接跳过被标记的节点
+  for (int i = current_level_.load(std::memory_order_relaxed); i >= 0; --i) {
+    current = NodeType::ptr(pred->link(i).load(std::memory_order_acquire));
+    while (current != nullptr) {
+      std::uintptr_t succ = current->link(i).load(std::memory_order_acquire);
+      while (NodeType::marked(succ)) {
+        current = NodeType::ptr(succ);
+        if (current == nullptr) break;
+        succ = current->link(i).load(std::memory_order_acquire);
+      }
+      if (current == nullptr || !(current->key_ < key)) break;
+      pred = current;
+      current = NodeType::ptr(succ);
+    }
+  }
+
+  if (current != nullptr && current->key_ == key) {
+    value = *current->value_.load(std::memory_order_acquire);
+    return true;
+  }
+  return false;
+}
+
+template <typename K, typename V>
+bool LockFreeSkipList<K, V>::insert_element(const K& key, const V& value) {
+  NodeType* preds[MAX_LEVEL + 1];
+  NodeType* succs[MAX_LEVEL + 1];
+  V* new_value = new V(value);
+  int random_level = get_random_level();
+  NodeType* new_node = nullptr;
+
+  auto guard = EpochReclaimer::instance().pin();
+
+  // find 只从 current_level_ 开始下降，链接之前先把它抬高到新节点的层数，
+  // 否则并发的删除可能漏掉已链接的高层，摘除不完整就回收节点
+  {
+    int level = current_level_.load(std::memory_order_relaxed);
+    while (level < random_level &&
+           !current_level_.compare_exchange_weak(level, random_level)) {
+    }
+  }
+
+  // 1. 第 0 层链接成功即为插入的线性化点
+  while (true) {
+    if (find(key, preds, succs)) {
+      // key 已存在：原子替换值，旧值延迟回收
+      V* old = succs[0]->value_.exchange(new_value);
+      EpochReclaimer::instance().retire(old, &NodeType::destroy_value);
+      if (new_node != nullptr) {
+        // 从未被发布的节点可以直接释放（不能连带释放 new_value）
+        new_node->value_.store(nullptr, std::memory_order_relaxed);
+        NodeType::destroy(new_node);
+      }
+      return true;
+    }
+    if (new_node == nullptr) {
+      new_node = NodeType::create(key, new_value, random_level);
+    }
+    for (int i = 0; i <= random_level; ++i) {
+      new_node->link(i).store(NodeType::pack(succs[i], false),
+                              std::memory_order_relaxed);
+    }
+    std::uintptr_t expected = NodeType::pack(succs[0], false);
+    if (preds[0]->link(0).compare_exchange_strong(
+            expected, NodeType::pack(new_node, false))) {
+      break;
+    }
+  }
+  element_count_.fetch_add(1, std::memory_order_relaxed);
+
+  // 2. 逐层链接高层；若节点已被并发删除则停止
+  for (int i = 1; i <= random_level; ++i) {
+    bool linked = false;
+    while (!linked) {
+      std::uintptr_t next = new_node->link(i).load();
+      if (NodeType::marked(next)) goto done;
+      if (NodeType::ptr(next) != succs[i] &&
+          !new_node->link(i).compare_exchange_strong(
+              next, NodeType::pack(succs[i], false))) {
+        continue;  // 期间被标记或被修改，重新检查
+      }
+      std::uintptr_t expected = NodeType::pack(succs[i], false);
+      if (preds[i]->link(i).compare_exchange_strong(
+              expected, NodeType::pack(new_node, false))) {
+        linked = true;
+      } else {
+        // 前驱已变化，重新定位；若节点已不在表中则停止
+        find(key, preds, succs);
+        if (succs[0] != new_node) goto done;
+      }
+    }
+  }
+
+done:
+  // 删除线程可能在高层链接完成前就已经结束摘除，这里再补一次
+  if (NodeType::marked(new_node->link(0).load())) {
+    find(key, preds, succs);
+  }
+  if (new_node->pending_.fetch_sub(1) == 1) retire(new_node);
+  return true;
+}
+
+template <typename K, typename V>
+bool LockFreeSkipList<K, V>::delete_element(const K& key) {
+  NodeType* preds[MAX_LEVEL + 1];
+  NodeType* succs[MAX_LEVEL + 1];
+
+  auto guard = EpochReclaimer::instance().pin();
+  if (!find(key, preds, succs)) {
+    return false;
+  }
+  NodeType* victim = succs[0];
+
+  // 1. 自顶向下标记第 1 层及以上的 forward 指针
+  for (int i = victim->node_level_; i >= 1; --i) {
+    std::uintptr_t next = victim->link(i).load();
+    while (!NodeType::marked(next) &&
+           !victim->link(i).compare_exchange_weak(next, next | 1)) {
+    }
+  }
+
+  // 2. 标记第 0 层：成功者完成删除，失败说明已被其他线程删除
+  std::uintptr_t next = victim->link(0).load();
+  while (true) {
+    if (NodeType::marked(next)) return false;
+    if (victim->link(0).compare_exchange_strong(next, next | 1)) break;
+  }
+
+  // 3. 物理摘除并延迟回收
+  find(key, preds, succs);
+  element_count_.fetch_sub(1, std::memory_order_relaxed);
+  if (victim->pending_.fetch_sub(1) == 1) retire(victim);
+  return true;
+}
+
+template <typename K, typename V>
+template <typename Func>
+void LockFreeSkipList<K, V>::process_all(Func func) {
+  auto guard = EpochReclaimer::instance().pin();
+  NodeType* node = NodeType::ptr(header_->link(0).load());
+  while (node != nullptr) {
+    std::uintptr_t next = node->link(0).load();
+    if (!NodeType::marked(next)) {
+      func(node->key_, *node->value_.load(std::memory_order_acquire));
+    }
+    node = NodeType::ptr(next);
+  }
+}
+
+template <typename K, typename V>
+void LockFreeSkipList<K, V>::clear() {
+  std::vector<K> keys;
+  process_all([&](const K& key, const V&) { keys.push_back(key); });
+  for (const K& key : keys) {
+    delete_element(key);
+  }
+}
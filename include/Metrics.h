@@ -0,0 +1,380 @@
+// include/Metrics.h - 可在编译时开启的分阶段延迟直方图与生命周期事件
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <bit>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <functional>
+#include <iterator>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+// 定义 SKIPLIST_METRICS（CMake 选项 -DSKIPLIST_METRICS=ON）后，热路径上的
+// SKIPLIST_METRICS_* 宏按（操作, 阶段）记录耗时，并在快照、落盘、合并与加载
+// 的开始 / 结束时通知 Registry::set_trace_sink 设置的回调。
+// 未定义时这些宏展开为空语句，参数不求值，不读取时钟也不访问共享状态；
+// 导出接口仍然可用，只是没有数据。
+//
+// 直方图为 HDR 风格的对数-线性分桶（单位 ns）：每个 2 的幂区间均分为 16 桶，
+// 相对误差不超过 1/16，超过 2^40 ns（约 18 分钟）的值计入最后一桶。
+// 记录按线程编号分散到 kSlots 组直方图中，只做 relaxed 的原子加法；
+// 导出时把各组相加，读到的是近似一致的视图
+namespace metrics {
+
+// 被记录的（操作, 阶段），名称见 kPointNames
+enum class Point : std::uint8_t {
+  kInsertLock,       // SkipList::insert_element 等待写锁
+  kInsertTraverse,   // 查找插入位置
+  kInsertAllocate,   // 生成层数并分配、构造节点
+  kInsertLink,       // 链接各层指针
+  kInsertBatch,      // SkipList::insert_batch 一批（含等待写锁）
+  kSearchTotal,      // search_element / read_element 加锁与查找
+  kDeleteTotal,      // SkipList::delete_element 整体（含等待写锁）
+  kDeleteBatch,      // SkipList::delete_batch 一批（含等待写锁）
+  kLoadRead,         // 读取快照的一个 block（含校验、解压）
+  kLoadDecode,       // 解码一个 block 中的记录
+  kLoadInsert,       // 一批记录追加进分片
+  kLoadReplay,       // 回放预写日志
+  kLoadTotal,        // KVStore::load 整体
+  kDumpFreeze,       // dump 在全部写锁下切换日志、冻结分片（分层存储同样）
+  kDumpWrite,        // 写出快照或有序表（编码与 I/O）
+  kDumpMerge,        // 合并冻结期间的增量
+  kDumpTotal,        // KVStore::dump 整体
+  kFileIoWait,       // aio::FileWriter 等待上一块写完（快照与有序表）
+  kWalWrite,         // 预写日志写出一批记录
+  kWalSync,          // 预写日志 fdatasync
+  kCompactionTotal,  // 分层存储合并一组有序表
+  kCount,
+};
+
+struct PointName {
+  const char* op;
+  const char* phase;
+};
+
+inline constexpr PointName kPointNames[] = {
+    {"insert", "lock"},       {"insert", "traverse"},
+    {"insert", "allocate"},   {"insert", "link"},
+    {"insert", "batch"},      {"search", "total"},
+    {"delete", "total"},      {"delete", "batch"},
+    {"load", "read"},         {"load", "decode"},
+    {"load", "insert"},       {"load", "replay"},
+    {"load", "total"},        {"dump", "freeze"},
+    {"dump", "write"},        {"dump", "merge"},
+    {"dump", "total"},        {"file_write", "io_wait"},
+    {"wal", "write"},         {"wal", "sync"},
+    {"compaction", "total"},
+};
+static_assert(std::size(kPointNames) ==
+              static_cast<std::size_t>(Point::kCount));
+
+inline constexpr bool kEnabled =
+#if defined(SKIPLIST_METRICS)
+    true;
+#else
+    false;
+#endif
+
+// 某个 Point 在导出时刻的直方图
+struct HistogramData {
+  static constexpr int kSubBits = 4;
+  static constexpr std::uint64_t kSub = 1ULL << kSubBits;
+  static constexpr int kMaxExp = 40;
+  static constexpr std::size_t kBuckets = (kMaxExp - kSubBits + 1) * kSub;
+
+  std::vector<std::uint64_t> counts = std::vector<std::uint64_t>(kBuckets);
+  std::uint64_t count = 0;
+  std::uint64_t sum = 0;  // ns
+  std::uint64_t max = 0;  // ns
+
+  static std::size_t index(std::uint64_t v) {
+    if (v < kSub) return static_cast<std::size_t>(v);
+    int exp = std::bit_width(v) - 1;
+    if (exp >= kMaxExp) return kBuckets - 1;
+    std::uint64_t sub = (v >> (exp - kSubBits)) & (kSub - 1);
+    return static_cast<std::size_t>((exp - kSubBits + 1) * kSub + sub);
+  }
+
+  // 第 i 桶包含的最大值
+  static std::uint64_t upper_bound(std::size_t i) {
+    if (i < kSub) return i;
+    int exp = static_cast<int>(i / kSub) + kSubBits - 1;
+    std::uint64_t lower = (kSub + i % kSub) << (exp - kSubBits);
+    return lower + (1ULL << (exp - kSubBits)) - 1;
+  }
+
+  double mean() const {
+    return count == 0 ? 0.0 : static_cast<double>(sum) / count;
+  }
+
+  // 第 q 分位（0 < q <= 1）所在桶的上界，不超过记录到的最大值
+  std::uint64_t percentile(double q) const {
+    if (count == 0) return 0;
+    auto target = static_cast<std::uint64_t>(
+        std::ceil(q * static_cast<double>(count)));
+    target = std::clamp<std::uint64_t>(target, 1, count);
+    std::uint64_t seen = 0;
+    for (std::size_t i = 0; i < kBuckets; ++i) {
+      seen += counts[i];
+      if (seen >= target) return std::min(upper_bound(i), max);
+    }
+    return max;
+  }
+};
+
+// 快照、落盘、合并与加载各自的开始与结束
+enum class Span : std::uint8_t { kSnapshot, kFlush, kCompaction, kLoad };
+
+inline constexpr const char* kSpanNames[] = {"snapshot", "flush",
+                                             "compaction", "load"};
+
+struct TraceEvent {
+  Span span;
+  bool begin;             // 开始时为 true，以下字段只在结束时有意义
+  std::string_view path;  // 相关的文件
+  bool ok = true;
+  // 结束时的记录数（合并时为输入的表数，落盘时为 0）
+  std::uint64_t records = 0;
+  std::chrono::nanoseconds duration{0};
+};
+
+class Registry {
+ public:
+  static constexpr std::size_t kSlots = 8;
+  static constexpr std::size_t kPoints =
+      static_cast<std::size_t>(Point::kCount);
+
+  // 进程共享的实例，第一次使用时创建
+  static Registry& shared() {
+    static Registry registry;
+    return registry;
+  }
+
+  void record(Point point, std::uint64_t ns) {
+    Cell& cell = slot().cells[static_cast<std::size_t>(point)];
+    cell.counts[HistogramData::index(ns)].fetch_add(1,
+                                                    std::memory_order_relaxed);
+    cell.count.fetch_add(1, std::memory_order_relaxed);
+    cell.sum.fetch_add(ns, std::memory_order_relaxed);
+    std::uint64_t max = cell.max.load(std::memory_order_relaxed);
+    while (ns > max && !cell.max.compare_exchange_weak(
+                           max, ns, std::memory_order_relaxed)) {
+    }
+  }
+
+  HistogramData collect(Point point) const {
+    HistogramData data;
+    for (const auto& slot : slots_) {
+      const Slot* s = slot.load(std::memory_order_acquire);
+      if (s == nullptr) continue;
+      const Cell& cell = s->cells[static_cast<std::size_t>(point)];
+      for (std::size_t i = 0; i < HistogramData::kBuckets; ++i) {
+        data.counts[i] += cell.counts[i].load(std::memory_order_relaxed);
+      }
+      data.count += cell.count.load(std::memory_order_relaxed);
+      data.sum += cell.sum.load(std::memory_order_relaxed);
+      data.max = std::max(data.max, cell.max.load(std::memory_order_relaxed));
+    }
+    return data;
+  }
+
+  // 对每个有记录的 Point 调用 func(const PointName&, const HistogramData&)
+  template <typename Func>
+  void for_each(Func&& func) const {
+    for (std::size_t p = 0; p < kPoints; ++p) {
+      HistogramData data = collect(static_cast<Point>(p));
+      if (data.count > 0) func(kPointNames[p], data);
+    }
+  }
+
+  // 清零全部直方图；与并发的 record 之间不是原子的
+  void reset() {
+    for (auto& slot : slots_) {
+      Slot* s = slot.load(std::memory_order_acquire);
+      if (s == nullptr) continue;
+      for (Cell& cell : s->cells) {
+        for (auto& c : cell.counts) c.store(0, std::memory_order_relaxed);
+        cell.count.store(0, std::memory_order_relaxed);
+        cell.sum.store(0, std::memory_order_relaxed);
+        cell.max.store(0, std::memory_order_relaxed);
+      }
+    }
+  }
+
+  // Prometheus 文本格式：一个 histogram 类型的指标，以 op / phase 为标签，
+  // le 取 2 的幂纳秒（64ns 到约 69s）换算成的秒数；只输出有记录的阶段
+  std::string prometheus_text() const {
+    std::string out;
+    if (!kEnabled) {
+      out.append("# skiplist was built without SKIPLIST_METRICS\n");
+      return out;
+    }
+    out.append(
+        "# HELP skiplist_latency_seconds Time spent per operation and "
+        "phase.\n# TYPE skiplist_latency_seconds histogram\n");
+    char buf[64];
+    for_each([&](const PointName& name, const HistogramData& data) {
+      std::string labels = "op=\"";
+      labels.append(name.op);
+      labels.append("\",phase=\"");
+      labels.append(name.phase);
+      labels.append("\"");
+      std::uint64_t seen = 0;
+      std::size_t i = 0;
+      for (int exp = 6; exp <= 36; ++exp) {
+        // 上界小于 2^exp 的桶即不超过 2^exp - 1 ns 的记录
+        const std::uint64_t bound = 1ULL << exp;
+        for (; i < HistogramData::kBuckets &&
+               HistogramData::upper_bound(i) < bound;
+             ++i) {
+          seen += data.counts[i];
+        }
+        std::snprintf(buf, sizeof(buf), "%.9g",
+                      static_cast<double>(bound) * 1e-9);
+        append_sample(out, "_bucket", labels, buf, seen);
+      }
+      append_sample(out, "_bucket", labels, "+Inf", data.count);
+      std::snprintf(buf, sizeof(buf), "%.9g",
+                    static_cast<double>(data.sum) * 1e-9);
+      out.append("skiplist_latency_seconds_sum{").append(labels);
+      out.append("} ").append(buf).append("\n");
+      out.append("skiplist_latency_seconds_count{").append(labels);
+      out.append("} ").append(std::to_string(data.count)).append("\n");
+    });
+    return out;
+  }
+
+  // 生命周期事件的回调，在事件发生的线程中调用，应当很短；
+  // 传入空函数时关闭。回调中不能再调用 set_trace_sink
+  void set_trace_sink(std::function<void(const TraceEvent&)> sink) {
+    std::lock_guard<std::mutex> guard(sink_mutex_);
+    sink_ = std::move(sink);
+    has_sink_.store(static_cast<bool>(sink_), std::memory_order_release);
+  }
+
+  bool tracing() const { return has_sink_.load(std::memory_order_acquire); }
+
+  void trace(const TraceEvent& event) {
+    if (!tracing()) return;
+    std::lock_guard<std::mutex> guard(sink_mutex_);
+    if (sink_) sink_(event);
+  }
+
+ private:
+  struct Cell {
+    std::atomic<std::uint64_t> counts[HistogramData::kBuckets] = {};
+    std::atomic<std::uint64_t> count{0};
+    std::atomic<std::uint64_t> sum{0};
+    std::atomic<std::uint64_t> max{0};
+  };
+
+  struct alignas(64) Slot {
+    Cell cells[kPoints];
+  };
+
+  Registry() = default;
+
+  // 每组直方图约 95KB，第一次有线程用到时才分配
+  Slot& slot() {
+    static std::atomic<std::size_t> next{0};
+    static thread_local std::size_t index =
+        next.fetch_add(1, std::memory_order_relaxed) % kSlots;
+    Slot* s = slots_[index].load(std::memory_order_acquire);
+    if (s != nullptr) return *s;
+    std::lock_guard<std::mutex> guard(slot_mutex_);
+    if (owned_[index] == nullptr) {
+      owned_[index] = std::make_unique<Slot>();
+      slots_[index].store(owned_[index].get(), std::memory_order_release);
+    }
+    return *owned_[index];
+  }
+
+  static void append_sample(std::string& out, std::string_view suffix,
+                            const std::string& labels, const char* le,
+                            std::uint64_t value) {
+    out.append("skiplist_latency_seconds").append(suffix).append("{");
+    out.append(labels).append(",le=\"").append(le).append("\"} ");
+    out.append(std::to_string(value)).append("\n");
+  }
+
+  // 创建后不再释放，slots_ 可以无锁读取
+  std::unique_ptr<Slot> owned_[kSlots];
+  std::atomic<Slot*> slots_[kSlots] = {};
+  std::mutex slot_mutex_;  // 保护 owned_
+  std::mutex sink_mutex_;
+  std::function<void(const TraceEvent&)> sink_;
+  std::atomic<bool> has_sink_{false};
+};
+
+// 分阶段计时：每次 lap 记录距上一次 lap（或构造）的耗时，只读一次时钟
+class PhaseTimer {
+ public:
+  PhaseTimer() : last_(std::chrono::steady_clock::now()) {}
+
+  void lap(Point point) {
+    auto now = std::chrono::steady_clock::now();
+    Registry::shared().record(
+        point, static_cast<std::uint64_t>(
+                   std::chrono::duration_cast<std::chrono::nanoseconds>(
+                       now - last_)
+                       .count()));
+    last_ = now;
+  }
+
+ private:
+  std::chrono::steady_clock::time_point last_;
+};
+
+// 构造时发出开始事件，finish 时发出带耗时的结束事件；
+// 没有调用 finish 就析构（提前返回）视为失败
+class TraceScope {
+ public:
+  TraceScope(Span span, std::string_view path)
+      : span_(span), path_(path), start_(std::chrono::steady_clock::now()) {
+    Registry::shared().trace({span_, true, path_});
+  }
+  ~TraceScope() { finish(false); }
+
+  TraceScope(const TraceScope&) = delete;
+  TraceScope& operator=(const TraceScope&) = delete;
+
+  void finish(bool ok, std::uint64_t records = 0) {
+    if (finished_) return;
+    finished_ = true;
+    Registry::shared().trace(
+        {span_, false, path_, ok, records,
+         std::chrono::duration_cast<std::chrono::nanoseconds>(
+             std::chrono::steady_clock::now() - start_)});
+  }
+
+ private:
+  Span span_;
+  std::string path_;
+  std::chrono::steady_clock::time_point start_;
+  bool finished_ = false;
+};
+
+}  // namespace metrics
+
+#if defined(SKIPLIST_METRICS)
+// 在当前作用域开始计时 / 记录到 metrics::Point::point 的阶段耗时
+#define SKIPLIST_METRICS_TIMER(name) ::metrics::PhaseTimer name
+#define SKIPLIST_METRICS_LAP(name, point) name.lap(::metrics::Point::point)
+// 生命周期事件，span 为 metrics::Span 的枚举名
+#define SKIPLIST_METRICS_SPAN(name, span, path) \
+  ::metrics::TraceScope name(::metrics::Span::span, path)
+#define SKIPLIST_METRICS_SPAN_END(name, ok, records) name.finish(ok, records)
+#else
+#define SKIPLIST_METRICS_TIMER(name) static_cast<void>(0)
+#define SKIPLIST_METRICS_LAP(name, point) static_cast<void>(0)
+#define SKIPLIST_METRICS_SPAN(name, span, path) static_cast<void>(0)
+#define SKIPLIST_METRICS_SPAN_END(name, ok, records) static_cast<void>(0)
+#endif
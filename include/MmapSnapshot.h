@@ -0,0 +1,495 @@
+// include/MmapSnapshot.h - 通过内存映射直接查询二进制快照
+#pragma once
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "Crc32.h"
+#include "Serializer.h"
+#include "Snapshot.h"
+
+// 只读地映射一个 Snapshot.h 格式的快照文件，不把记录物化为 Node：
+// - 只支持整体有序 (kFlagSorted) 的快照；
+// - 打开时只校验文件头、文件尾与块索引，耗时与数据量无关；
+// - 查找时先按各 block 的首个 key 二分定位 block，再按 restart 点二分，
+//   最后顺序扫描至多 kRestartInterval 条记录；
+// - 每个 block 在第一次被访问时校验 CRC，之后不再重复校验；
+// - 压缩的 block 在第一次被访问时解压，解压结果保留到关闭为止；
+// - std::string 值可以通过 get_view 零拷贝地指向映射内存（或解压结果）；
+// - Cursor 从任意位置按 key 升序顺序解码，用于多路归并。
+// 打开后的所有查询接口都是只读的，可被多个线程并发调用。
+template <typename K, typename V>
+class MmapSnapshot {
+ private:
+  const char* data_ = nullptr;
+  std::size_t size_ = 0;
+  std::uint32_t flags_ = 0;
+  snapshot::Footer footer_{};
+  const char* index_ = nullptr;  // block 偏移数组
+  std::string_view filter_;      // 校验通过的过滤器，没有时为空
+  // 0: 未校验，1: 校验通过，2: 已损坏
+  std::unique_ptr<std::atomic<std::uint8_t>[]> verified_;
+  // 压缩的 block 解压后的负载，第一个完成解压的线程安装
+  std::unique_ptr<std::atomic<const std::string*>[]> decoded_;
+
+  bool compressed() const {
+    return (flags_ & snapshot::kFlagCompressed) != 0;
+  }
+
+  // 解压第 i 个 block 并安装到 decoded_[i]；数据损坏时返回 false
+  bool decode_block(std::size_t i, const char* payload,
+                    std::size_t size) const {
+    if (payload[0] == snapshot::kCodecNone) return true;  // 直接使用映射内存
+    auto raw = std::make_unique<std::string>();
+    if (!snapshot::decompress_block(payload, size, *raw)) return false;
+    const std::string* expected = nullptr;
+    if (decoded_[i].compare_exchange_strong(expected, raw.get(),
+                                            std::memory_order_acq_rel)) {
+      raw.release();
+    }
+    return true;
+  }
+
+  std::uint64_t block_offset(std::size_t i) const {
+    return serial::decode_fixed<std::uint64_t>(index_ + i * 8);
+  }
+
+  // 取得第 i 个 block 的记录区 [begin, end) 与 restart 数组；损坏返回 false
+  bool block_range(std::size_t i, const char*& begin, const char*& end,
+                   const char*& restarts, std::uint32_t& restart_count) const {
+    std::uint64_t off = block_offset(i);
+    if (off + snapshot::kBlockHeaderSize > footer_.index_offset) return false;
+    const char* header = data_ + off;
+    std::uint32_t size = serial::decode_fixed<std::uint32_t>(header);
+    if (off + snapshot::kBlockHeaderSize + size > footer_.index_offset) {
+      return false;
+    }
+    const char* payload = header + snapshot::kBlockHeaderSize;
+
+    std::uint8_t state = verified_[i].load(std::memory_order_acquire);
+    if (state == 0) {
+      std::uint32_t crc = serial::decode_fixed<std::uint32_t>(header + 8);
+      bool ok = size > 0 || !compressed();
+      ok = ok && crc32c::value(payload, size) == crc &&
+           (!compressed() || decode_block(i, payload, size));
+      state = ok ? 1 : 2;
+      verified_[i].store(state, std::memory_order_release);
+    }
+    if (state != 1) return false;
+    if (compressed()) {
+      if (const std::string* raw =
+              decoded_[i].load(std::memory_order_acquire)) {
+        payload = raw->data();
+        size = static_cast<std::uint32_t>(raw->size());
+      } else {
+        ++payload;  // kCodecNone
+        --size;
+      }
+    }
+
+    std::size_t records;
+    if (!snapshot::records_size(payload, size, flags_, records)) return false;
+    begin = payload;
+    end = payload + records;
+    restarts = end;
+    restart_count = (flags_ & snapshot::kFlagRestartPoints)
+                        ? serial::decode_fixed<std::uint32_t>(payload + size - 4)
+                        : 0;
+    return true;
+  }
+
+  static bool skip_value(const char*& p, const char* end) {
+    if constexpr (requires { Serializer<V>::skip(p, end); }) {
+      return Serializer<V>::skip(p, end);
+    } else {
+      V tmp{};
+      return Serializer<V>::read(p, end, tmp);
+    }
+  }
+
+  // 解码 p 处的 key 并与 key 比较：-1 小于，0 等于，1 大于；解码失败返回 false。
+  // key 可以是任何能与 K 比较的类型（如 std::string_view）。
+  // 前缀压缩时 last 为上一条记录的 key，解码后更新为本条记录的 key；
+  // 比较 restart 点上的记录时 last 可以为空指针
+  template <typename Q>
+  bool compare_key(const char*& p, const char* end, const Q& key, int& cmp,
+                   std::string* last) const {
+    if constexpr (std::is_same_v<K, std::string>) {
+      // 字符串 key 直接在映射内存上比较，不分配内存
+      std::string_view view;
+      if (!snapshot::read_key_view(p, end, flags_, last, view)) return false;
+      cmp = view < key ? -1 : (key < view ? 1 : 0);
+    } else {
+      (void)last;
+      K decoded{};
+      if (!Serializer<K>::read(p, end, decoded)) return false;
+      cmp = decoded < key ? -1 : (key < decoded ? 1 : 0);
+    }
+    return true;
+  }
+
+  // 定位第一条 key >= key 的记录：block 为其所在 block，p 指向记录起点，
+  // end 为该 block 记录区的末尾，cmp 为该记录的 key 与 key 的比较结果；
+  // 前缀压缩时 last 为该记录的 key，从 p 重新解码时作为上一条记录的 key。
+  // 不存在这样的记录或数据损坏时返回 false
+  template <typename Q>
+  bool seek(const Q& key, std::size_t& block, const char*& p,
+            const char*& end, int& cmp, std::string& last) const {
+    if (footer_.block_count == 0) return false;
+
+    // 1. 找到最后一个首 key <= key 的 block
+    std::size_t lo = 0, hi = footer_.block_count;
+    while (hi - lo > 1) {
+      std::size_t mid = lo + (hi - lo) / 2;
+      const char *first, *last, *restarts;
+      std::uint32_t n;
+      if (!block_range(mid, first, last, restarts, n)) return false;
+      if (!compare_key(first, last, key, cmp, nullptr)) return false;
+      if (cmp <= 0) {
+        lo = mid;
+      } else {
+        hi = mid;
+      }
+    }
+
+    const char *begin, *restarts;
+    std::uint32_t restart_count;
+    if (!block_range(lo, begin, end, restarts, restart_count)) return false;
+
+    // 2. 在 restart 点上二分，找到最后一个首 key <= key 的区间
+    p = begin;
+    if (restart_count > 0) {
+      std::uint32_t rlo = 0, rhi = restart_count;
+      while (rhi - rlo > 1) {
+        std::uint32_t mid = rlo + (rhi - rlo) / 2;
+        std::uint32_t off =
+            serial::decode_fixed<std::uint32_t>(restarts + mid * 4);
+        if (off >= static_cast<std::size_t>(end - begin)) return false;
+        const char* q = begin + off;
+        if (!compare_key(q, end, key, cmp, nullptr)) return false;
+        if (cmp <= 0) {
+          rlo = mid;
+        } else {
+          rhi = mid;
+        }
+      }
+      std::uint32_t off =
+          serial::decode_fixed<std::uint32_t>(restarts + rlo * 4);
+      if (off >= static_cast<std::size_t>(end - begin)) return false;
+      p = begin + off;
+    }
+
+    // 3. 顺序扫描，本 block 内都小于 key 时从下一个 block 的开头继续
+    for (std::size_t b = lo; b < footer_.block_count; ++b) {
+      if (b != lo) {
+        if (!block_range(b, begin, end, restarts, restart_count)) return false;
+        p = begin;
+      }
+      while (p < end) {
+        const char* record = p;
+        if (!compare_key(p, end, key, cmp, &last)) return false;
+        if (cmp >= 0) {
+          block = b;
+          p = record;
+          return true;
+        }
+        if (!skip_value(p, end)) return false;
+      }
+    }
+    return false;
+  }
+
+  // 在快照中定位 key，成功时 value_pos 指向对应的值
+  template <typename Q>
+  bool locate(const Q& key, const char*& value_pos,
+              const char*& value_end) const {
+    std::size_t block;
+    const char *p, *end;
+    int cmp;
+    std::string last;
+    if (!seek(key, block, p, end, cmp, last) || cmp != 0) return false;
+    if (!compare_key(p, end, key, cmp, &last)) return false;  // 跳过 key
+    value_pos = p;
+    value_end = end;
+    return true;
+  }
+
+ public:
+  MmapSnapshot() = default;
+  ~MmapSnapshot() { close(); }
+
+  MmapSnapshot(const MmapSnapshot&) = delete;
+  MmapSnapshot& operator=(const MmapSnapshot&) = delete;
+
+  // 映射文件并校验文件头 / 文件尾 / 块索引，不读取任何记录
+  bool open(const std::string& path) {
+#if defined(_WIN32)
+    (void)path;
+    return false;  // 暂不支持 Windows
+#else
+    close();
+    int fd = ::open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (::fstat(fd, &st) != 0 ||
+        static_cast<std::uint64_t>(st.st_size) <
+            snapshot::kHeaderSize + snapshot::kFooterSize) {
+      ::close(fd);
+      return false;
+    }
+    void* addr = ::mmap(nullptr, static_cast<std::size_t>(st.st_size),
+                        PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);  // 映射建立后即可关闭文件描述符
+    if (addr == MAP_FAILED) return false;
+    data_ = static_cast<const char*>(addr);
+    size_ = static_cast<std::size_t>(st.st_size);
+    // 点查询是随机访问，关闭内核预读
+    ::madvise(addr, size_, MADV_RANDOM);
+
+    if (std::memcmp(data_, snapshot::kHeaderMagic, 8) != 0 ||
+        !snapshot::supported_version(
+            serial::decode_fixed<std::uint32_t>(data_ + 8)) ||
+        !snapshot::decode_footer(data_ + size_ - snapshot::kFooterSize, size_,
+                                 footer_)) {
+      close();
+      return false;
+    }
+    flags_ = serial::decode_fixed<std::uint32_t>(data_ + 12);
+    if ((flags_ & snapshot::kFlagSorted) == 0 ||
+        ((flags_ & snapshot::kFlagPrefixKeys) != 0 &&
+         !std::is_same_v<K, std::string>)) {
+      close();  // 无序的快照无法二分查找
+      return false;
+    }
+    index_ = data_ + footer_.index_offset;
+    if (crc32c::value(index_, footer_.block_count * 8) != footer_.index_crc) {
+      close();
+      return false;
+    }
+    verified_ = std::make_unique<std::atomic<std::uint8_t>[]>(
+        static_cast<std::size_t>(footer_.block_count));
+    for (std::uint64_t i = 0; i < footer_.block_count; ++i) {
+      verified_[i].store(0, std::memory_order_relaxed);
+    }
+    if (compressed()) {
+      decoded_ = std::make_unique<std::atomic<const std::string*>[]>(
+          static_cast<std::size_t>(footer_.block_count));
+      for (std::uint64_t i = 0; i < footer_.block_count; ++i) {
+        decoded_[i].store(nullptr, std::memory_order_relaxed);
+      }
+    }
+    if ((flags_ & snapshot::kFlagFilter) != 0 &&
+        footer_.index_offset >= snapshot::kHeaderSize + 8) {
+      // 过滤器损坏时当作没有过滤器，查询照常进行
+      const char* trailer = index_ - 8;
+      std::uint32_t size = serial::decode_fixed<std::uint32_t>(trailer);
+      std::uint32_t crc = serial::decode_fixed<std::uint32_t>(trailer + 4);
+      if (size <= footer_.index_offset - 8 - snapshot::kHeaderSize &&
+          crc32c::value(trailer - size, size) == crc) {
+        filter_ = std::string_view(trailer - size, size);
+      }
+    }
+    return true;
+#endif
+  }
+
+  void close() {
+#if !defined(_WIN32)
+    if (data_ != nullptr) {
+      ::munmap(const_cast<char*>(data_), size_);
+    }
+#endif
+    data_ = nullptr;
+    size_ = 0;
+    index_ = nullptr;
+    filter_ = std::string_view();
+    if (decoded_ != nullptr) {
+      for (std::uint64_t i = 0; i < footer_.block_count; ++i) {
+        delete decoded_[i].load(std::memory_order_relaxed);
+      }
+      decoded_.reset();
+    }
+    verified_.reset();
+  }
+
+  bool is_open() const { return data_ != nullptr; }
+  std::uint64_t record_count() const { return footer_.record_count; }
+  std::size_t file_size() const { return size_; }
+  // 写入时附加的过滤器（见 SnapshotWriter::set_filter），没有时为空
+  std::string_view filter() const { return filter_; }
+
+  // 按 key 升序的只读游标，解码出的 key / value 在 next() 之前有效。
+  // 遇到损坏的 block 时提前结束，failed() 返回 true
+  class Cursor {
+   public:
+    Cursor() = default;
+
+    bool valid() const { return valid_; }
+    bool failed() const { return failed_; }
+    const K& key() const { return key_; }
+    const V& value() const { return value_; }
+
+    void next() {
+      while (true) {
+        if (p_ == end_) {
+          const char* restarts;
+          std::uint32_t n;
+          valid_ = false;
+          if (++block_ >= snapshot_->footer_.block_count) return;
+          if (!snapshot_->block_range(block_, p_, end_, restarts, n)) {
+            failed_ = true;
+            return;
+          }
+          continue;
+        }
+        valid_ = snapshot::read_key(p_, end_, snapshot_->flags_, key_) &&
+                 Serializer<V>::read(p_, end_, value_);
+        failed_ = !valid_;
+        return;
+      }
+    }
+
+   private:
+    friend class MmapSnapshot;
+
+    const MmapSnapshot* snapshot_ = nullptr;
+    std::size_t block_ = 0;
+    const char* p_ = nullptr;
+    const char* end_ = nullptr;
+    K key_{};
+    V value_{};
+    bool valid_ = false;
+    bool failed_ = false;
+  };
+
+  // 指向第一条记录的游标
+  Cursor begin() const {
+    Cursor cursor;
+    cursor.snapshot_ = this;
+    const char* restarts;
+    std::uint32_t n;
+    if (footer_.block_count == 0) return cursor;
+    if (!block_range(0, cursor.p_, cursor.end_, restarts, n)) {
+      cursor.failed_ = true;
+      return cursor;
+    }
+    cursor.next();
+    return cursor;
+  }
+
+  // 指向第一条 key >= key 的记录的游标
+  Cursor seek(const K& key) const {
+    Cursor cursor;
+    cursor.snapshot_ = this;
+    int cmp;
+    std::string last;
+    if (seek(key, cursor.block_, cursor.p_, cursor.end_, cmp, last)) {
+      if constexpr (std::is_same_v<K, std::string>) cursor.key_.swap(last);
+      cursor.next();
+    }
+    return cursor;
+  }
+
+  // 查找 key 并解码出值；key 可以是任何能与 K 比较的类型
+  template <typename Q>
+  bool get(const Q& key, V& value) const {
+    const char *p, *end;
+    if (!locate(key, p, end)) return false;
+    return Serializer<V>::read(p, end, value);
+  }
+
+  // 零拷贝查找：value 指向映射内存，在 MmapSnapshot 关闭前有效
+  template <typename Q, typename T = V,
+            typename = std::enable_if_t<std::is_same_v<T, std::string>>>
+  bool get_view(const Q& key, std::string_view& value) const {
+    const char *p, *end;
+    if (!locate(key, p, end)) return false;
+    return Serializer<std::string>::read_view(p, end, value);
+  }
+
+  // 按文件顺序遍历全部记录 func(K&, V&)；遇到损坏的 block 停止并返回 false
+  template <typename Func>
+  bool for_each(Func&& func) const {
+    K key{};
+    V value{};
+    // 前缀压缩时解码依赖上一条记录的 key，func 可能移走 key，另存一份
+    const bool prefix = (flags_ & snapshot::kFlagPrefixKeys) != 0;
+    K last{};
+    for (std::size_t i = 0; i < footer_.block_count; ++i) {
+      const char *p, *end, *restarts;
+      std::uint32_t n;
+      if (!block_range(i, p, end, restarts, n)) return false;
+      while (p < end) {
+        if (prefix) {
+          if (!snapshot::read_key(p, end, flags_, last)) return false;
+          key = last;
+        } else if (!Serializer<K>::read(p, end, key)) {
+          return false;
+        }
+        if (!Serializer<V>::read(p, end, value)) return false;
+        func(key, value);
+      }
+    }
+    return true;
+  }
+
+  // 依次访问 [begin_key, end_key) 内的记录 func(K&, V&)，至多 limit 条
+  // （为 0 时不限制），func 返回 false 时提前结束；返回访问的条数
+  template <typename Func>
+  std::size_t scan(const K& begin_key, const K& end_key, std::size_t limit,
+                   Func&& func) const {
+    std::size_t block;
+    const char *p, *end;
+    int cmp;
+    std::size_t count = 0;
+    std::string last;
+    if (!seek(begin_key, block, p, end, cmp, last)) return 0;
+    // 同 for_each，func 可能修改 key，前缀压缩时在 prev 上解码
+    const bool prefix = (flags_ & snapshot::kFlagPrefixKeys) != 0;
+    K key{};
+    K prev{};
+    V value{};
+    if constexpr (std::is_same_v<K, std::string>) prev.swap(last);
+    while (true) {
+      if (p == end) {
+        if (++block >= footer_.block_count) break;
+        const char* restarts;
+        std::uint32_t n;
+        if (!block_range(block, p, end, restarts, n)) break;
+        continue;
+      }
+      if (prefix) {
+        if (!snapshot::read_key(p, end, flags_, prev)) break;
+        key = prev;
+      } else if (!Serializer<K>::read(p, end, key)) {
+        break;
+      }
+      if (!(key < end_key)) break;
+      if (!Serializer<V>::read(p, end, value)) break;
+      ++count;
+      if (!func(key, value) || count == limit) break;
+    }
+    return count;
+  }
+
+  // 建议内核按顺序预读（用于后台整体加载）
+  void advise_sequential() const {
+#if !defined(_WIN32)
+    if (data_ != nullptr) {
+      ::madvise(const_cast<char*>(data_), size_, MADV_SEQUENTIAL);
+    }
+#endif
+  }
+};
@@ -1,23 +1,141 @@
 // include/Node.h
 #pragma once
-#include <vector>
+#include <atomic>
+#include <cstddef>
+#include <limits>
+#include <new>
+#include <type_traits>
+#include <utility>
 
-template <typename K, typename V>
+#include "NodeAllocator.h"
+
+// Node 的 key、value、level 与 forward 指针塔位于同一块变长内存中：
+// [ Node 对象 | forward[0] | forward[1] | ... | forward[level] ]
+// 相比 std::vector 存储 forward，每次插入只需一次堆分配，
+// 查找时每一跳只访问一块连续内存，而不是节点 + vector 缓冲区两处。
+// 指针塔的起始偏移向上取整到指针对齐
+// 内存由分配策略提供（见 NodeAllocator.h），只保证默认的 new 对齐。
+//
+// CacheKeys 为 true 时（仅用于整数 key），指针塔的每一项同时存放后继的 key：
+// [ Node 对象 | {forward[0], next_key[0]} | ... | {forward[level], ...} ]
+// 查找时比较 next_key 即可决定前进还是下降，只有真正前进到的节点才会被访问；
+// next_key 与指针在同一条 cache line 上，不额外增加访存。
+// next_key 由 set_forward 维护，后继为空时存放 K 的最大值
+template <typename K, typename V, bool CacheKeys = false>
 class Node {
+  static_assert(alignof(K) <= __STDCPP_DEFAULT_NEW_ALIGNMENT__ &&
+                    alignof(V) <= __STDCPP_DEFAULT_NEW_ALIGNMENT__,
+                "over-aligned key/value types are not supported");
+  static_assert(!CacheKeys || std::numeric_limits<K>::is_integer,
+                "CacheKeys requires an integer key type");
+
+  struct KeyedLink {
+    Node* next;
+    K key;
+  };
+  // 指针塔的一项
+  using Slot = std::conditional_t<CacheKeys, KeyedLink, Node*>;
+
  public:
   K key_;
   V value_;
   int node_level_;  // 该节点的层级
+  // CLOCK 淘汰的访问位：读者在读锁内置位，淘汰扫描在写锁内清除。
+  // 位于 node_level_ 之后的填充字节中，不增加节点大小
+  mutable std::atomic<bool> referenced_{false};
+
+  // 从分配器 alloc 中创建层级为 level 的节点，forward 指针塔全部置空；
+  // 右值的 k / v 被移动进节点
+  template <typename Alloc, typename KArg, typename VArg>
+  static Node* create(Alloc& alloc, KArg&& k, VArg&& v, int level) {
+    return create_in_place(alloc, level, std::forward<KArg>(k),
+                           std::forward<VArg>(v));
+  }
+
+  // 同 create，value 由 args 原地构造
+  template <typename Alloc, typename KArg, typename... Args>
+  static Node* create_in_place(Alloc& alloc, int level, KArg&& k,
+                               Args&&... args) {
+    void* mem = alloc.allocate(alloc_size(level), level);
+    Node* node;
+    try {
+      node = new (mem)
+          Node(level, std::forward<KArg>(k), std::forward<Args>(args)...);
+    } catch (...) {
+      alloc.deallocate(mem, alloc_size(level), level);
+      throw;
+    }
+    for (int i = 0; i <= level; ++i) {
+      node->set_forward(i, nullptr);
+    }
+    return node;
+  }
+
+  // 销毁节点并将整块内存（对象 + 指针塔）归还给分配器
+  template <typename Alloc>
+  static void destroy(Alloc& alloc, Node* node) {
+    int level = node->node_level_;
+    node->~Node();
+    alloc.deallocate(static_cast<void*>(node), alloc_size(level), level);
+  }
+
+  // 只调用析构函数，不归还内存（由分配器整块释放）
+  static void destruct(Node* node) { node->~Node(); }
 
-  // forward[i] 表示该节点在第 i 层的下一个节点
-  // 使用 std::vector 替代原生的 Node** 数组，更安全；
-  // 追求性能可以使用 unique_ptr
-  std::vector<Node<K, V>*> forward_;
+  // 层级为 level 的节点实际占用的字节数
+  static constexpr std::size_t alloc_size(int level) {
+    return kTowerOffset + sizeof(Slot) * static_cast<std::size_t>(level + 1);
+  }
+
+  // forward(i) 表示该节点在第 i 层的下一个节点
+  Node* forward(int i) const {
+    if constexpr (CacheKeys) {
+      return tower()[i].next;
+    } else {
+      return tower()[i];
+    }
+  }
+  void set_forward(int i, Node* next) {
+    if constexpr (CacheKeys) {
+      tower()[i].next = next;
+      tower()[i].key = next ? next->key_ : std::numeric_limits<K>::max();
+    } else {
+      tower()[i] = next;
+    }
+  }
+
+  // 第 i 层指针所在的地址，只做地址计算、不访问内存，用于预取
+  const void* forward_address(int i) const { return tower() + i; }
 
-  Node(K k, V v, int level) : key_(k), value_(v), node_level_(level) {
-    // 初始化 forward 数组，大小为 level + 1，全部置空
-    this->forward_.resize(level + 1, nullptr);
+  // forward(i) 的 key，forward(i) 为空时为 K 的最大值
+  K next_key(int i) const
+    requires CacheKeys
+  {
+    return tower()[i].key;
   }
 
-  ~Node() {}  // vector 会自动释放内存，无需手动 delete []
-};
\ No newline at end of file
+  // 禁止拷贝：节点只能通过 create/destroy 管理
+  Node(const Node&) = delete;
+  Node& operator=(const Node&) = delete;
+
+ private:
+  template <typename KArg, typename... Args>
+  Node(int level, KArg&& k, Args&&... args)
+      : key_(std::forward<KArg>(k)),
+        value_(std::forward<Args>(args)...),
+        node_level_(level) {}
+  ~Node() = default;
+
+  static constexpr std::size_t kTowerOffset =
+      (sizeof(Node) + alignof(Slot) - 1) & ~(alignof(Slot) - 1);
+
+  // 指针塔紧跟在 Node 对象之后
+  Slot* tower() {
+    return reinterpret_cast<Slot*>(reinterpret_cast<char*>(this) +
+                                   kTowerOffset);
+  }
+  const Slot* tower() const {
+    return reinterpret_cast<const Slot*>(reinterpret_cast<const char*>(this) +
+                                         kTowerOffset);
+  }
+};
@@ -0,0 +1,123 @@
+// include/NodeAllocator.h - SkipList 节点内存分配策略
+#pragma once
+#include <cstddef>
+#include <new>
+#include <vector>
+
+// 分配策略需要提供：
+//   void* allocate(std::size_t bytes, int level);
+//   void deallocate(void* p, std::size_t bytes, int level);
+//   void release_all();                    // 一次性归还全部节点内存
+//   static constexpr bool kBulkRelease;    // release_all 是否真正释放节点内存
+// 所有调用都发生在 SkipList 的写锁之内，因此策略本身无需线程安全。
+
+// 默认策略：每个节点单独 operator new / operator delete
+struct HeapNodeAllocator {
+  static constexpr bool kBulkRelease = false;
+
+  void* allocate(std::size_t bytes, int /*level*/) {
+    return ::operator new(bytes);
+  }
+  void deallocate(void* p, std::size_t /*bytes*/, int /*level*/) {
+    ::operator delete(p);
+  }
+  void release_all() {}
+};
+
+// Arena 策略：按塔高分桶，从大块内存 (chunk) 中切分节点；
+// 删除的节点挂到对应层级的空闲链表上复用；
+// release_all() 按 chunk 数量 O(chunks) 归还全部内存，无需逐个 free
+class ArenaNodeAllocator {
+ public:
+  static constexpr bool kBulkRelease = true;
+
+  ArenaNodeAllocator() = default;
+  ~ArenaNodeAllocator() { release_all(); }
+
+  // 持有原始内存块，禁止拷贝
+  ArenaNodeAllocator(const ArenaNodeAllocator&) = delete;
+  ArenaNodeAllocator& operator=(const ArenaNodeAllocator&) = delete;
+
+  void* allocate(std::size_t bytes, int level) {
+    Bucket& bucket = bucket_for(level);
+    // 优先复用同层级已删除的节点
+    if (bucket.free_list != nullptr) {
+      FreeSlot* slot = bucket.free_list;
+      bucket.free_list = slot->next;
+      return slot;
+    }
+    bytes = round_up(bytes);
+    if (static_cast<std::size_t>(bucket.end - bucket.cursor) < bytes) {
+      refill(bucket, bytes);
+    }
+    void* p = bucket.cursor;
+    bucket.cursor += bytes;
+    return p;
+  }
+
+  void deallocate(void* p, std::size_t /*bytes*/, int level) {
+    Bucket& bucket = bucket_for(level);
+    FreeSlot* slot = static_cast<FreeSlot*>(p);
+    slot->next = bucket.free_list;
+    bucket.free_list = slot;
+  }
+
+  void release_all() {
+    for (char* chunk : chunks_) {
+      if (chunk != nullptr) ::operator delete(static_cast<void*>(chunk));
+    }
+    chunks_.clear();
+    buckets_.clear();
+    bytes_reserved_ = 0;
+  }
+
+  // 当前从系统申请的总字节数
+  std::size_t bytes_reserved() const { return bytes_reserved_; }
+
+ private:
+  struct FreeSlot {
+    FreeSlot* next;
+  };
+
+  struct Bucket {
+    char* cursor = nullptr;  // 当前 chunk 中下一个可用位置
+    char* end = nullptr;     // 当前 chunk 的末尾
+    FreeSlot* free_list = nullptr;
+    std::size_t next_chunk_bytes = kMinChunkBytes;
+  };
+
+  // 高层节点很少，chunk 从小块开始按倍数增长，避免高层桶浪费内存
+  static constexpr std::size_t kMinChunkBytes = 4 * 1024;
+  static constexpr std::size_t kMaxChunkBytes = 1024 * 1024;
+  static constexpr std::size_t kAlign = alignof(std::max_align_t);
+
+  static std::size_t round_up(std::size_t bytes) {
+    if (bytes < sizeof(FreeSlot)) bytes = sizeof(FreeSlot);
+    return (bytes + kAlign - 1) & ~(kAlign - 1);
+  }
+
+  Bucket& bucket_for(int level) {
+    if (static_cast<std::size_t>(level) >= buckets_.size()) {
+      buckets_.resize(level + 1);
+    }
+    return buckets_[level];
+  }
+
+  void refill(Bucket& bucket, std::size_t bytes) {
+    std::size_t chunk_bytes = bucket.next_chunk_bytes;
+    while (chunk_bytes < bytes) chunk_bytes *= 2;
+    if (bucket.next_chunk_bytes < kMaxChunkBytes) {
+      bucket.next_chunk_bytes *= 2;
+    }
+    chunks_.push_back(nullptr);  // 先占位，避免 push_back 失败时泄漏 chunk
+    char* chunk = static_cast<char*>(::operator new(chunk_bytes));
+    chunks_.back() = chunk;
+    bytes_reserved_ += chunk_bytes;
+    bucket.cursor = chunk;
+    bucket.end = chunk + chunk_bytes;
+  }
+
+  std::vector<char*> chunks_;
+  std::vector<Bucket> buckets_;
+  std::size_t bytes_reserved_ = 0;
+};
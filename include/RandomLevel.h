@@ -0,0 +1,71 @@
+// include/RandomLevel.h - 跳表节点层高的快速生成
+#pragma once
+#include <algorithm>
+#include <bit>
+#include <cmath>
+#include <cstdint>
+#include <random>
+
+namespace skiplist_detail {
+
+// splitmix64：每次只需一次加法、两次乘法与三次移位异或，
+// 状态为 thread_local，多线程插入互不干扰也无需加锁
+inline std::uint64_t level_random() {
+  static thread_local std::uint64_t state = [] {
+    std::random_device rd;
+    return (static_cast<std::uint64_t>(rd()) << 32) ^ rd();
+  }();
+  std::uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+  z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+  z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+  return z ^ (z >> 31);
+}
+
+// p 恰为 1/2^k 时返回 k，否则返回 0
+constexpr int level_shift(double p) {
+  for (int k = 1; k < 64; ++k) {
+    if (p == 1.0 / static_cast<double>(1ULL << k)) return k;
+  }
+  return 0;
+}
+
+// 生成满足 P(level >= l) = PFactor^l 的层高。
+// - PFactor = 1/2^k 时只取一次 64 位随机数：末尾连续 0 的个数 ≥ k·l 的概率
+//   恰为 2^(-k·l)，层高即 countr_zero / k；
+// - 其他 PFactor 逐层把随机数与 PFactor · 2^64 做整数比较。
+// 层高还受元素个数限制：n 个元素时超过 log_{1/P}(n) + 1 的层几乎必然只有
+// 一个节点，只会让查找多走几步空层
+template <double PFactor>
+class LevelGenerator {
+ public:
+  static int next(int max_level, std::uint64_t element_count) {
+    int cap = std::min(max_level, count_cap(element_count));
+    if constexpr (kShift > 0) {
+      int level = std::countr_zero(level_random()) / kShift;
+      return std::min(level, cap);
+    } else {
+      int level = 0;
+      while (level < cap && level_random() < kThreshold) ++level;
+      return level;
+    }
+  }
+
+ private:
+  static constexpr int kShift = level_shift(PFactor);
+  static constexpr std::uint64_t kThreshold =
+      static_cast<std::uint64_t>(PFactor * 18446744073709551616.0);
+
+  // std::bit_width(n) = floor(log2 n) + 1
+  static int count_cap(std::uint64_t n) {
+    int bits = std::bit_width(n);
+    if constexpr (kShift > 0) {
+      return bits / kShift + 1;
+    } else {
+      static const double levels_per_bit =
+          std::log(2.0) / std::log(1.0 / PFactor);
+      return static_cast<int>(bits * levels_per_bit) + 1;
+    }
+  }
+};
+
+}  // namespace skiplist_detail
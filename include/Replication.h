@@ -0,0 +1,549 @@
+// include/Replication.h - 主从复制：主节点向副本持续推送预写日志
+#pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <list>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+
+#if !defined(_WIN32)
+#include <netdb.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <sys/socket.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#include <cerrno>
+#endif
+
+#include "KVStore.h"
+#include "Serializer.h"
+
+// 副本连接主节点的复制端口后发送握手（多字节整数均为小端）：
+//   "SKVREPL1" | 复制标识 u64 | 已应用的编号 u64（第一次连接时均为 0）
+// 之后主节点只发送消息：type u8 | 内容长度 u64 | 内容
+//   kFullSync  : 复制标识 u64 | 编号 u64 | 快照长度 u64 | 快照 |
+//                过期时间文件长度 u64 | 过期时间文件
+//   kContinue  : 复制标识 u64 | 编号 u64（从断开处继续）
+//   kRecords   : 最后一条的编号 u64 | wal::encode 编码的若干条记录
+//   kHeartbeat : 主节点已写出的编号 u64（空闲时每秒一次）
+// 握手中的标识与主节点日志的标识相同、且断开之后的记录仍在复制积压
+// （KVStoreOptions::replication_backlog）中时增量同步，否则主节点执行一次
+// dump()（KVStore::checkpoint）并发送快照，副本以 KVStore::restore 载入。
+// 主节点只推送已按 wal_mode 写出的记录，副本不会领先于主节点的日志；
+// 副本在一个线程中收取并应用，每条 kRecords（至多约 kMaxBatchBytes）
+// 经 KVStore::apply_log 合并为批量写入。副本重启后总是全量同步。
+namespace repl {
+
+enum MessageType : std::uint8_t {
+  kFullSync = 1,
+  kContinue = 2,
+  kRecords = 3,
+  kHeartbeat = 4,
+};
+
+constexpr char kMagic[8] = {'S', 'K', 'V', 'R', 'E', 'P', 'L', '1'};
+constexpr std::size_t kHandshakeSize = 24;
+constexpr std::size_t kMessageHeaderSize = 9;
+// 一条 kRecords 最多携带的字节数（至少一个写出批次）
+constexpr std::size_t kMaxBatchBytes = 4 << 20;
+// 主节点没有新记录时检查停止标志与发送心跳的间隔
+constexpr std::chrono::milliseconds kPollInterval{200};
+constexpr std::chrono::milliseconds kHeartbeatInterval{1000};
+// 副本超过该时间没有收到消息时认为连接已断开，重新连接
+constexpr std::chrono::milliseconds kTimeout{5000};
+constexpr std::chrono::milliseconds kRetryInterval{1000};
+
+namespace detail {
+
+#if !defined(_WIN32)
+inline bool send_all(int fd, const char* p, std::size_t n) {
+  while (n > 0) {
+    ssize_t sent = ::send(fd, p, n, MSG_NOSIGNAL);
+    if (sent < 0 && errno == EINTR) continue;
+    if (sent <= 0) return false;
+    p += sent;
+    n -= static_cast<std::size_t>(sent);
+  }
+  return true;
+}
+
+inline bool recv_all(int fd, char* p, std::size_t n) {
+  while (n > 0) {
+    ssize_t got = ::recv(fd, p, n, 0);
+    if (got < 0 && errno == EINTR) continue;
+    if (got <= 0) return false;
+    p += got;
+    n -= static_cast<std::size_t>(got);
+  }
+  return true;
+}
+
+// 接收超时，为 0 时一直等待
+inline void set_timeout(int fd, std::chrono::milliseconds timeout) {
+  timeval tv{};
+  tv.tv_sec = static_cast<time_t>(timeout.count() / 1000);
+  tv.tv_usec = static_cast<suseconds_t>(timeout.count() % 1000 * 1000);
+  ::setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &tv, sizeof(tv));
+}
+
+inline void configure(int fd) {
+  int one = 1;
+  ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+  ::setsockopt(fd, SOL_SOCKET, SO_KEEPALIVE, &one, sizeof(one));
+}
+
+// passive 为 true 时在 host:port 上监听，否则连接 host:port；失败时返回 -1
+inline int open_socket(const std::string& host, int port, bool passive) {
+  addrinfo hints{};
+  hints.ai_family = AF_UNSPEC;
+  hints.ai_socktype = SOCK_STREAM;
+  hints.ai_flags = passive ? AI_PASSIVE : 0;
+  addrinfo* result = nullptr;
+  const std::string service = std::to_string(port);
+  if (::getaddrinfo(host.empty() ? nullptr : host.c_str(), service.c_str(),
+                    &hints, &result) != 0) {
+    std::cerr << "Cannot resolve " << host << std::endl;
+    return -1;
+  }
+  int fd = -1;
+  for (addrinfo* ai = result; ai != nullptr && fd < 0; ai = ai->ai_next) {
+    fd = ::socket(ai->ai_family, ai->ai_socktype | SOCK_CLOEXEC,
+                  ai->ai_protocol);
+    if (fd < 0) continue;
+    int one = 1;
+    bool ok = passive
+                  ? ::setsockopt(fd, SOL_SOCKET, SO_REUSEADDR, &one,
+                                 sizeof(one)) == 0 &&
+                        ::bind(fd, ai->ai_addr, ai->ai_addrlen) == 0 &&
+                        ::listen(fd, 16) == 0
+                  : ::connect(fd, ai->ai_addr, ai->ai_addrlen) == 0;
+    if (!ok) {
+      ::close(fd);
+      fd = -1;
+    }
+  }
+  ::freeaddrinfo(result);
+  if (fd >= 0 && !passive) configure(fd);
+  return fd;
+}
+
+inline void close_socket(int fd) {
+  if (fd >= 0) ::close(fd);
+}
+
+// 使阻塞在 fd 上的 accept / recv / send 返回
+inline void shutdown_socket(int fd) {
+  if (fd >= 0) ::shutdown(fd, SHUT_RDWR);
+}
+#else
+// 暂不支持 Windows
+inline bool send_all(int, const char*, std::size_t) { return false; }
+inline bool recv_all(int, char*, std::size_t) { return false; }
+inline void set_timeout(int, std::chrono::milliseconds) {}
+inline int open_socket(const std::string&, int, bool) { return -1; }
+inline void close_socket(int) {}
+inline void shutdown_socket(int) {}
+#endif
+
+inline bool send_message(int fd, MessageType type, const std::string& body) {
+  std::string header;
+  header.push_back(static_cast<char>(type));
+  serial::put_fixed<std::uint64_t>(header, body.size());
+  return send_all(fd, header.data(), header.size()) &&
+         send_all(fd, body.data(), body.size());
+}
+
+inline bool recv_u64(int fd, std::uint64_t& value) {
+  char buf[8];
+  if (!recv_all(fd, buf, sizeof(buf))) return false;
+  value = serial::decode_fixed<std::uint64_t>(buf);
+  return true;
+}
+
+// 发送长度 u64 与 in 的全部内容
+inline bool send_file(int fd, std::ifstream& in, std::uint64_t size) {
+  std::string header;
+  serial::put_fixed<std::uint64_t>(header, size);
+  if (!send_all(fd, header.data(), header.size())) return false;
+  std::string buffer(1 << 20, '\0');
+  while (size > 0) {
+    std::size_t n = static_cast<std::size_t>(
+        std::min<std::uint64_t>(size, buffer.size()));
+    if (!in.read(buffer.data(), static_cast<std::streamsize>(n)) ||
+        !send_all(fd, buffer.data(), n)) {
+      return false;
+    }
+    size -= n;
+  }
+  return true;
+}
+
+// 接收长度 u64 与其后的内容，写入 path；长度为 0 时不创建文件
+inline bool recv_file(int fd, const std::string& path) {
+  std::uint64_t size = 0;
+  if (!recv_u64(fd, size)) return false;
+  std::remove(path.c_str());
+  if (size == 0) return true;
+  std::ofstream out(path, std::ios::binary | std::ios::trunc);
+  std::string buffer(1 << 20, '\0');
+  while (size > 0 && out) {
+    std::size_t n = static_cast<std::size_t>(
+        std::min<std::uint64_t>(size, buffer.size()));
+    if (!recv_all(fd, buffer.data(), n)) return false;
+    out.write(buffer.data(), static_cast<std::streamsize>(n));
+    size -= n;
+  }
+  out.close();
+  if (!out) {
+    std::cerr << "Error writing replicated snapshot: " << path << std::endl;
+    return false;
+  }
+  return true;
+}
+
+inline std::uint64_t file_size(std::ifstream& in) {
+  if (!in.is_open()) return 0;
+  in.seekg(0, std::ios::end);
+  std::streamoff size = in.tellg();
+  in.seekg(0, std::ios::beg);
+  return size > 0 ? static_cast<std::uint64_t>(size) : 0;
+}
+
+}  // namespace detail
+
+}  // namespace repl
+
+// 复制的主节点：监听副本的连接，每个副本一个线程，先按握手做全量或增量同步，
+// 再持续推送新写出的日志记录。store 需要开启 wal_mode 与 replication_backlog，
+// 且不能是分层存储；store 必须比本对象活得更久
+template <typename K, typename V>
+class ReplicationPrimary {
+ public:
+  explicit ReplicationPrimary(KVStore<K, V>& store) : store_(store) {}
+  ~ReplicationPrimary() { stop(); }
+
+  ReplicationPrimary(const ReplicationPrimary&) = delete;
+  ReplicationPrimary& operator=(const ReplicationPrimary&) = delete;
+
+  // 在 host:port 上监听（host 为空时监听所有地址），失败时返回 false
+  bool start(const std::string& host, int port) {
+    if (!store_.can_replicate()) {
+      std::cerr << "Replication needs wal_mode, replication_backlog and a "
+                   "non-tiered store"
+                << std::endl;
+      return false;
+    }
+    listen_fd_ = repl::detail::open_socket(host, port, true);
+    if (listen_fd_ < 0) {
+      std::cerr << "Cannot listen for replicas on port " << port << std::endl;
+      return false;
+    }
+    stop_.store(false);
+    accept_thread_ = std::thread([this] { accept_loop(); });
+    return true;
+  }
+
+  // 断开全部副本并停止监听
+  void stop() {
+    if (!accept_thread_.joinable()) return;
+    stop_.store(true);
+    repl::detail::shutdown_socket(listen_fd_);
+    accept_thread_.join();
+    repl::detail::close_socket(listen_fd_);
+    listen_fd_ = -1;
+    std::list<Session> sessions;
+    {
+      std::lock_guard<std::mutex> guard(mutex_);
+      for (Session& s : sessions_) repl::detail::shutdown_socket(s.fd);
+      sessions.swap(sessions_);
+    }
+    for (Session& s : sessions) {
+      s.thread.join();
+      repl::detail::close_socket(s.fd);
+    }
+  }
+
+  // 正在推送日志的副本数
+  std::size_t replica_count() const { return streaming_.load(); }
+
+ private:
+  struct Session {
+    int fd;
+    std::thread thread;
+    std::atomic<bool> done{false};
+  };
+
+  void accept_loop() {
+    while (!stop_.load()) {
+#if !defined(_WIN32)
+      int fd = ::accept4(listen_fd_, nullptr, nullptr, SOCK_CLOEXEC);
+#else
+      int fd = -1;
+#endif
+      if (fd < 0) {
+        if (stop_.load()) return;
+        std::this_thread::sleep_for(repl::kPollInterval);
+        continue;
+      }
+      repl::detail::configure(fd);
+      std::lock_guard<std::mutex> guard(mutex_);
+      // 回收已结束的会话
+      for (auto it = sessions_.begin(); it != sessions_.end();) {
+        if (!it->done.load()) {
+          ++it;
+          continue;
+        }
+        it->thread.join();
+        repl::detail::close_socket(it->fd);
+        it = sessions_.erase(it);
+      }
+      Session& s = sessions_.emplace_back();
+      s.fd = fd;
+      s.thread = std::thread([this, &s] {
+        serve(s.fd);
+        s.done.store(true);
+      });
+    }
+  }
+
+  void serve(int fd) {
+    using namespace repl;
+    char handshake[kHandshakeSize];
+    detail::set_timeout(fd, kTimeout);
+    if (!detail::recv_all(fd, handshake, sizeof(handshake)) ||
+        std::memcmp(handshake, kMagic, sizeof(kMagic)) != 0) {
+      std::cerr << "Bad replication handshake" << std::endl;
+      return;
+    }
+    const std::uint64_t id = serial::decode_fixed<std::uint64_t>(handshake + 8);
+    std::uint64_t pos = serial::decode_fixed<std::uint64_t>(handshake + 16);
+    std::string records;
+    std::uint64_t last = pos;
+    std::string body;
+    if (id != 0 && id == store_.replication_id() &&
+        store_.read_log(pos, records, last, kMaxBatchBytes,
+                        std::chrono::milliseconds(0))) {
+      serial::put_fixed<std::uint64_t>(body, id);
+      serial::put_fixed<std::uint64_t>(body, pos);
+      if (!detail::send_message(fd, kContinue, body)) return;
+    } else if (!full_sync(fd, pos)) {
+      return;
+    }
+    streaming_.fetch_add(1);
+    auto idle_since = std::chrono::steady_clock::now();
+    while (!stop_.load()) {
+      if (records.empty() &&
+          !store_.read_log(pos, records, last, kMaxBatchBytes,
+                           kPollInterval)) {
+        std::cerr << "Replica fell behind the replication backlog, "
+                     "disconnecting"
+                  << std::endl;
+        break;
+      }
+      auto now = std::chrono::steady_clock::now();
+      body.clear();
+      bool ok = true;
+      if (!records.empty()) {
+        serial::put_fixed<std::uint64_t>(body, last);
+        body.append(records);
+        ok = detail::send_message(fd, kRecords, body);
+        pos = last;
+        records.clear();
+        idle_since = now;
+      } else if (now - idle_since >= kHeartbeatInterval) {
+        serial::put_fixed<std::uint64_t>(body, pos);
+        ok = detail::send_message(fd, kHeartbeat, body);
+        idle_since = now;
+      }
+      if (!ok) break;
+    }
+    streaming_.fetch_sub(1);
+  }
+
+  // 写出快照并发送给副本，pos 为快照对应的日志编号
+  bool full_sync(int fd, std::uint64_t& pos) {
+    std::ifstream snapshot;
+    std::ifstream expiry;
+    const std::uint64_t id = store_.replication_id();
+    if (!store_.checkpoint([&](std::uint64_t seq, const std::string& path,
+                               const std::string& expiry_path) {
+          pos = seq;
+          snapshot.open(path, std::ios::binary);
+          expiry.open(expiry_path, std::ios::binary);
+        }) ||
+        !snapshot.is_open()) {
+      std::cerr << "Cannot take a snapshot for a replica" << std::endl;
+      return false;
+    }
+    std::uint64_t snapshot_size = repl::detail::file_size(snapshot);
+    std::uint64_t expiry_size = repl::detail::file_size(expiry);
+    std::string header;
+    header.push_back(static_cast<char>(repl::kFullSync));
+    serial::put_fixed<std::uint64_t>(header,
+                                     32 + snapshot_size + expiry_size);
+    serial::put_fixed<std::uint64_t>(header, id);
+    serial::put_fixed<std::uint64_t>(header, pos);
+    return repl::detail::send_all(fd, header.data(), header.size()) &&
+           repl::detail::send_file(fd, snapshot, snapshot_size) &&
+           repl::detail::send_file(fd, expiry, expiry_size);
+  }
+
+  KVStore<K, V>& store_;
+  int listen_fd_ = -1;
+  std::atomic<bool> stop_{false};
+  std::thread accept_thread_;
+  std::mutex mutex_;  // 保护 sessions_
+  std::list<Session> sessions_;
+  std::atomic<std::size_t> streaming_{0};
+};
+
+// 复制的副本：后台线程连接主节点，全量或增量同步后持续应用主节点的日志，
+// 连接断开时每隔 kRetryInterval 重连，从已应用的编号继续。
+// 副本上的 KVStore 只应由本对象写入，读请求可以照常并发执行；
+// store 必须比本对象活得更久
+template <typename K, typename V>
+class Replica {
+ public:
+  Replica(KVStore<K, V>& store, std::string host, int port)
+      : store_(store), host_(std::move(host)), port_(port) {}
+  ~Replica() { stop(); }
+
+  Replica(const Replica&) = delete;
+  Replica& operator=(const Replica&) = delete;
+
+  void start() {
+    if (thread_.joinable()) return;
+    stop_ = false;
+    thread_ = std::thread([this] { run(); });
+  }
+
+  void stop() {
+    if (!thread_.joinable()) return;
+    {
+      std::lock_guard<std::mutex> guard(mutex_);
+      stop_ = true;
+      repl::detail::shutdown_socket(fd_);
+    }
+    cv_.notify_all();
+    thread_.join();
+  }
+
+  // 是否已与主节点同步并在接收日志
+  bool connected() const { return connected_.load(); }
+  // 已应用的主节点日志编号与主节点最近告知的已写出编号，二者之差即复制延迟
+  std::uint64_t applied_seq() const { return applied_.load(); }
+  std::uint64_t primary_seq() const { return primary_.load(); }
+
+ private:
+  void run() {
+    for (;;) {
+      int fd = repl::detail::open_socket(host_, port_, false);
+      {
+        std::lock_guard<std::mutex> guard(mutex_);
+        if (stop_) {
+          repl::detail::close_socket(fd);
+          return;
+        }
+        fd_ = fd;
+      }
+      if (fd >= 0) session(fd);
+      connected_.store(false);
+      std::unique_lock<std::mutex> lock(mutex_);
+      repl::detail::close_socket(fd_);
+      fd_ = -1;
+      if (cv_.wait_for(lock, repl::kRetryInterval, [this] { return stop_; })) {
+        return;
+      }
+    }
+  }
+
+  void session(int fd) {
+    using namespace repl;
+    std::string handshake(kMagic, sizeof(kMagic));
+    serial::put_fixed<std::uint64_t>(handshake, id_);
+    serial::put_fixed<std::uint64_t>(handshake, applied_.load());
+    if (!detail::send_all(fd, handshake.data(), handshake.size())) return;
+    // 主节点在第一条消息之前可能要先写出快照，不限制等待时间
+    detail::set_timeout(fd, std::chrono::milliseconds(0));
+    std::string records;
+    for (bool first = true;; first = false) {
+      char header[kMessageHeaderSize];
+      if (!detail::recv_all(fd, header, sizeof(header))) return;
+      if (first) detail::set_timeout(fd, kTimeout);
+      const auto type = static_cast<MessageType>(header[0]);
+      const std::uint64_t size =
+          serial::decode_fixed<std::uint64_t>(header + 1);
+      std::uint64_t id = 0;
+      std::uint64_t seq = 0;
+      if (first != (type == kFullSync || type == kContinue) || size < 8) {
+        std::cerr << "Unexpected replication message" << std::endl;
+        return;
+      }
+      if (type == kFullSync || type == kContinue) {
+        if (!detail::recv_u64(fd, id) || !detail::recv_u64(fd, seq)) return;
+        if (type == kFullSync && !install_snapshot(fd)) return;
+        if (type == kContinue && (id != id_ || seq != applied_.load())) return;
+        id_ = id;
+        applied_.store(seq);
+        primary_.store(std::max(primary_.load(), seq));
+        connected_.store(true);
+      } else if (type == kRecords) {
+        if (!detail::recv_u64(fd, seq)) return;
+        records.resize(size - 8);
+        if (!detail::recv_all(fd, records.data(), records.size())) return;
+        if (!store_.apply_log(records)) {
+          // 不知道应用到了哪一条，重新全量同步
+          std::cerr << "Corrupted replication stream" << std::endl;
+          id_ = 0;
+          return;
+        }
+        applied_.store(seq);
+        primary_.store(std::max(primary_.load(), seq));
+      } else if (type == kHeartbeat) {
+        if (!detail::recv_u64(fd, seq)) return;
+        primary_.store(seq);
+      } else {
+        std::cerr << "Unexpected replication message" << std::endl;
+        return;
+      }
+    }
+  }
+
+  // 接收快照与过期时间文件，替换 store 的全部数据
+  bool install_snapshot(int fd) {
+    const std::string snapshot_path = store_.path() + ".replica";
+    const std::string expiry_path = store_.path() + ".replica.ttl";
+    if (!repl::detail::recv_file(fd, snapshot_path) ||
+        !repl::detail::recv_file(fd, expiry_path)) {
+      return false;
+    }
+    // 重新全量同步之后之前的编号失效
+    id_ = 0;
+    return store_.restore(snapshot_path, expiry_path);
+  }
+
+  KVStore<K, V>& store_;
+  const std::string host_;
+  const int port_;
+  std::thread thread_;
+  std::mutex mutex_;  // 保护 stop_ 与 fd_
+  std::condition_variable cv_;
+  bool stop_ = false;
+  int fd_ = -1;
+  std::uint64_t id_ = 0;  // 主节点日志的复制标识，只在复制线程中访问
+  std::atomic<bool> connected_{false};
+  std::atomic<std::uint64_t> applied_{0};
+  std::atomic<std::uint64_t> primary_{0};
+};
@@ -0,0 +1,213 @@
+// include/Resp.h - Redis 序列化协议（RESP2）的解析与编码
+#pragma once
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <initializer_list>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// 请求是 bulk string 组成的数组（redis-cli、redis-benchmark 及各语言客户端
+// 都按此格式发送），也接受以空格分隔、以换行结束的内联命令（便于 telnet）：
+//   *<参数个数>\r\n $<长度>\r\n<字节>\r\n ...
+// 回复有五种："+简单字符串"、"-错误"、":整数"、"$<长度>\r\n<字节>"
+// （长度 -1 表示空值）与 "*<元素个数>" 开头的数组，各自以 \r\n 结束。
+// 解析是增量的：数据不完整时返回 kIncomplete，调用方读到更多字节后从头重试
+namespace resp {
+
+enum class Parse {
+  kOk,          // 解析出一条完整的请求 / 回复
+  kIncomplete,  // 需要更多数据
+  kError,       // 协议错误，连接应当关闭
+};
+
+// 单个参数与参数个数的上限，与 Redis 的默认值相同
+constexpr std::size_t kMaxBulk = 512u << 20;
+constexpr std::size_t kMaxArgs = 1u << 20;
+// 内联命令或长度行超过该长度仍未见到换行时视为协议错误
+constexpr std::size_t kMaxLine = 64u << 10;
+
+namespace detail {
+
+// 在 [p, end) 中找 \r\n，返回行尾（\r 的位置），没有完整的行时返回 nullptr
+inline const char* find_crlf(const char* p, const char* end) {
+  for (; p + 1 < end; ++p) {
+    if (p[0] == '\r' && p[1] == '\n') return p;
+  }
+  return nullptr;
+}
+
+// 解析 p 开始、以 \r\n 结束的十进制整数，成功时 p 移到下一行行首
+inline Parse parse_number(const char*& p, const char* end, long long& value) {
+  const char* eol = find_crlf(p, end);
+  if (eol == nullptr) {
+    return static_cast<std::size_t>(end - p) > 32 ? Parse::kError
+                                                  : Parse::kIncomplete;
+  }
+  auto [ptr, ec] = std::from_chars(p, eol, value);
+  if (ec != std::errc() || ptr != eol) return Parse::kError;
+  p = eol + 2;
+  return Parse::kOk;
+}
+
+inline Parse parse_inline(const char* p, const char* end,
+                          std::vector<std::string_view>& args,
+                          std::size_t& consumed) {
+  const char* begin = p;
+  const char* eol = p;
+  while (eol < end && *eol != '\n') ++eol;
+  if (eol == end) {
+    return static_cast<std::size_t>(end - p) > kMaxLine ? Parse::kError
+                                                        : Parse::kIncomplete;
+  }
+  const char* line_end = eol > p && eol[-1] == '\r' ? eol - 1 : eol;
+  while (p < line_end) {
+    while (p < line_end && (*p == ' ' || *p == '\t')) ++p;
+    const char* word = p;
+    while (p < line_end && *p != ' ' && *p != '\t') ++p;
+    if (p > word) args.emplace_back(word, p - word);
+  }
+  consumed = eol + 1 - begin;
+  return Parse::kOk;
+}
+
+}  // namespace detail
+
+// 从 [p, end) 解析一条请求，参数追加到 args（指向输入缓冲区，
+// 在缓冲区被修改前有效），consumed 为请求占用的字节数。
+// 空行不产生参数，调用方跳过 consumed 字节即可
+inline Parse parse_command(const char* p, const char* end,
+                           std::vector<std::string_view>& args,
+                           std::size_t& consumed) {
+  using namespace detail;
+  if (p == end) return Parse::kIncomplete;
+  if (*p != '*') return parse_inline(p, end, args, consumed);
+  const char* begin = p;
+  const std::size_t first = args.size();
+  ++p;
+  long long count = 0;
+  Parse r = parse_number(p, end, count);
+  if (r != Parse::kOk) return r;
+  if (count > static_cast<long long>(kMaxArgs)) return Parse::kError;
+  for (long long i = 0; i < count; ++i) {
+    if (p == end) {
+      args.resize(first);
+      return Parse::kIncomplete;
+    }
+    if (*p != '$') return Parse::kError;
+    ++p;
+    long long len = 0;
+    r = parse_number(p, end, len);
+    if (r == Parse::kIncomplete) args.resize(first);
+    if (r != Parse::kOk) return r;
+    if (len < 0 || len > static_cast<long long>(kMaxBulk)) {
+      return Parse::kError;
+    }
+    if (end - p < len + 2) {
+      args.resize(first);
+      return Parse::kIncomplete;
+    }
+    if (p[len] != '\r' || p[len + 1] != '\n') return Parse::kError;
+    args.emplace_back(p, static_cast<std::size_t>(len));
+    p += len + 2;
+  }
+  consumed = p - begin;
+  return Parse::kOk;
+}
+
+// 跳过 [p, end) 开头的一条回复（数组连同其全部元素），
+// is_error 不为空时记录它是否为错误回复；客户端只需按顺序计数回复时使用
+inline Parse skip_reply(const char* p, const char* end, std::size_t& consumed,
+                        bool* is_error = nullptr) {
+  using namespace detail;
+  const char* begin = p;
+  // 尚待跳过的回复数：数组把自身换成其元素
+  long long pending = 1;
+  bool first = true;
+  while (pending > 0) {
+    if (p == end) return Parse::kIncomplete;
+    char type = *p++;
+    if (first && is_error != nullptr) *is_error = type == '-';
+    first = false;
+    --pending;
+    switch (type) {
+      case '+':
+      case '-':
+      case ':': {
+        const char* eol = find_crlf(p, end);
+        if (eol == nullptr) return Parse::kIncomplete;
+        p = eol + 2;
+        break;
+      }
+      case '$': {
+        long long len = 0;
+        Parse r = parse_number(p, end, len);
+        if (r != Parse::kOk) return r;
+        if (len < 0) break;  // 空值
+        if (end - p < len + 2) return Parse::kIncomplete;
+        p += len + 2;
+        break;
+      }
+      case '*': {
+        long long count = 0;
+        Parse r = parse_number(p, end, count);
+        if (r != Parse::kOk) return r;
+        if (count > 0) pending += count;
+        break;
+      }
+      default:
+        return Parse::kError;
+    }
+  }
+  consumed = p - begin;
+  return Parse::kOk;
+}
+
+// ---------- 编码：结果追加到 out ----------
+
+inline void put_simple(std::string& out, std::string_view s) {
+  out.push_back('+');
+  out.append(s);
+  out.append("\r\n");
+}
+
+inline void put_error(std::string& out, std::string_view message) {
+  out.push_back('-');
+  out.append(message);
+  out.append("\r\n");
+}
+
+inline void put_prefixed(std::string& out, char type, long long value) {
+  char buf[24];
+  auto [ptr, ec] = std::to_chars(buf, buf + sizeof(buf), value);
+  out.push_back(type);
+  out.append(buf, ptr);
+  out.append("\r\n");
+}
+
+inline void put_integer(std::string& out, long long value) {
+  put_prefixed(out, ':', value);
+}
+
+inline void put_bulk(std::string& out, std::string_view s) {
+  put_prefixed(out, '$', static_cast<long long>(s.size()));
+  out.append(s);
+  out.append("\r\n");
+}
+
+inline void put_null(std::string& out) { out.append("$-1\r\n"); }
+
+// 数组头，其后由调用方写出 n 个元素
+inline void put_array(std::string& out, std::size_t n) {
+  put_prefixed(out, '*', static_cast<long long>(n));
+}
+
+// 按请求格式编码一条命令，供客户端使用
+inline void put_command(std::string& out,
+                        std::initializer_list<std::string_view> args) {
+  put_array(out, args.size());
+  for (std::string_view arg : args) put_bulk(out, arg);
+}
+
+}  // namespace resp
@@ -0,0 +1,186 @@
+// include/Serializer.h - 键值的二进制序列化，供快照文件与日志使用
+#pragma once
+#include <bit>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+
+namespace serial {
+
+// 变长整数 (LEB128)：每字节 7 位有效数据，最高位表示后面还有字节
+inline void put_varint(std::string& out, std::uint64_t v) {
+  while (v >= 0x80) {
+    out.push_back(static_cast<char>(v | 0x80));
+    v >>= 7;
+  }
+  out.push_back(static_cast<char>(v));
+}
+
+inline bool get_varint(const char*& p, const char* end, std::uint64_t& v) {
+  v = 0;
+  for (int shift = 0; shift <= 63 && p < end; shift += 7) {
+    std::uint64_t byte = static_cast<unsigned char>(*p++);
+    v |= (byte & 0x7F) << shift;
+    if ((byte & 0x80) == 0) return true;
+  }
+  return false;
+}
+
+// 定长整数统一按小端存储
+template <typename T>
+inline T to_little_endian(T v) {
+  if constexpr (std::endian::native == std::endian::big && sizeof(T) > 1) {
+    unsigned char bytes[sizeof(T)];
+    std::memcpy(bytes, &v, sizeof(T));
+    for (std::size_t i = 0; i < sizeof(T) / 2; ++i) {
+      unsigned char tmp = bytes[i];
+      bytes[i] = bytes[sizeof(T) - 1 - i];
+      bytes[sizeof(T) - 1 - i] = tmp;
+    }
+    std::memcpy(&v, bytes, sizeof(T));
+  }
+  return v;
+}
+
+template <typename T>
+inline void put_fixed(std::string& out, T v) {
+  v = to_little_endian(v);
+  out.append(reinterpret_cast<const char*>(&v), sizeof(T));
+}
+
+// 调用方保证 p 之后至少有 sizeof(T) 字节
+template <typename T>
+inline T decode_fixed(const char* p) {
+  T v;
+  std::memcpy(&v, p, sizeof(T));
+  return to_little_endian(v);
+}
+
+template <typename T>
+inline bool get_fixed(const char*& p, const char* end, T& v) {
+  if (static_cast<std::size_t>(end - p) < sizeof(T)) return false;
+  v = decode_fixed<T>(p);
+  p += sizeof(T);
+  return true;
+}
+
+// 读取带长度前缀的字节串，out 直接指向输入缓冲区，不做拷贝
+inline bool get_bytes_view(const char*& p, const char* end,
+                           std::string_view& out) {
+  std::uint64_t len;
+  if (!get_varint(p, end, len)) return false;
+  if (static_cast<std::uint64_t>(end - p) < len) return false;
+  out = std::string_view(p, static_cast<std::size_t>(len));
+  p += len;
+  return true;
+}
+
+inline bool get_bytes(const char*& p, const char* end, std::string& out) {
+  std::string_view view;
+  if (!get_bytes_view(p, end, view)) return false;
+  out.assign(view.data(), view.size());
+  return true;
+}
+
+}  // namespace serial
+
+// Serializer<T> 决定类型 T 在二进制文件中的编码方式：
+//   static void write(std::string& out, const T& v);
+//   static bool read(const char*& p, const char* end, T& v);
+//   static bool skip(const char*& p, const char* end);  // 跳过一个值
+// 自定义类型可以特化该模板（skip 可省略，省略时通过 read 跳过）；
+// 未特化的类型退化为 operator<< / operator>> 文本编码，并加上长度前缀，
+// 因此值中包含任意字符也不会破坏文件结构。
+template <typename T, typename Enable = void>
+struct Serializer {
+  static void write(std::string& out, const T& v) {
+    std::ostringstream ss;
+    ss << v;
+    const std::string text = ss.str();
+    serial::put_varint(out, text.size());
+    out.append(text);
+  }
+  static bool read(const char*& p, const char* end, T& v) {
+    std::string text;
+    if (!serial::get_bytes(p, end, text)) return false;
+    std::istringstream ss(text);
+    ss >> v;
+    return !ss.fail();
+  }
+  static bool skip(const char*& p, const char* end) {
+    std::string_view text;
+    return serial::get_bytes_view(p, end, text);
+  }
+};
+
+// 算术类型：定长小端编码
+template <typename T>
+struct Serializer<T, std::enable_if_t<std::is_arithmetic_v<T>>> {
+  static void write(std::string& out, const T& v) { serial::put_fixed(out, v); }
+  static bool read(const char*& p, const char* end, T& v) {
+    return serial::get_fixed(p, end, v);
+  }
+  static bool skip(const char*& p, const char* end) {
+    if (static_cast<std::size_t>(end - p) < sizeof(T)) return false;
+    p += sizeof(T);
+    return true;
+  }
+};
+
+// std::string：变长长度前缀 + 原始字节
+template <>
+struct Serializer<std::string> {
+  static void write(std::string& out, const std::string& v) {
+    serial::put_varint(out, v.size());
+    out.append(v);
+  }
+  static bool read(const char*& p, const char* end, std::string& v) {
+    return serial::get_bytes(p, end, v);
+  }
+  // 零拷贝读取：v 指向输入缓冲区
+  static bool read_view(const char*& p, const char* end, std::string_view& v) {
+    return serial::get_bytes_view(p, end, v);
+  }
+  static bool skip(const char*& p, const char* end) {
+    std::string_view v;
+    return serial::get_bytes_view(p, end, v);
+  }
+};
+
+// std::optional<T>：1 字节标记，有值时后跟 T 的编码。
+// 分层存储的有序表用 std::nullopt 表示删除标记
+template <typename T>
+struct Serializer<std::optional<T>> {
+  static void write(std::string& out, const std::optional<T>& v) {
+    out.push_back(v ? 1 : 0);
+    if (v) Serializer<T>::write(out, *v);
+  }
+  static bool read(const char*& p, const char* end, std::optional<T>& v) {
+    if (p == end) return false;
+    char flag = *p++;
+    if (flag == 0) {
+      v.reset();
+      return true;
+    }
+    if (flag != 1) return false;
+    if (!v) v.emplace();
+    return Serializer<T>::read(p, end, *v);
+  }
+  static bool skip(const char*& p, const char* end) {
+    if (p == end) return false;
+    char flag = *p++;
+    if (flag == 0) return true;
+    if (flag != 1) return false;
+    if constexpr (requires { Serializer<T>::skip(p, end); }) {
+      return Serializer<T>::skip(p, end);
+    } else {
+      T tmp{};
+      return Serializer<T>::read(p, end, tmp);
+    }
+  }
+};
@@ -1,49 +1,590 @@
 // include/SkipList.h
 #pragma once
+#include <algorithm>
+#include <atomic>
+#include <chrono>
 #include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
 #include <iostream>
+#include <iterator>
+#include <memory>
 #include <mutex>
-#include <random>
+#include <optional>
 #include <shared_mutex>
+#include <string>
+#include <type_traits>
+#include <utility>
 #include <vector>
 
+#if defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#include <xmmintrin.h>
+#endif
+
+#include "BloomFilter.h"
+#include "Metrics.h"
 #include "Node.h"
+#include "NodeAllocator.h"
+#include "RandomLevel.h"
 
 #define STORE_FILE "store/dumpFile"
 
-// 默认最大层数和概率
-const int MAX_LEVEL = 32;
-const double P_FACTOR = 0.5;
+// 默认最大层数和概率（可通过 SkipList 的模板参数为单个实例覆盖）
+constexpr int MAX_LEVEL = 32;
+constexpr double P_FACTOR = 0.5;
+
+namespace skiplist_detail {
+
+// 遍历回调可以返回 bool（返回 false 时提前结束）或 void（总是继续）
+template <typename Func, typename K, typename V>
+bool visit(Func& func, const K& key, const V& value) {
+  if constexpr (std::is_same_v<std::invoke_result_t<Func&, const K&, const V&>,
+                               bool>) {
+    return func(key, value);
+  } else {
+    func(key, value);
+    return true;
+  }
+}
+
+// Compare 声明了 is_transparent（如 std::less<>）时，查找接口还接受
+// 可以直接与 K 比较的其他类型，例如用 std::string_view 查找 std::string
+template <typename Compare>
+concept transparent = requires { typename Compare::is_transparent; };
+
+// 提示 CPU 把 p 所在的 cache line 提前读入缓存；只计算地址，p 可以为空
+inline void prefetch(const void* p) {
+#if defined(__GNUC__) || defined(__clang__)
+  __builtin_prefetch(p, 0, 3);
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+  _mm_prefetch(static_cast<const char*>(p), _MM_HINT_T0);
+#else
+  (void)p;
+#endif
+}
+
+// 线程第一次调用时按顺序分配的编号，用于把统计计数分散到不同的槽
+inline std::size_t thread_index() {
+  static std::atomic<std::size_t> next{0};
+  static thread_local std::size_t index =
+      next.fetch_add(1, std::memory_order_relaxed);
+  return index;
+}
+
+// 对象在节点之外持有的堆内存，用于估计跳表的内存占用；
+// 只统计超出 SSO 容量的 std::string，其他类型视为 0
+template <typename T>
+std::size_t heap_bytes(const T& v) {
+  if constexpr (std::is_same_v<T, std::string>) {
+    static const std::size_t kInline = std::string().capacity();
+    return v.capacity() > kInline ? v.capacity() + 1 : 0;
+  } else {
+    (void)v;
+    return 0;
+  }
+}
+
+}  // namespace skiplist_detail
 
-template <typename K, typename V>
+// SkipList::stats() 的结果。size / level / 内存 / 各层节点数总是可用，
+// 查找步数与锁等待只在 set_stats_enabled(true) 之后累计
+struct SkipListStats {
+  static constexpr std::size_t kHopBuckets = 128;
+
+  std::size_t size = 0;            // 元素个数
+  int level = 0;                   // 当前最高层号
+  std::size_t node_bytes = 0;      // 节点（含头节点）实际占用的字节数
+  std::size_t reserved_bytes = 0;  // 分配器向系统申请的字节数（含空闲块）
+  // level_nodes[i] 为最高层恰好为 i 的节点数；结构健康时约为
+  // size * (1 - p) * p^i
+  std::vector<std::size_t> level_nodes;
+  // hop_histogram[h] 为前进 h 步完成的查找次数（最后一桶包含更多步数），
+  // 一步指沿某一层的 forward 指针前进一次或下降一层
+  std::vector<std::uint64_t> hop_histogram;
+  std::uint64_t lock_waits = 0;    // 未能立即获得锁的次数
+  std::uint64_t lock_wait_ns = 0;  // 等待锁的总时长
+
+  std::uint64_t lookups() const {
+    std::uint64_t n = 0;
+    for (std::uint64_t c : hop_histogram) n += c;
+    return n;
+  }
+
+  double average_hops() const {
+    std::uint64_t n = 0, total = 0;
+    for (std::size_t h = 0; h < hop_histogram.size(); ++h) {
+      n += hop_histogram[h];
+      total += hop_histogram[h] * h;
+    }
+    return n == 0 ? 0.0 : static_cast<double>(total) / n;
+  }
+
+  // q 取 [0, 1]，如 0.99 返回 p99 步数
+  std::size_t hops_percentile(double q) const {
+    std::uint64_t n = lookups();
+    if (n == 0) return 0;
+    std::uint64_t rank = static_cast<std::uint64_t>(std::ceil(q * n));
+    if (rank == 0) rank = 1;
+    std::uint64_t seen = 0;
+    for (std::size_t h = 0; h < hop_histogram.size(); ++h) {
+      seen += hop_histogram[h];
+      if (seen >= rank) return h;
+    }
+    return hop_histogram.size() - 1;
+  }
+
+  // 合并另一个跳表的统计（如 KVStore 汇总各分片）
+  void merge(const SkipListStats& other) {
+    size += other.size;
+    level = std::max(level, other.level);
+    node_bytes += other.node_bytes;
+    reserved_bytes += other.reserved_bytes;
+    if (level_nodes.size() < other.level_nodes.size()) {
+      level_nodes.resize(other.level_nodes.size());
+    }
+    for (std::size_t i = 0; i < other.level_nodes.size(); ++i) {
+      level_nodes[i] += other.level_nodes[i];
+    }
+    if (hop_histogram.size() < other.hop_histogram.size()) {
+      hop_histogram.resize(other.hop_histogram.size());
+    }
+    for (std::size_t i = 0; i < other.hop_histogram.size(); ++i) {
+      hop_histogram[i] += other.hop_histogram[i];
+    }
+    lock_waits += other.lock_waits;
+    lock_wait_ns += other.lock_wait_ns;
+  }
+};
+
+// Alloc 为节点内存分配策略，默认逐个 new/delete，
+// 批量加载、频繁 clear 的场景可使用 ArenaNodeAllocator；
+// MaxLevel 为最高层号（头节点有 MaxLevel + 1 个 forward 指针），
+// 元素较少的大量实例可以取更小的值以节省头节点与查找路径的空间；
+// Compare 为 key 的严格弱序，两个 key 互不小于对方时视为相等；
+// PFactor 为节点晋升到上一层的概率；
+// SharedMutex 为保护整个跳表的读写锁，读密集且线程很多时可使用
+// DistributedSharedMutex，避免所有读者争用同一条 cache line。
+// key 为整数且按 std::less 排序时，节点的指针塔同时缓存各层后继的 key，
+// 查找只访问真正前进到的节点（见 Node.h）
+template <typename K, typename V, typename Alloc = HeapNodeAllocator,
+          int MaxLevel = MAX_LEVEL, typename Compare = std::less<K>,
+          double PFactor = P_FACTOR, typename SharedMutex = std::shared_mutex>
 class SkipList {
+  static_assert(MaxLevel >= 0, "MaxLevel must be non-negative");
+  static_assert(PFactor > 0.0 && PFactor < 1.0, "PFactor must be in (0, 1)");
+
  private:
-  Node<K, V>* header_;  // 头节点
+  static constexpr bool kCacheKeys =
+      std::is_integral_v<K> && !std::is_same_v<K, bool> &&
+      (std::is_same_v<Compare, std::less<K>> ||
+       std::is_same_v<Compare, std::less<>>);
+  using NodeType = Node<K, V, kCacheKeys>;
+
+  NodeType* header_;  // 头节点
   int current_level_;   // 当前层数
-  int element_count_;   // skiplist当前元素个数
+  // skiplist当前元素个数；在写锁内修改，size() 无锁读取
+  std::atomic<std::size_t> element_count_;
+
+  SharedMutex mutex_;  // 读写锁，用于线程安全
+  Alloc allocator_;    // 节点分配器（头节点除外）
+  [[no_unique_address]] Compare compare_;
+
+  // ---------- 统计 ----------
+  // 节点数与字节数在写锁内随插入 / 删除更新，代价为 O(1)；
+  // 查找步数与锁等待按线程编号分散到各个槽中累加，读者之间不共享 cache line
+  std::size_t level_nodes_[MaxLevel + 1] = {};
+  std::size_t node_bytes_ = 0;  // 不含头节点
+  // 节点字节数加上 key / value 的堆内存（见 skiplist_detail::heap_bytes），
+  // 在写锁内更新，memory_usage() 无锁读取
+  std::atomic<std::size_t> memory_bytes_{0};
+  static constexpr std::size_t kStatSlots = 16;
+
+  struct alignas(64) StatSlot {
+    std::atomic<std::uint64_t> hops[SkipListStats::kHopBuckets] = {};
+    std::atomic<std::uint64_t> lock_waits{0};
+    std::atomic<std::uint64_t> lock_wait_ns{0};
+  };
+  // nullptr 表示未开启；只在写锁内创建或释放，持有任意锁时读取
+  std::unique_ptr<StatSlot[]> stat_slots_;
+
+  StatSlot* stat_slot() const {
+    if (stat_slots_ == nullptr) return nullptr;
+    return &stat_slots_[skiplist_detail::thread_index() % kStatSlots];
+  }
+
+  // 以下两个函数需持有锁调用
+  void record_hops(std::size_t hops) const {
+    if (StatSlot* slot = stat_slot()) {
+      hops = std::min(hops, SkipListStats::kHopBuckets - 1);
+      slot->hops[hops].fetch_add(1, std::memory_order_relaxed);
+    }
+  }
+
+  void record_lock_wait(std::chrono::steady_clock::duration wait) const {
+    if (StatSlot* slot = stat_slot()) {
+      slot->lock_waits.fetch_add(1, std::memory_order_relaxed);
+      slot->lock_wait_ns.fetch_add(
+          static_cast<std::uint64_t>(
+              std::chrono::duration_cast<std::chrono::nanoseconds>(wait)
+                  .count()),
+          std::memory_order_relaxed);
+    }
+  }
+
+  // 先尝试直接加锁，只有需要等待时才读取时钟，无竞争时没有额外开销
+  std::shared_lock<SharedMutex> read_lock() {
+    std::shared_lock<SharedMutex> lock(mutex_, std::try_to_lock);
+    if (!lock.owns_lock()) {
+      auto start = std::chrono::steady_clock::now();
+      lock.lock();
+      record_lock_wait(std::chrono::steady_clock::now() - start);
+    }
+    return lock;
+  }
+
+  std::unique_lock<SharedMutex> write_lock() {
+    std::unique_lock<SharedMutex> lock(mutex_, std::try_to_lock);
+    if (!lock.owns_lock()) {
+      auto start = std::chrono::steady_clock::now();
+      lock.lock();
+      record_lock_wait(std::chrono::steady_clock::now() - start);
+    }
+    return lock;
+  }
 
-  std::shared_mutex mutex_;  // 互斥锁，用于线程安全
+  static std::size_t footprint(const NodeType* node) {
+    return NodeType::alloc_size(node->node_level_) +
+           skiplist_detail::heap_bytes(node->key_) +
+           skiplist_detail::heap_bytes(node->value_);
+  }
+
+  // 创建 / 销毁数据节点并维护计数；调用方需持有写锁
+  template <typename... Args>
+  NodeType* make_node(int level, Args&&... args) {
+    // 重建只遍历第 0 层，必须在新节点链接之前进行
+    if (filter_bits_ > 0 && filter_added_ >= filter_capacity_) {
+      rebuild_filter();
+    }
+    NodeType* node = NodeType::create_in_place(
+        allocator_, level, std::forward<Args>(args)...);
+    if constexpr (kFilterable) {
+      if (filter_bits_ > 0) {
+        filter_.add_hash(bloom::hash_key(node->key_));
+        ++filter_added_;
+      }
+    }
+    ++level_nodes_[level];
+    node_bytes_ += NodeType::alloc_size(level);
+    memory_bytes_.fetch_add(footprint(node), std::memory_order_relaxed);
+    element_count_.fetch_add(1, std::memory_order_relaxed);
+    return node;
+  }
+
+  void free_node(NodeType* node) {
+    --level_nodes_[node->node_level_];
+    node_bytes_ -= NodeType::alloc_size(node->node_level_);
+    memory_bytes_.fetch_sub(footprint(node), std::memory_order_relaxed);
+    element_count_.fetch_sub(1, std::memory_order_relaxed);
+    NodeType::destroy(allocator_, node);
+  }
+
+  // 覆盖已有节点的 value；调用方需持有写锁
+  template <typename VArg>
+  void assign_value(NodeType* node, VArg&& value) {
+    std::size_t before = skiplist_detail::heap_bytes(node->value_);
+    node->value_ = std::forward<VArg>(value);
+    // 无符号回绕后相加，结果与先减后加相同
+    memory_bytes_.fetch_add(skiplist_detail::heap_bytes(node->value_) - before,
+                            std::memory_order_relaxed);
+    mark_referenced(node);
+  }
+
+  // ---------- CLOCK 访问位 ----------
+  // 开启后查找命中与覆盖写都会置位节点的访问位；已置位时只读不写，
+  // 热点 key 所在的 cache line 不会被反复写脏。新节点的访问位未置位：
+  // 只写入过一次、从未被读取的 key 最先被淘汰。持有读锁即可调用
+  bool track_access_ = false;
+  // 淘汰扫描下一次开始的 key，std::nullopt 表示从头开始
+  std::optional<K> clock_hand_;
+
+  void mark_referenced(const NodeType* node) const {
+    if (track_access_ && !node->referenced_.load(std::memory_order_relaxed)) {
+      node->referenced_.store(true, std::memory_order_relaxed);
+    }
+  }
+
+  // ---------- Bloom filter ----------
+  // 开启后插入的 key 同时加入过滤器，查找不存在的 key 时大多只需一次哈希
+  // 与一条 cache line 的访问即可返回，不必下降。删除不清除过滤器中的位
+  // （只会误判为可能存在），自上次重建以来加入的 key 数达到容量时，
+  // 在写锁内按当前元素个数的两倍重建（自然淘汰已删除的 key），
+  // 均摊到每次插入为 O(1)。过滤器只在写锁内修改，读者持有读锁查询
+  static constexpr bool kFilterable = bloom::hashable<K>;
+  static constexpr std::size_t kMinFilterKeys = 1024;
+  int filter_bits_ = 0;  // 每个 key 的位数，0 表示未开启
+  BloomFilter filter_;
+  std::size_t filter_capacity_ = 0;
+  std::size_t filter_added_ = 0;  // 自上次重建以来加入的 key 数（含重建时）
+
+  void rebuild_filter() {
+    if constexpr (kFilterable) {
+      filter_capacity_ = std::max(kMinFilterKeys, 2 * size());
+      filter_ = BloomFilter(filter_capacity_, filter_bits_);
+      filter_added_ = 0;
+      for (NodeType* node = header_->forward(0); node;
+           node = node->forward(0)) {
+        filter_.add_hash(bloom::hash_key(node->key_));
+        ++filter_added_;
+      }
+    }
+  }
+
+  // 过滤器能否用于查找 Q：key 与 K 比较相等时哈希值必须相同，
+  // 异构查找只限同为字符串或同为整数的情形
+  template <typename Q>
+  static constexpr bool kFilterLookup =
+      kFilterable &&
+      (std::is_same_v<Q, K> ||
+       (std::is_convertible_v<const Q&, std::string_view> &&
+        std::is_convertible_v<const K&, std::string_view>) ||
+       (std::is_integral_v<Q> && std::is_integral_v<K>));
+
+  // 过滤器确定 key 不存在时返回 true；调用方需持有锁
+  template <typename Q>
+  bool filtered_out(const Q& key) const {
+    if constexpr (kFilterLookup<Q>) {
+      return filter_bits_ > 0 &&
+             !filter_.may_contain_hash(bloom::hash_key(key));
+    } else {
+      return false;
+    }
+  }
+
+  template <typename A, typename B>
+  bool less(const A& a, const B& b) const {
+    return compare_(a, b);
+  }
+  template <typename A, typename B>
+  bool equal(const A& a, const B& b) const {
+    return !compare_(a, b) && !compare_(b, a);
+  }
+
+  // 异构查找的 key 类型：Compare 透明且不是 K 本身
+  template <typename Q>
+  static constexpr bool kHeterogeneous =
+      skiplist_detail::transparent<Compare> && !std::is_same_v<Q, K>;
+
+  // ---------- finger search ----------
+  // 每个线程缓存自己最近一次访问的查找路径，下一次访问从路径继续。
+  // 其他线程的删除会释放或复用路径中的节点，插入会让高层的新节点越过
+  // 路径中的前驱，路径都不再准确，因此每次改变结构都在写锁内递增
+  // version_，版本不一致的路径作废
+  bool finger_enabled_ = false;
+  std::uint64_t instance_id_;            // 区分不同的 SkipList 实例
+  std::uint64_t version_ = 0;            // 受 mutex_ 保护
+  static constexpr int kFingerSlots = 8;  // 每线程按实例缓存的路径数
+
+  struct Finger {
+    std::uint64_t owner = 0;  // 0 表示空槽
+    std::uint64_t version = 0;
+    NodeType* update[MaxLevel + 1];
+  };
+
+  static std::uint64_t next_instance_id() {
+    static std::atomic<std::uint64_t> next{1};
+    return next.fetch_add(1, std::memory_order_relaxed);
+  }
+
+  // 取得当前线程在本实例上的路径，失效时重置为从头节点出发；调用方需持有锁
+  Finger& thread_finger() {
+    static thread_local Finger fingers[kFingerSlots];
+    Finger& finger = fingers[instance_id_ % kFingerSlots];
+    if (finger.owner != instance_id_ || finger.version != version_) {
+      finger.owner = instance_id_;
+      finger.version = version_;
+      for (int i = 0; i <= MaxLevel; ++i) finger.update[i] = header_;
+    }
+    return finger;
+  }
+
+  // 插入或删除节点后调用（持有写锁）：其他线程的路径全部作废；
+  // finger 为当前线程刚用过的路径，它是被插入 / 删除的 key 的精确前驱，
+  // 只包含小于该 key 的节点，仍然有效
+  void bump_version(Finger* finger) {
+    ++version_;
+    if (finger != nullptr) finger->version = version_;
+  }
 
  private:
+  // 层高不超过 MaxLevel，也不超过由当前元素个数推出的上限（见 RandomLevel.h）
   int get_random_level() {
-    // 使用局部静态变量替代类静态成员，避免类外定义的麻烦
-    static thread_local std::mt19937 generator{std::random_device{}()};
-    static thread_local std::uniform_real_distribution<double> distribution(
-        0.0, 1.0);
+    return skiplist_detail::LevelGenerator<PFactor>::next(
+        MaxLevel, element_count_.load(std::memory_order_relaxed));
+  }
+
+  // 定位 key 的写入位置：update 指向记录各层前驱的路径（开启 finger search
+  // 时为本线程的 finger，否则为调用方提供的 path），返回第 0 层前驱的后继；
+  // 调用方需持有写锁
+  NodeType* find_for_write(const K& key, NodeType** path,
+                             NodeType**& update);
+  // 在 update 记录的位置链接一个由 args 构造的新节点；调用方需持有写锁
+  template <typename... Args>
+  void link_new_node(NodeType** update, Args&&... args);
+  template <typename KArg, typename VArg>
+  bool insert_locked(KArg&& key, VArg&& value);
+
+  // 查找 key 所在的节点，不存在时返回 nullptr；调用方需持有读锁
+  template <typename Q>
+  NodeType* find_node(const Q& key) {
+    if (filtered_out(key)) {
+      record_hops(0);
+      return nullptr;
+    }
+    NodeType* current;
+    if (finger_enabled_) {
+      // 从本线程上次的路径继续
+      Finger& finger = thread_finger();
+      finger_seek(finger.update, key);
+      current = finger.update[0]->forward(0);
+    } else {
+      current = find_greater_or_equal(key);
+    }
+    if (current == nullptr || !equal(current->key_, key)) return nullptr;
+    mark_referenced(current);
+    return current;
+  }
+
+  // 返回第一个 key >= key 的节点，不存在时返回 nullptr；调用方需持有锁
+  template <typename Q>
+  NodeType* find_greater_or_equal(const Q& key) const {
+    if constexpr (kCacheKeys && std::is_same_v<Q, K>) {
+      return descend_cached(key, nullptr)->forward(0);
+    }
+    NodeType* current = header_;
+    std::size_t hops = 0;
+    for (int i = current_level_; i >= 0; --i, ++hops) {
+      while (current->forward(i) && less(current->forward(i)->key_, key)) {
+        current = current->forward(i);
+        ++hops;
+      }
+    }
+    record_hops(hops);
+    return current->forward(0);
+  }
 
-    int lvl = 0;
-    while (distribution(generator) < P_FACTOR && lvl < MAX_LEVEL) {
-      lvl++;
+  // 缓存了后继 key 时的下降：比较节点内的 next_key 决定前进还是下降，
+  // 不必为了一次失败的比较去访问后继节点；update 非空时记录各层前驱，
+  // 返回第 0 层的前驱。调用方需持有锁
+  NodeType* descend_cached(const K& key, NodeType** update) const
+    requires kCacheKeys
+  {
+    NodeType* current = header_;
+    std::size_t hops = 0;
+    for (int i = current_level_; i >= 0; --i, ++hops) {
+      while (current->next_key(i) < key) {
+        current = current->forward(i);
+        ++hops;
+      }
+      if (update != nullptr) update[i] = current;
+    }
+    record_hops(hops);
+    return current;
+  }
+
+  // 批量操作维护一条查找路径 update[0..MaxLevel]（finger）：
+  // update[i] 是第 i 层最后一个 key 小于目标 key 的节点。
+  // 对不小于上一个目标的 key，先自底向上找到需要前进的最高层，
+  // 再从该层沿路径继续下降，而不必每次回到 header_；调用方需持有锁
+  template <typename Q>
+  void finger_seek(NodeType** update, const Q& key) const {
+    if (update[0] != header_ && !less(update[0]->key_, key)) {
+      // 输入乱序，路径失效，从头节点重新查找
+      for (int i = 0; i <= MaxLevel; ++i) update[i] = header_;
+    }
+    // update[i] 的后继已经 >= key 时，更高层的后继也必然 >= key
+    int top = 0;
+    std::size_t hops = 1;
+    while (top <= current_level_) {
+      NodeType* next = update[top]->forward(top);
+      if (next == nullptr || !less(next->key_, key)) break;
+      ++top;
+      ++hops;
     }
-    return lvl;
+    NodeType* current = nullptr;
+    for (int i = top - 1; i >= 0; --i, ++hops) {
+      // 从上一层的结果与本层旧路径中靠右的一个出发
+      NodeType* start = update[i];
+      if (current != nullptr &&
+          (start == header_ || less(start->key_, current->key_))) {
+        start = current;
+      }
+      while (start->forward(i) && less(start->forward(i)->key_, key)) {
+        start = start->forward(i);
+        ++hops;
+      }
+      update[i] = start;
+      current = start;
+    }
+    record_hops(hops);
   }
 
  public:
-  SkipList() : current_level_(0), element_count_(0) {
+  // 按 key 升序的前向迭代器。迭代器（及其副本）共同持有跳表的读锁，
+  // 全部销毁前写操作会被阻塞，因此持有迭代器的线程不能再写同一个跳表
+  class Iterator {
+   public:
+    using iterator_category = std::forward_iterator_tag;
+    using value_type = NodeType;
+    using difference_type = std::ptrdiff_t;
+    using pointer = const NodeType*;
+    using reference = const NodeType&;
+
+    Iterator() = default;
+
+    bool valid() const { return node_ != nullptr; }
+    const K& key() const { return node_->key_; }
+    const V& value() const { return node_->value_; }
+
+    reference operator*() const { return *node_; }
+    pointer operator->() const { return node_; }
+
+    Iterator& operator++() {
+      node_ = node_->forward(0);
+      return *this;
+    }
+    Iterator operator++(int) {
+      Iterator tmp = *this;
+      ++*this;
+      return tmp;
+    }
+
+    bool operator==(const Iterator& other) const {
+      return node_ == other.node_;
+    }
+
+   private:
+    friend class SkipList;
+    using Lock = std::shared_lock<SharedMutex>;
+
+    Iterator(NodeType* node, std::shared_ptr<Lock> lock)
+        : node_(node), lock_(std::move(lock)) {}
+
+    NodeType* node_ = nullptr;
+    std::shared_ptr<Lock> lock_;
+  };
+
+  explicit SkipList(const Compare& compare = Compare())
+      : current_level_(0),
+        element_count_(0),
+        compare_(compare),
+        instance_id_(next_instance_id()) {
     // 初始化头节点，层数为0，key和value为空
-    K k;
-    V v;
-    header_ = new Node<K, V>(k, v, MAX_LEVEL);
+    // 头节点单独从堆上分配，这样 clear() 时分配器可以整块释放所有数据节点
+    K k{};
+    V v{};
+    HeapNodeAllocator heap;
+    header_ = NodeType::create(heap, k, v, MaxLevel);
   }
 
   // 禁止拷贝，防止Double Free
@@ -53,99 +594,610 @@ class SkipList {
   // 析构函数，删除所有节点
   ~SkipList() {
     clear();
-    delete header_;
+    HeapNodeAllocator heap;
+    NodeType::destroy(heap, header_);
+  }
+
+  // 开启后每个线程从自己上一次访问的位置继续查找，与上一次访问的 key
+  // 距离为 d 时代价为 O(log d)，适合 key 近似单调递增的写入；
+  // 随机访问时反而多出路径维护的开销，默认关闭
+  void set_finger_search(bool enabled) {
+    auto lock = write_lock();
+    finger_enabled_ = enabled;
+  }
+
+  // 元素个数，O(1) 且不加锁
+  std::size_t size() const {
+    return element_count_.load(std::memory_order_relaxed);
+  }
+
+  // 估计的内存占用：数据节点的字节数加上 key / value 持有的堆内存
+  // （只统计 std::string），不含头节点与分配器的空闲空间；O(1) 且不加锁
+  std::size_t memory_usage() const {
+    return memory_bytes_.load(std::memory_order_relaxed);
+  }
+
+  // 开启 Bloom filter，每个 key 占 bits_per_key 位（10 位时误判率约 1%），
+  // 不存在的 key 的 search_element / read_element 与批量查找大多无需下降；
+  // bits_per_key 为 0 时关闭。开启时遍历一遍建立过滤器，O(n)。
+  // 要求 Compare 认为相等的 key 哈希值相同（默认的 std::less 满足），
+  // key 的哈希见 bloom::hash_key
+  void set_bloom_filter(int bits_per_key)
+    requires kFilterable
+  {
+    auto lock = write_lock();
+    filter_bits_ = std::max(bits_per_key, 0);
+    if (filter_bits_ > 0) {
+      rebuild_filter();
+    } else {
+      filter_ = BloomFilter();
+      filter_capacity_ = 0;
+      filter_added_ = 0;
+    }
+  }
+
+  // 过滤器占用的字节数，未开启时为 0；持有读锁读取
+  std::size_t bloom_filter_bytes() {
+    auto lock = read_lock();
+    return filter_.serialize().size();
+  }
+
+  // 开启后查找命中与覆盖写会置位节点的访问位，供 evict_cold 使用；
+  // 每次命中多一次 relaxed 原子读（首次命中时再多一次写），默认关闭
+  void set_access_tracking(bool enabled) {
+    auto lock = write_lock();
+    track_access_ = enabled;
+  }
+
+  // 开启后累计每次查找的步数与加锁等待时间（写入按线程分散的计数槽，
+  // 每次操作多一次无竞争的原子加）；关闭时丢弃已累计的数据
+  void set_stats_enabled(bool enabled) {
+    auto lock = write_lock();
+    if (!enabled) {
+      stat_slots_.reset();
+    } else if (stat_slots_ == nullptr) {
+      stat_slots_ = std::make_unique<StatSlot[]>(kStatSlots);
+    }
+  }
+
+  // 返回当前的结构与统计信息，持有读锁，耗时 O(MaxLevel + 统计槽数)
+  SkipListStats stats() {
+    auto lock = read_lock();
+    SkipListStats result;
+    result.size = size();
+    result.level = current_level_;
+    result.node_bytes = node_bytes_ + NodeType::alloc_size(MaxLevel);
+    result.reserved_bytes = result.node_bytes;
+    if constexpr (requires { allocator_.bytes_reserved(); }) {
+      result.reserved_bytes =
+          allocator_.bytes_reserved() + NodeType::alloc_size(MaxLevel);
+    }
+    result.level_nodes.assign(std::begin(level_nodes_),
+                              std::end(level_nodes_));
+    if (stat_slots_ != nullptr) {
+      result.hop_histogram.assign(SkipListStats::kHopBuckets, 0);
+      for (std::size_t i = 0; i < kStatSlots; ++i) {
+        const StatSlot& slot = stat_slots_[i];
+        for (std::size_t h = 0; h < SkipListStats::kHopBuckets; ++h) {
+          result.hop_histogram[h] +=
+              slot.hops[h].load(std::memory_order_relaxed);
+        }
+        result.lock_waits += slot.lock_waits.load(std::memory_order_relaxed);
+        result.lock_wait_ns +=
+            slot.lock_wait_ns.load(std::memory_order_relaxed);
+      }
+    }
+    return result;
   }
 
   // 核心接口声明
   bool insert_element(const K& key, const V& value);  // 插入新节点
-  bool search_element(const K& key, V& value);        // 查找节点
-  bool delete_element(const K& key);                  // 删除节点
+  bool insert_element(K&& key, V&& value);            // 移动 key / value
+  // key 不存在时以 args 原地构造 value 并插入，返回 true；
+  // key 已存在时不做任何修改，返回 false
+  template <typename... Args>
+  bool emplace(K key, Args&&... args);
+  bool search_element(const K& key, V& value);  // 查找节点并复制出 value
+  template <typename Q>
+    requires kHeterogeneous<Q>
+  bool search_element(const Q& key, V& value) {
+    SKIPLIST_METRICS_TIMER(timer);
+    auto lock = read_lock();
+    NodeType* node = find_node(key);
+    SKIPLIST_METRICS_LAP(timer, kSearchTotal);
+    if (node == nullptr) return false;
+    value = node->value_;
+    return true;
+  }
+  // 零拷贝读取：在读锁内调用 func(const V&)，不复制 value；
+  // 返回 key 是否存在。func 中不能写入同一个跳表
+  template <typename Func>
+  bool read_element(const K& key, Func func);
+  template <typename Q, typename Func>
+    requires kHeterogeneous<Q>
+  bool read_element(const Q& key, Func func) {
+    SKIPLIST_METRICS_TIMER(timer);
+    auto lock = read_lock();
+    NodeType* node = find_node(key);
+    SKIPLIST_METRICS_LAP(timer, kSearchTotal);
+    if (node == nullptr) return false;
+    func(static_cast<const V&>(node->value_));
+    return true;
+  }
+  bool delete_element(const K& key);  // 删除节点
   // 遍历接口
   template <typename Func>
   void process_all(Func func);
+  // 有序访问：begin() / seek(key) 返回的迭代器持有读锁，end() 为尾后迭代器
+  Iterator begin();
+  Iterator end() { return Iterator(); }
+  // 定位到第一个 key >= key 的元素，O(log n)
+  Iterator seek(const K& key);
+  // 依次访问 [begin_key, end_key) 内的元素 func(key, value)，至多 limit 条
+  // （为 0 时不限制），返回访问的条数；func 返回 false 时提前结束
+  template <typename Func>
+  std::size_t scan(const K& begin_key, const K& end_key, std::size_t limit,
+                   Func func);
+  // 批量读写：整批只加一次锁，输入按 key 升序时复用上一个 key 的查找路径；
+  // 乱序输入结果仍然正确，只是退化为从头节点查找。
+  // search_batch 对每个 key 调用 func(key, const V*)，不存在时传入 nullptr；
+  // insert_batch 的元素为 pair<K, V>，返回处理的个数；
+  // delete_batch 返回实际删除的个数
+  template <typename KeyIt, typename Func>
+  void search_batch(KeyIt first, KeyIt last, Func func);
+  // 交错批量查找：[first, last) 的 key 顺序任意，每 kInterleave 个一组，
+  // 组内的查找轮流前进一步，并预取各自下一步要访问的节点，使彼此的缓存
+  // 未命中重叠；按输入顺序调用 func(key, const V*)。适合数据量超过缓存的
+  // 稀疏随机 get，彼此相邻的有序 key 用 search_batch 更快
+  static constexpr int kInterleave = 8;
+  template <typename KeyIt, typename Func>
+  void search_interleaved(KeyIt first, KeyIt last, Func func);
+  template <typename InputIt>
+  std::size_t insert_batch(InputIt first, InputIt last);
+  template <typename KeyIt>
+  std::size_t delete_batch(KeyIt first, KeyIt last);
+  // 批量加载：[first, last) 为 pair<K, V> 序列，按 key 严格升序时
+  // 只需一次加锁、线性追加；乱序或与已有 key 重叠的元素退化为普通插入。
+  // 传入 std::move_iterator 时元素被移动进节点
+  template <typename InputIt>
+  std::size_t bulk_load(InputIt first, InputIt last);
+  // CLOCK 淘汰：从上一次停下的位置沿第 0 层继续扫描，访问位已置位的节点
+  // 清除访问位后跳过，未置位的节点被删除，直到 memory_usage() 不超过
+  // target_bytes 或扫描满两圈（回到表尾后从头继续）。删除前在写锁内调用
+  // func(key, value)，func 中不能访问同一个跳表。返回删除的个数
+  template <typename Func>
+  std::size_t evict_cold(std::size_t target_bytes, Func func);
   // 清空跳表
   void clear();
 };
 
 // 清空跳表
-template <typename K, typename V>
-void SkipList<K, V>::clear() {
-  Node<K, V>* current = header_->forward_[0];
-  while (current) {
-    Node<K, V>* next = current->forward_[0];
-    delete current;
-    current = next;
+template <typename K, typename V, typename Alloc, int MaxLevel,
+          typename Compare, double PFactor, typename SharedMutex>
+void SkipList<K, V, Alloc, MaxLevel, Compare, PFactor, SharedMutex>::clear() {
+  auto lock = write_lock();
+  if constexpr (Alloc::kBulkRelease) {
+    // 分配器可整块归还内存：只需逐个析构（平凡析构的类型连遍历都省去），
+    // 然后按 chunk 一次性释放
+    if constexpr (!std::is_trivially_destructible_v<K> ||
+                  !std::is_trivially_destructible_v<V>) {
+      NodeType* current = header_->forward(0);
+      while (current) {
+        NodeType* next = current->forward(0);
+        NodeType::destruct(current);
+        current = next;
+      }
+    }
+    allocator_.release_all();
+  } else {
+    NodeType* current = header_->forward(0);
+    while (current) {
+      NodeType* next = current->forward(0);
+      NodeType::destroy(allocator_, current);
+      current = next;
+    }
   }
 
-  // 清空头节点的 forward 指针数组
-  std::fill(header_->forward_.begin(), header_->forward_.end(), nullptr);
+  bump_version(nullptr);
+  // 清空头节点的 forward 指针塔
+  for (int i = 0; i <= MaxLevel; ++i) {
+    header_->set_forward(i, nullptr);
+  }
   // 重置状态
   current_level_ = 0;
-  element_count_ = 0;
+  element_count_.store(0, std::memory_order_relaxed);
+  std::fill(std::begin(level_nodes_), std::end(level_nodes_), 0);
+  node_bytes_ = 0;
+  memory_bytes_.store(0, std::memory_order_relaxed);
+  clock_hand_.reset();
+  if (filter_bits_ > 0) rebuild_filter();
 }
 
 // 逻辑：从最高层出发，若右边的key比目标小，就向右走；否则向下走
-template <typename K, typename V>
-bool SkipList<K, V>::search_element(const K& key, V& value) {
-  Node<K, V>* current = header_;
+// （或从本线程上次的路径继续），得到 >= key 的第一个节点
+template <typename K, typename V, typename Alloc, int MaxLevel,
+          typename Compare, double PFactor, typename SharedMutex>
+bool SkipList<K, V, Alloc, MaxLevel, Compare, PFactor,
+              SharedMutex>::search_element(const K& key, V& value) {
+  SKIPLIST_METRICS_TIMER(timer);
+  auto lock = read_lock();
+  NodeType* node = find_node(key);
+  SKIPLIST_METRICS_LAP(timer, kSearchTotal);
+  if (node == nullptr) return false;
+  value = node->value_;
+  return true;
+}
+
+template <typename K, typename V, typename Alloc, int MaxLevel,
+          typename Compare, double PFactor, typename SharedMutex>
+template <typename Func>
+bool SkipList<K, V, Alloc, MaxLevel, Compare, PFactor,
+              SharedMutex>::read_element(const K& key, Func func) {
+  SKIPLIST_METRICS_TIMER(timer);
+  auto lock = read_lock();
+  NodeType* node = find_node(key);
+  SKIPLIST_METRICS_LAP(timer, kSearchTotal);
+  if (node == nullptr) return false;
+  func(static_cast<const V&>(node->value_));
+  return true;
+}
+
+// 供外部遍历所有节点 (e.g. KVStore dump)
+template <typename K, typename V, typename Alloc, int MaxLevel,
+          typename Compare, double PFactor, typename SharedMutex>
+template <typename Func>
+void SkipList<K, V, Alloc, MaxLevel, Compare, PFactor,
+              SharedMutex>::process_all(Func func) {
+  NodeType* node = header_->forward(0);
+  while (node != nullptr) {
+    func(node->key_, node->value_);
+    node = node->forward(0);
+  }
+}
 
-  std::shared_lock<std::shared_mutex> lock(mutex_);
+template <typename K, typename V, typename Alloc, int MaxLevel,
+          typename Compare, double PFactor, typename SharedMutex>
+auto SkipList<K, V, Alloc, MaxLevel, Compare, PFactor, SharedMutex>::begin()
+    -> Iterator {
+  auto lock = std::make_shared<typename Iterator::Lock>(read_lock());
+  return Iterator(header_->forward(0), std::move(lock));
+}
+
+template <typename K, typename V, typename Alloc, int MaxLevel,
+          typename Compare, double PFactor, typename SharedMutex>
+auto SkipList<K, V, Alloc, MaxLevel, Compare, PFactor, SharedMutex>::seek(
+    const K& key) -> Iterator {
+  auto lock = std::make_shared<typename Iterator::Lock>(read_lock());
+  return Iterator(find_greater_or_equal(key), std::move(lock));
+}
+
+// 先下降定位起点 O(log n)，再沿第 0 层顺序访问 O(k)
+template <typename K, typename V, typename Alloc, int MaxLevel,
+          typename Compare, double PFactor, typename SharedMutex>
+template <typename Func>
+std::size_t
+SkipList<K, V, Alloc, MaxLevel, Compare, PFactor, SharedMutex>::scan(
+    const K& begin_key, const K& end_key, std::size_t limit, Func func) {
+  auto lock = read_lock();
+  std::size_t count = 0;
+  for (NodeType* node = find_greater_or_equal(begin_key);
+       node != nullptr && less(node->key_, end_key);
+       node = node->forward(0)) {
+    ++count;
+    if (!skiplist_detail::visit(func, node->key_, node->value_)) break;
+    if (count == limit) break;
+  }
+  return count;
+}
 
-  // 从最高层向下遍历，直到最后一层
-  // 循环结束时，要么右边没有节点了，要么右边的key大于等于目标key
-  for (int i = current_level_; i >= 0; --i) {
-    // 向右遍历，直到找到大于等于 key 的节点
-    while (current->forward_[i] && current->forward_[i]->key_ < key) {
-      current = current->forward_[i];
+template <typename K, typename V, typename Alloc, int MaxLevel,
+          typename Compare, double PFactor, typename SharedMutex>
+template <typename KeyIt, typename Func>
+void SkipList<K, V, Alloc, MaxLevel, Compare, PFactor,
+              SharedMutex>::search_batch(KeyIt first, KeyIt last, Func func) {
+  auto lock = read_lock();
+  NodeType* update[MaxLevel + 1];
+  for (int i = 0; i <= MaxLevel; ++i) update[i] = header_;
+  for (; first != last; ++first) {
+    const K& key = *first;
+    if (filtered_out(key)) {
+      record_hops(0);
+      func(key, nullptr);
+      continue;
+    }
+    finger_seek(update, key);
+    NodeType* node = update[0]->forward(0);
+    if (node && equal(node->key_, key)) {
+      mark_referenced(node);
+      func(key, &node->value_);
+    } else {
+      func(key, nullptr);
     }
   }
+}
 
-  // 到达第0层，current指向的是 < key 的最后一个节点
-  // 再向右遍历，找到 >= key 的节点
-  current = current->forward_[0];
-  if (current && current->key_ == key) {
-    value = current->value_;
-    return true;
+template <typename K, typename V, typename Alloc, int MaxLevel,
+          typename Compare, double PFactor, typename SharedMutex>
+template <typename KeyIt, typename Func>
+void SkipList<K, V, Alloc, MaxLevel, Compare, PFactor, SharedMutex>::
+    search_interleaved(KeyIt first, KeyIt last, Func func) {
+  // 一个进行中的查找。未缓存后继 key 时，next 是已经预取、下一步要比较的
+  // 后继；缓存时 current 的第 level 层已经预取，下一步只读 current 本身
+  struct Lane {
+    KeyIt key;
+    NodeType* current;
+    NodeType* next;
+    int level;
+    std::size_t hops;
+    bool done;
+  };
+  // 前进一步（至多一次可能未命中的访存），找到第一个 >= key 的节点时
+  // 把它存入 next 并返回 true
+  auto step = [this](Lane& lane) {
+    const K& key = *lane.key;
+    ++lane.hops;
+    if constexpr (kCacheKeys) {
+      // 在 current 内下降到需要前进的层，这些比较都不访问其他节点
+      while (!(lane.current->next_key(lane.level) < key)) {
+        if (lane.level == 0) {
+          lane.next = lane.current->forward(0);
+          return true;
+        }
+        --lane.level;
+        ++lane.hops;
+      }
+      lane.current = lane.current->forward(lane.level);
+      skiplist_detail::prefetch(lane.current->forward_address(lane.level));
+    } else {
+      NodeType* next = lane.next;
+      if (next && less(next->key_, key)) {
+        lane.current = next;
+      } else if (lane.level == 0) {
+        return true;
+      } else {
+        --lane.level;
+      }
+      lane.next = lane.current->forward(lane.level);
+      skiplist_detail::prefetch(lane.next);
+    }
+    return false;
+  };
+
+  auto lock = read_lock();
+  while (first != last) {
+    Lane lanes[kInterleave];
+    int n = 0;
+    int active = 0;
+    for (; n < kInterleave && first != last; ++n, ++first) {
+      Lane& lane = lanes[n];
+      lane.key = first;
+      lane.current = header_;
+      lane.level = current_level_;
+      lane.hops = 0;
+      // 被 Bloom filter 排除的 key 直接完成，不参与下降
+      lane.done = filtered_out(*first);
+      if (lane.done) {
+        lane.next = nullptr;
+        continue;
+      }
+      ++active;
+      lane.next = header_->forward(current_level_);
+      if constexpr (!kCacheKeys) skiplist_detail::prefetch(lane.next);
+    }
+    while (active > 0) {
+      for (int j = 0; j < n; ++j) {
+        if (!lanes[j].done && step(lanes[j])) {
+          lanes[j].done = true;
+          --active;
+          if (NodeType* node = lanes[j].next) {
+            skiplist_detail::prefetch(&node->value_);
+          }
+        }
+      }
+    }
+    for (int j = 0; j < n; ++j) {
+      const K& key = *lanes[j].key;
+      NodeType* node = lanes[j].next;
+      record_hops(lanes[j].hops);
+      if (node && equal(node->key_, key)) {
+        mark_referenced(node);
+        func(key, &node->value_);
+      } else {
+        func(key, nullptr);
+      }
+    }
   }
-  return false;
 }
 
-// 供外部遍历所有节点 (e.g. KVStore dump)
-template <typename K, typename V>
-template <typename Func>
-void SkipList<K, V>::process_all(Func func) {
-  Node<K, V>* node = header_->forward_[0];
-  while (node != nullptr) {
-    func(node->key_, node->value_);
-    node = node->forward_[0];
+template <typename K, typename V, typename Alloc, int MaxLevel,
+          typename Compare, double PFactor, typename SharedMutex>
+template <typename InputIt>
+std::size_t SkipList<K, V, Alloc, MaxLevel, Compare, PFactor,
+                     SharedMutex>::insert_batch(InputIt first, InputIt last) {
+  SKIPLIST_METRICS_TIMER(timer);
+  auto lock = write_lock();
+  NodeType* update[MaxLevel + 1];
+  for (int i = 0; i <= MaxLevel; ++i) update[i] = header_;
+  std::size_t count = 0;
+  bool linked = false;
+  for (; first != last; ++first, ++count) {
+    const auto& entry = *first;
+    const K& key = entry.first;
+    finger_seek(update, key);
+    NodeType* node = update[0]->forward(0);
+    if (node && equal(node->key_, key)) {
+      assign_value(node, entry.second);
+      continue;
+    }
+    linked = true;
+    int random_level = get_random_level();
+    if (random_level > current_level_) current_level_ = random_level;
+    NodeType* new_node = make_node(random_level, key, entry.second);
+    // update 仍是新节点的前驱，对后续更大的 key 同样有效
+    for (int i = 0; i <= random_level; ++i) {
+      new_node->set_forward(i, update[i]->forward(i));
+      update[i]->set_forward(i, new_node);
+    }
   }
+  if (linked) bump_version(nullptr);
+  SKIPLIST_METRICS_LAP(timer, kInsertBatch);
+  return count;
 }
 
-// 需要一个update数组，用于记录每一层下降的位置（也就是新节点的前驱）
-template <typename K, typename V>
-bool SkipList<K, V>::insert_element(const K& key, const V& value) {
-  Node<K, V>* current = header_;
-  std::unique_lock<std::shared_mutex> lock(mutex_);
-  // 使用圆括号初始化，创建大小为 MAX_LEVEL + 1 的 vector，所有元素初始化为
-  // nullptr
-  std::vector<Node<K, V>*> update(MAX_LEVEL + 1, nullptr);
+template <typename K, typename V, typename Alloc, int MaxLevel,
+          typename Compare, double PFactor, typename SharedMutex>
+template <typename KeyIt>
+std::size_t SkipList<K, V, Alloc, MaxLevel, Compare, PFactor,
+                     SharedMutex>::delete_batch(KeyIt first, KeyIt last) {
+  SKIPLIST_METRICS_TIMER(timer);
+  auto lock = write_lock();
+  NodeType* update[MaxLevel + 1];
+  for (int i = 0; i <= MaxLevel; ++i) update[i] = header_;
+  std::size_t count = 0;
+  for (; first != last; ++first) {
+    const K& key = *first;
+    finger_seek(update, key);
+    NodeType* node = update[0]->forward(0);
+    if (node == nullptr || !equal(node->key_, key)) continue;
+    for (int i = 0; i <= current_level_; ++i) {
+      if (update[i]->forward(i) != node) break;
+      update[i]->set_forward(i, node->forward(i));
+    }
+    while (current_level_ > 0 && header_->forward(current_level_) == nullptr) {
+      --current_level_;
+    }
+    free_node(node);
+    ++count;
+  }
+  if (count > 0) bump_version(nullptr);
+  SKIPLIST_METRICS_LAP(timer, kDeleteBatch);
+  return count;
+}
 
-  // 1. 寻找插入位置
-  for (int i = current_level_; i >= 0; --i) {
-    while (current->forward_[i] && current->forward_[i]->key_ < key) {
-      current = current->forward_[i];
+// 维护每一层的尾节点 tail[i]，新节点直接挂在各层尾部，
+// 无需从 header_ 开始逐层查找，整体 O(n)
+template <typename K, typename V, typename Alloc, int MaxLevel,
+          typename Compare, double PFactor, typename SharedMutex>
+template <typename InputIt>
+std::size_t SkipList<K, V, Alloc, MaxLevel, Compare, PFactor,
+                     SharedMutex>::bulk_load(InputIt first, InputIt last) {
+  auto lock = write_lock();
+  NodeType* tail[MaxLevel + 1];
+  bool tail_valid = false;
+  std::size_t count = 0;
+
+  for (; first != last; ++first, ++count) {
+    // 经 std::move_iterator 传入时 key / value 被移动进节点
+    auto&& entry = *first;
+    using Entry = decltype(entry);
+    const K& key = entry.first;
+
+    if (!tail_valid) {
+      // 定位当前每一层的最后一个节点
+      NodeType* current = header_;
+      for (int i = current_level_; i >= 0; --i) {
+        while (current->forward(i)) current = current->forward(i);
+        tail[i] = current;
+      }
+      for (int i = current_level_ + 1; i <= MaxLevel; ++i) tail[i] = header_;
+      tail_valid = true;
+    }
+
+    if (tail[0] != header_ && !less(tail[0]->key_, key)) {
+      // 不大于当前最大 key：走普通插入，之后重新定位尾节点
+      insert_locked(std::forward<Entry>(entry).first,
+                    std::forward<Entry>(entry).second);
+      tail_valid = false;
+      continue;
+    }
+
+    int random_level = get_random_level();
+    if (random_level > current_level_) current_level_ = random_level;
+    NodeType* new_node =
+        make_node(random_level, std::forward<Entry>(entry).first,
+                  std::forward<Entry>(entry).second);
+    for (int i = 0; i <= random_level; ++i) {
+      tail[i]->set_forward(i, new_node);
+      tail[i] = new_node;
     }
-    update[i] = current;
   }
-  // 2. 检查 key 是否已存在
-  current = current->forward_[0];
-  if (current && current->key_ == key) {
-    // 存在则更新值
-    current->value_ = value;
-    return true;
+  if (count > 0) bump_version(nullptr);
+  return count;
+}
+
+template <typename K, typename V, typename Alloc, int MaxLevel,
+          typename Compare, double PFactor, typename SharedMutex>
+bool SkipList<K, V, Alloc, MaxLevel, Compare, PFactor,
+              SharedMutex>::insert_element(const K& key, const V& value) {
+  SKIPLIST_METRICS_TIMER(timer);
+  auto lock = write_lock();
+  SKIPLIST_METRICS_LAP(timer, kInsertLock);
+  return insert_locked(key, value);
+}
+
+template <typename K, typename V, typename Alloc, int MaxLevel,
+          typename Compare, double PFactor, typename SharedMutex>
+bool SkipList<K, V, Alloc, MaxLevel, Compare, PFactor,
+              SharedMutex>::insert_element(K&& key, V&& value) {
+  SKIPLIST_METRICS_TIMER(timer);
+  auto lock = write_lock();
+  SKIPLIST_METRICS_LAP(timer, kInsertLock);
+  return insert_locked(std::move(key), std::move(value));
+}
+
+template <typename K, typename V, typename Alloc, int MaxLevel,
+          typename Compare, double PFactor, typename SharedMutex>
+template <typename... Args>
+bool SkipList<K, V, Alloc, MaxLevel, Compare, PFactor, SharedMutex>::emplace(
+    K key, Args&&... args) {
+  auto lock = write_lock();
+  NodeType* path[MaxLevel + 1];
+  NodeType** update;
+  NodeType* current = find_for_write(key, path, update);
+  if (current && equal(current->key_, key)) return false;
+  link_new_node(update, std::move(key), std::forward<Args>(args)...);
+  return true;
+}
+
+// 需要一个update数组，用于记录每一层下降的位置（也就是新节点的前驱）
+// 调用方需持有写锁
+template <typename K, typename V, typename Alloc, int MaxLevel,
+          typename Compare, double PFactor, typename SharedMutex>
+auto SkipList<K, V, Alloc, MaxLevel, Compare, PFactor,
+              SharedMutex>::find_for_write(const K& key, NodeType** path,
+                                           NodeType**& update) -> NodeType* {
+  if (finger_enabled_) {
+    // 从本线程上次的路径继续；插入后路径仍是新节点的精确前驱，继续有效
+    update = thread_finger().update;
+    finger_seek(update, key);
+    return update[0]->forward(0);
+  }
+  // 未开启 finger search 时，路径记录在调用方栈上大小为 MaxLevel + 1 的
+  // 数组中，写锁内不再有堆分配
+  update = path;
+  if constexpr (kCacheKeys) {
+    return descend_cached(key, update)->forward(0);
+  }
+  NodeType* current = header_;
+  std::size_t hops = 0;
+  for (int i = current_level_; i >= 0; --i, ++hops) {
+    while (current->forward(i) && less(current->forward(i)->key_, key)) {
+      current = current->forward(i);
+      ++hops;
+    }
+    update[i] = current;
   }
+  record_hops(hops);
+  return current->forward(0);
+}
 
-  // 3. 生成新节点层数
+template <typename K, typename V, typename Alloc, int MaxLevel,
+          typename Compare, double PFactor, typename SharedMutex>
+template <typename... Args>
+void SkipList<K, V, Alloc, MaxLevel, Compare, PFactor,
+              SharedMutex>::link_new_node(NodeType** update, Args&&... args) {
+  SKIPLIST_METRICS_TIMER(timer);
+  // 生成新节点层数
   int random_level = get_random_level();
 
   // 如果新层数超过当前最大层数，需要更新 update 数组
@@ -157,44 +1209,88 @@ bool SkipList<K, V>::insert_element(const K& key, const V& value) {
     current_level_ = random_level;
   }
 
-  // 4. 创建并链接新节点
-  Node<K, V>* new_node = new Node<K, V>(key, value, random_level);
+  // 创建并链接新节点
+  NodeType* new_node =
+      make_node(random_level, std::forward<Args>(args)...);
+  SKIPLIST_METRICS_LAP(timer, kInsertAllocate);
   for (int i = 0; i <= random_level; i++) {
-    new_node->forward_[i] = update[i]->forward_[i];
-    update[i]->forward_[i] = new_node;
+    new_node->set_forward(i, update[i]->forward(i));
+    update[i]->set_forward(i, new_node);
+  }
+  // update 即本线程的 finger（由 find_for_write 在同一把写锁内校验过）
+  bump_version(finger_enabled_ ? &thread_finger() : nullptr);
+  SKIPLIST_METRICS_LAP(timer, kInsertLink);
+}
+
+template <typename K, typename V, typename Alloc, int MaxLevel,
+          typename Compare, double PFactor, typename SharedMutex>
+template <typename KArg, typename VArg>
+bool SkipList<K, V, Alloc, MaxLevel, Compare, PFactor,
+              SharedMutex>::insert_locked(KArg&& key, VArg&& value) {
+  // 1. 寻找插入位置
+  SKIPLIST_METRICS_TIMER(timer);
+  NodeType* path[MaxLevel + 1];
+  NodeType** update;
+  NodeType* current = find_for_write(key, path, update);
+  SKIPLIST_METRICS_LAP(timer, kInsertTraverse);
+
+  // 2. 检查 key 是否已存在
+  if (current && equal(current->key_, key)) {
+    // 存在则更新值
+    assign_value(current, std::forward<VArg>(value));
+    return true;
   }
 
-  element_count_++;
+  // 3. 创建并链接新节点
+  link_new_node(update, std::forward<KArg>(key), std::forward<VArg>(value));
   return true;
 }
 
-template <typename K, typename V>
+template <typename K, typename V, typename Alloc, int MaxLevel,
+          typename Compare, double PFactor, typename SharedMutex>
 
-bool SkipList<K, V>::delete_element(const K& key) {
-  std::unique_lock<std::shared_mutex> lock(mutex_);
-  Node<K, V>* current = header_;
+bool SkipList<K, V, Alloc, MaxLevel, Compare, PFactor,
+              SharedMutex>::delete_element(const K& key) {
+  SKIPLIST_METRICS_TIMER(timer);
+  auto lock = write_lock();
+  NodeType* current = header_;
   // update 数组用于存储在每一层遍历过程中，待删除节点的前驱节点。
   // 这样在删除节点时，可以方便地重新连接跳表。
-  std::vector<Node<K, V>*> update(MAX_LEVEL + 1);
+  NodeType* path[MaxLevel + 1];
+  NodeType** update = path;
+  Finger* finger = nullptr;
 
   // 1. 查找待删除节点的前驱节点
-  // 从跳表最高层开始向下查找，记录每一层中，key 的前驱节点到 update 数组。
-  for (int i = current_level_; i >= 0; --i) {
-    while (current->forward_[i] && current->forward_[i]->key_ < key) {
-      current = current->forward_[i];
+  if (finger_enabled_) {
+    finger = &thread_finger();
+    update = finger->update;
+    finger_seek(update, key);
+    current = update[0];
+  } else if constexpr (kCacheKeys) {
+    current = descend_cached(key, update);
+  } else {
+    // 从跳表最高层开始向下查找，记录每一层中，key 的前驱节点到 update 数组。
+    std::size_t hops = 0;
+    for (int i = current_level_; i >= 0; --i, ++hops) {
+      while (current->forward(i) && less(current->forward(i)->key_, key)) {
+        current = current->forward(i);
+        ++hops;
+      }
+      update[i] = current;  // update[i] 记录了在第 i 层，key 的前一个节点
     }
-    update[i] = current;  // update[i] 记录了在第 i 层，key 的前一个节点
+    record_hops(hops);
   }
 
   // 经过上述循环，current 此时指向第 0 层上 key 的前驱节点。
   // 将 current 移动到第 0 层上，
   // 可能是目标节点，也可能是比目标节点大的第一个节点。
-  current = current->forward_[0];
+  current = current->forward(0);
 
   // 2. 检查节点是否存在
   // 如果 current 为空 (表示 key 比所有节点都大) 或者 current 的 key 不匹配，
   // 则说明目标节点不存在，删除失败。
-  if (current == nullptr || current->key_ != key) {
+  if (current == nullptr || !equal(current->key_, key)) {
+    SKIPLIST_METRICS_LAP(timer, kDeleteTotal);
     return false;  // 目标节点不存在，删除失败
   }
 
@@ -203,24 +1299,71 @@ bool SkipList<K, V>::delete_element(const K& key) {
   // 则更新 update[i] 的 forward 指针，使其跳过 current。
   // 之所以从第0层开始，是为了确保所有层级的链接都被正确调整。
   for (int i = 0; i <= current_level_; ++i) {
-    // 如果这一层 update[i] 的 forward_ 指针不再指向 current，
+    // 如果这一层 update[i] 的 forward 指针不再指向 current，
     // 说明 current 节点在这一层及更高层并不存在，因此无需继续更新更高层。
-    if (update[i]->forward_[i] != current) {
+    if (update[i]->forward(i) != current) {
       break;
     }
     // 重新连接跳表节点，跳过待删除节点 current
-    update[i]->forward_[i] = current->forward_[i];
+    update[i]->set_forward(i, current->forward(i));
   }
 
   // 4. 调整跳表的当前最高层级
   // 如果删除的节点是当前最高层上唯一的节点，导致该层变空，
   // 则需要降低 current_level_，以避免不必要的最高层遍历。
-  while (current_level_ > 0 && header_->forward_[current_level_] == nullptr) {
+  while (current_level_ > 0 && header_->forward(current_level_) == nullptr) {
     --current_level_;
   }
 
   // 5. 释放内存并更新计数
-  delete current;
-  element_count_--;
+  free_node(current);
+  bump_version(finger);
+  SKIPLIST_METRICS_LAP(timer, kDeleteTotal);
   return true;
-}
\ No newline at end of file
+}
+// 扫描路径 update[i] 为第 i 层上最后一个经过且未被删除的节点，
+// 正是下一个节点在该层的前驱，删除节点只需 O(层高)，整个扫描不必回头查找
+template <typename K, typename V, typename Alloc, int MaxLevel,
+          typename Compare, double PFactor, typename SharedMutex>
+template <typename Func>
+std::size_t SkipList<K, V, Alloc, MaxLevel, Compare, PFactor,
+                     SharedMutex>::evict_cold(std::size_t target_bytes,
+                                              Func func) {
+  auto lock = write_lock();
+  NodeType* update[MaxLevel + 1];
+  for (int i = 0; i <= MaxLevel; ++i) update[i] = header_;
+  if (clock_hand_) finger_seek(update, *clock_hand_);
+  std::size_t count = 0;
+  // 第一圈清除访问位，第二圈时每个节点都可以被淘汰
+  std::size_t steps = 2 * size() + 1;
+  while (memory_usage() > target_bytes && size() > 0 && steps-- > 0) {
+    NodeType* node = update[0]->forward(0);
+    if (node == nullptr) {
+      for (int i = 0; i <= MaxLevel; ++i) update[i] = header_;
+      continue;
+    }
+    if (node->referenced_.load(std::memory_order_relaxed)) {
+      node->referenced_.store(false, std::memory_order_relaxed);
+      for (int i = 0; i <= node->node_level_; ++i) update[i] = node;
+      continue;
+    }
+    func(static_cast<const K&>(node->key_),
+         static_cast<const V&>(node->value_));
+    for (int i = 0; i <= node->node_level_; ++i) {
+      update[i]->set_forward(i, node->forward(i));
+    }
+    free_node(node);
+    ++count;
+  }
+  while (current_level_ > 0 && header_->forward(current_level_) == nullptr) {
+    --current_level_;
+  }
+  NodeType* next = update[0]->forward(0);
+  if (next != nullptr) {
+    clock_hand_ = next->key_;
+  } else {
+    clock_hand_.reset();
+  }
+  if (count > 0) bump_version(nullptr);
+  return count;
+}
@@ -0,0 +1,480 @@
+// include/Snapshot.h - 版本化的二进制快照文件
+#pragma once
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <string_view>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "AsyncIO.h"
+#include "Compression.h"
+#include "Crc32.h"
+#include "Metrics.h"
+#include "Serializer.h"
+
+// 文件布局（多字节整数均为小端）：
+//
+//   Header : magic "SKVSNAP1" (8) | version u32 | flags u32
+//   Block  : payload_size u32 | record_count u32 | crc32c(payload) u32 | payload
+//            payload 由连续的记录组成，记录 = Serializer<K> | Serializer<V>
+//            flags 含 kFlagRestartPoints 时，记录之后还有每 kRestartInterval
+//            条记录一个的 restart 偏移 u32 数组以及数组长度 u32，
+//            用于在 block 内二分查找（见 MmapSnapshot.h）
+//            flags 含 kFlagSorted 时，全部记录按 key 严格升序排列
+//            flags 含 kFlagPrefixKeys 时（仅 std::string key），记录中的 key
+//            编码为 与上一条记录共享的前缀长度 varint | 其余部分（长度前缀 +
+//            字节），每个 restart 点上共享长度为 0，可以独立解码
+//            flags 含 kFlagCompressed 时，payload 为 codec u8 | 数据：
+//            kCodecLz4 的数据是原始长度 varint 与 LZ4 block
+//            （见 Compression.h），kCodecNone（压缩后没有变小）的数据即
+//            原始负载；CRC 针对磁盘上的字节
+//   ...
+//   Filter : flags 含 kFlagFilter 时，最后一个 block 之后是过滤器：
+//            filter 字节 | filter_size u32 | crc32c(filter) u32
+//            （如分层存储有序表的 Bloom filter，见 SortedTable.h）
+//   Index  : 每个 block 的起始偏移 u64
+//   Footer : record_count u64 | block_count u64 | index_offset u64 |
+//            crc32c(index) u32 | magic "SKVSEND1" (8)
+//
+// 每个 block 以完整记录结尾，可独立校验与解码。
+// 不含前缀压缩与 block 压缩的文件写为版本 1，与旧版程序兼容；否则为版本 2
+
+// 快照的压缩方式
+enum class SnapshotCompression {
+  kNone,  // 版本 1 的原始格式
+  kKeys,  // 字符串 key 做前缀压缩
+  kLz4,   // 前缀压缩之后再以 LZ4 压缩每个 block
+};
+
+namespace snapshot {
+
+constexpr char kHeaderMagic[8] = {'S', 'K', 'V', 'S', 'N', 'A', 'P', '1'};
+constexpr char kFooterMagic[8] = {'S', 'K', 'V', 'S', 'E', 'N', 'D', '1'};
+constexpr std::uint32_t kVersion = 2;
+constexpr std::uint32_t kFlagRestartPoints = 1u << 0;
+constexpr std::uint32_t kFlagSorted = 1u << 1;
+constexpr std::uint32_t kFlagFilter = 1u << 2;
+constexpr std::uint32_t kFlagPrefixKeys = 1u << 3;
+constexpr std::uint32_t kFlagCompressed = 1u << 4;
+constexpr char kCodecNone = 0;
+constexpr char kCodecLz4 = 1;
+constexpr std::size_t kHeaderSize = 16;
+constexpr std::size_t kBlockHeaderSize = 12;
+constexpr std::size_t kFooterSize = 36;
+constexpr std::size_t kDefaultBlockSize = 64 * 1024;
+constexpr std::uint32_t kRestartInterval = 16;
+
+struct Footer {
+  std::uint64_t record_count;
+  std::uint64_t block_count;
+  std::uint64_t index_offset;
+  std::uint32_t index_crc;
+};
+
+// 解析位于文件末尾的 footer，并检查其与文件大小是否自洽
+inline bool decode_footer(const char* p, std::uint64_t file_size,
+                          Footer& footer) {
+  if (std::memcmp(p + 28, kFooterMagic, sizeof(kFooterMagic)) != 0) {
+    return false;
+  }
+  footer.record_count = serial::decode_fixed<std::uint64_t>(p);
+  footer.block_count = serial::decode_fixed<std::uint64_t>(p + 8);
+  footer.index_offset = serial::decode_fixed<std::uint64_t>(p + 16);
+  footer.index_crc = serial::decode_fixed<std::uint32_t>(p + 24);
+  return footer.block_count <= file_size / 8 &&
+         footer.index_offset + footer.block_count * 8 + kFooterSize ==
+             file_size;
+}
+
+// 返回 block 负载中记录区的长度（去掉末尾的 restart 数组）；格式错误返回 false
+inline bool records_size(const char* payload, std::size_t size,
+                         std::uint32_t flags, std::size_t& out) {
+  if ((flags & kFlagRestartPoints) == 0) {
+    out = size;
+    return true;
+  }
+  if (size < 4) return false;
+  std::uint32_t restarts =
+      serial::decode_fixed<std::uint32_t>(payload + size - 4);
+  if ((size - 4) / 4 < restarts) return false;
+  out = size - 4 - static_cast<std::size_t>(restarts) * 4;
+  return true;
+}
+
+// 能读取的文件版本
+inline bool supported_version(std::uint32_t version) {
+  return version >= 1 && version <= kVersion;
+}
+
+// 解码一条记录的 key。前缀压缩时 key 传入时须为同一 restart 区间内上一条
+// 记录的 key（或该记录本身的 key，共享的前缀相同），restart 点上可以是任意值
+template <typename K>
+bool read_key(const char*& p, const char* end, std::uint32_t flags, K& key) {
+  if constexpr (std::is_same_v<K, std::string>) {
+    if ((flags & kFlagPrefixKeys) != 0) {
+      std::uint64_t shared;
+      std::string_view rest;
+      if (!serial::get_varint(p, end, shared) || shared > key.size() ||
+          !serial::get_bytes_view(p, end, rest)) {
+        return false;
+      }
+      key.resize(static_cast<std::size_t>(shared));
+      key.append(rest);
+      return true;
+    }
+  }
+  return Serializer<K>::read(p, end, key);
+}
+
+// 以 std::string_view 解码字符串 key：未做前缀压缩时直接指向 p 处的数据；
+// 否则拼接到 last（上一条记录的 key）之后并指向 last。
+// last 为空指针时只能解码 restart 点上的记录
+inline bool read_key_view(const char*& p, const char* end,
+                          std::uint32_t flags, std::string* last,
+                          std::string_view& key) {
+  if ((flags & kFlagPrefixKeys) == 0) {
+    return serial::get_bytes_view(p, end, key);
+  }
+  std::uint64_t shared;
+  if (!serial::get_varint(p, end, shared) ||
+      !serial::get_bytes_view(p, end, key)) {
+    return false;
+  }
+  if (last == nullptr) return shared == 0;
+  if (shared > last->size()) return false;
+  last->resize(static_cast<std::size_t>(shared));
+  last->append(key);
+  key = *last;
+  return true;
+}
+
+// 解压 flags 含 kFlagCompressed 时的 block 负载，结果写入 out
+inline bool decompress_block(const char* payload, std::size_t size,
+                             std::string& out) {
+  if (size == 0) return false;
+  const char* p = payload + 1;
+  const char* end = payload + size;
+  if (payload[0] == kCodecNone) {
+    out.assign(p, end);
+    return true;
+  }
+  std::uint64_t raw_size;
+  if (payload[0] != kCodecLz4 || !serial::get_varint(p, end, raw_size) ||
+      raw_size > static_cast<std::uint64_t>(end - p) * 255 + 16) {
+    return false;  // LZ4 的压缩比不超过 255
+  }
+  out.resize(static_cast<std::size_t>(raw_size));
+  return lz4::decompress(p, static_cast<std::size_t>(end - p), out.data(),
+                         out.size());
+}
+
+// 仅检查文件头魔数，用于区分二进制快照与旧版文本文件
+inline bool is_snapshot_file(const std::string& path) {
+  std::ifstream in(path, std::ios::binary);
+  char magic[8];
+  if (!in.read(magic, sizeof(magic))) return false;
+  return std::memcmp(magic, kHeaderMagic, sizeof(magic)) == 0;
+}
+
+}  // namespace snapshot
+
+template <typename K, typename V>
+class SnapshotWriter {
+ private:
+  // 数据块攒满一个 I/O 缓冲后异步写出，编码与写盘互相重叠
+  aio::FileWriter out_;
+  bool direct_io_ = false;
+  std::size_t block_size_;
+  std::string block_;            // 当前正在累积的 block 负载
+  std::uint32_t block_records_;  // 当前 block 中的记录数
+  std::uint64_t offset_;         // 已写入的字节数
+  std::uint64_t record_count_;
+  std::vector<std::uint64_t> block_offsets_;
+  std::vector<std::uint32_t> restarts_;  // 当前 block 的 restart 偏移
+  bool sorted_ = true;                   // 目前为止是否严格升序
+  K last_key_{};
+  std::string filter_;
+  std::uint32_t format_flags_ = 0;  // kFlagPrefixKeys / kFlagCompressed
+  std::string prev_key_;            // 前缀压缩时上一条记录的 key
+  std::string compressed_;
+
+  void write_key(const K& key, bool restart) {
+    if constexpr (std::is_same_v<K, std::string>) {
+      if ((format_flags_ & snapshot::kFlagPrefixKeys) != 0) {
+        std::size_t shared = 0;
+        if (!restart) {
+          std::size_t limit = std::min(prev_key_.size(), key.size());
+          while (shared < limit && prev_key_[shared] == key[shared]) ++shared;
+        }
+        serial::put_varint(block_, shared);
+        serial::put_varint(block_, key.size() - shared);
+        block_.append(key, shared);
+        prev_key_.assign(key);
+        return;
+      }
+    }
+    (void)restart;
+    Serializer<K>::write(block_, key);
+  }
+
+  void flush_block() {
+    if (block_records_ == 0) return;
+    for (std::uint32_t off : restarts_) {
+      serial::put_fixed<std::uint32_t>(block_, off);
+    }
+    serial::put_fixed<std::uint32_t>(
+        block_, static_cast<std::uint32_t>(restarts_.size()));
+    restarts_.clear();
+    if ((format_flags_ & snapshot::kFlagCompressed) != 0) {
+      // 压缩后没有变小（如已经压缩过的数据）时原样保存
+      compressed_.assign(1, snapshot::kCodecLz4);
+      serial::put_varint(compressed_, block_.size());
+      lz4::compress(block_.data(), block_.size(), compressed_);
+      if (compressed_.size() >= block_.size() + 1) {
+        compressed_.assign(1, snapshot::kCodecNone);
+        compressed_.append(block_);
+      }
+      block_.swap(compressed_);
+    }
+    std::string header;
+    serial::put_fixed<std::uint32_t>(header,
+                                     static_cast<std::uint32_t>(block_.size()));
+    serial::put_fixed<std::uint32_t>(header, block_records_);
+    serial::put_fixed<std::uint32_t>(
+        header, crc32c::value(block_.data(), block_.size()));
+    block_offsets_.push_back(offset_);
+    out_.write(header.data(), header.size());
+    out_.write(block_.data(), block_.size());
+    offset_ += header.size() + block_.size();
+    block_.clear();
+    block_records_ = 0;
+  }
+
+ public:
+  explicit SnapshotWriter(std::size_t block_size = snapshot::kDefaultBlockSize)
+      : block_size_(block_size),
+        block_records_(0),
+        offset_(0),
+        record_count_(0) {
+    block_.reserve(block_size_ + 256);
+  }
+
+  // 在 open() 之前调用；前缀压缩只对 std::string key 生效
+  void set_compression(SnapshotCompression compression) {
+    format_flags_ = 0;
+    if (compression != SnapshotCompression::kNone &&
+        std::is_same_v<K, std::string>) {
+      format_flags_ |= snapshot::kFlagPrefixKeys;
+    }
+    if (compression == SnapshotCompression::kLz4) {
+      format_flags_ |= snapshot::kFlagCompressed;
+    }
+  }
+
+  // 在 open() 之前调用：以 O_DIRECT 写出，不经过页缓存，
+  // 写快照时不会挤掉服务读请求的热数据
+  void set_direct_io(bool direct) { direct_io_ = direct; }
+
+  bool open(const std::string& path) {
+    if (!out_.open(path, direct_io_)) return false;
+    std::string header(snapshot::kHeaderMagic, sizeof(snapshot::kHeaderMagic));
+    serial::put_fixed<std::uint32_t>(header, format_flags_ == 0
+                                                 ? 1
+                                                 : snapshot::kVersion);
+    serial::put_fixed<std::uint32_t>(
+        header, snapshot::kFlagRestartPoints | format_flags_);
+    out_.write(header.data(), header.size());
+    offset_ = header.size();
+    return out_.good();
+  }
+
+  // 记录按 key 升序追加时，快照才能支持顺序批量加载与 mmap 查询
+  void add(const K& key, const V& value) {
+    if (sorted_ && record_count_ > 0 && !(last_key_ < key)) sorted_ = false;
+    if (sorted_) last_key_ = key;
+    bool restart = block_records_ % snapshot::kRestartInterval == 0;
+    if (restart) {
+      restarts_.push_back(static_cast<std::uint32_t>(block_.size()));
+    }
+    write_key(key, restart);
+    Serializer<V>::write(block_, value);
+    ++block_records_;
+    ++record_count_;
+    if (block_.size() >= block_size_) flush_block();
+  }
+
+  // 在最后一个 block 与索引之间附加过滤器，finish() 之前调用
+  void set_filter(std::string filter) { filter_ = std::move(filter); }
+
+  // 写出最后一个 block、索引与文件尾；任何 I/O 错误都返回 false
+  bool finish() {
+    flush_block();
+    const std::uint32_t initial_flags =
+        snapshot::kFlagRestartPoints | format_flags_;
+    std::uint32_t flags = initial_flags;
+    if (!filter_.empty()) {
+      std::string trailer;
+      serial::put_fixed<std::uint32_t>(
+          trailer, static_cast<std::uint32_t>(filter_.size()));
+      serial::put_fixed<std::uint32_t>(
+          trailer, crc32c::value(filter_.data(), filter_.size()));
+      out_.write(filter_.data(), filter_.size());
+      out_.write(trailer.data(), trailer.size());
+      offset_ += filter_.size() + trailer.size();
+      flags |= snapshot::kFlagFilter;
+    }
+    std::string index;
+    for (std::uint64_t off : block_offsets_) {
+      serial::put_fixed<std::uint64_t>(index, off);
+    }
+    std::string footer;
+    serial::put_fixed<std::uint64_t>(footer, record_count_);
+    serial::put_fixed<std::uint64_t>(footer, block_offsets_.size());
+    serial::put_fixed<std::uint64_t>(footer, offset_);
+    serial::put_fixed<std::uint32_t>(footer,
+                                     crc32c::value(index.data(), index.size()));
+    footer.append(snapshot::kFooterMagic, sizeof(snapshot::kFooterMagic));
+    out_.write(index.data(), index.size());
+    out_.write(footer.data(), footer.size());
+    if (sorted_) flags |= snapshot::kFlagSorted;
+    if (flags != initial_flags) {
+      // 写完才知道是否整体有序，回填文件头中的 flags
+      std::string header_flags;
+      serial::put_fixed<std::uint32_t>(header_flags, flags);
+      out_.patch(12, std::move(header_flags));
+    }
+    return out_.close();
+  }
+
+  std::uint64_t record_count() const { return record_count_; }
+};
+
+template <typename K, typename V>
+class SnapshotReader {
+ private:
+  std::ifstream in_;
+  std::uint32_t flags_ = 0;
+  std::uint64_t record_count_ = 0;
+  std::vector<std::uint64_t> block_offsets_;
+  std::uint64_t index_offset_ = 0;
+  std::string raw_;  // 解压用的缓冲区
+
+ public:
+  // 校验文件头、文件尾与索引；失败返回 false
+  bool open(const std::string& path) {
+    in_.open(path, std::ios::binary);
+    if (!in_.is_open()) return false;
+
+    char header[snapshot::kHeaderSize];
+    if (!in_.read(header, sizeof(header))) return false;
+    if (std::memcmp(header, snapshot::kHeaderMagic, 8) != 0) return false;
+    if (!snapshot::supported_version(
+            serial::decode_fixed<std::uint32_t>(header + 8))) {
+      return false;
+    }
+    flags_ = serial::decode_fixed<std::uint32_t>(header + 12);
+    if ((flags_ & snapshot::kFlagPrefixKeys) != 0 &&
+        !std::is_same_v<K, std::string>) {
+      return false;
+    }
+
+    in_.seekg(0, std::ios::end);
+    std::uint64_t file_size = static_cast<std::uint64_t>(in_.tellg());
+    if (file_size < snapshot::kHeaderSize + snapshot::kFooterSize) return false;
+    char buf[snapshot::kFooterSize];
+    in_.seekg(file_size - snapshot::kFooterSize);
+    if (!in_.read(buf, sizeof(buf))) return false;
+    snapshot::Footer footer;
+    if (!snapshot::decode_footer(buf, file_size, footer)) return false;
+    record_count_ = footer.record_count;
+    index_offset_ = footer.index_offset;
+
+    std::string index(footer.block_count * 8, '\0');
+    in_.seekg(index_offset_);
+    if (!in_.read(index.data(), index.size())) return false;
+    if (crc32c::value(index.data(), index.size()) != footer.index_crc) {
+      return false;
+    }
+    block_offsets_.resize(footer.block_count);
+    for (std::uint64_t i = 0; i < footer.block_count; ++i) {
+      block_offsets_[i] = serial::decode_fixed<std::uint64_t>(&index[i * 8]);
+    }
+    return true;
+  }
+
+  std::uint64_t record_count() const { return record_count_; }
+  std::size_t block_count() const { return block_offsets_.size(); }
+
+  // 读取第 i 个 block 的负载，校验 CRC 后解压
+  bool read_block(std::size_t i, std::string& payload,
+                  std::uint32_t& records) {
+    SKIPLIST_METRICS_TIMER(timer);
+    char header[snapshot::kBlockHeaderSize];
+    in_.seekg(block_offsets_[i]);
+    if (!in_.read(header, sizeof(header))) return false;
+    std::uint32_t size = serial::decode_fixed<std::uint32_t>(header);
+    records = serial::decode_fixed<std::uint32_t>(header + 4);
+    std::uint32_t crc = serial::decode_fixed<std::uint32_t>(header + 8);
+    if (block_offsets_[i] + sizeof(header) + size > index_offset_) return false;
+    payload.resize(size);
+    if (!in_.read(payload.data(), size)) return false;
+    if (crc32c::value(payload.data(), payload.size()) != crc) return false;
+    if ((flags_ & snapshot::kFlagCompressed) != 0) {
+      if (!snapshot::decompress_block(payload.data(), payload.size(),
+                                      raw_)) {
+        return false;
+      }
+      payload.swap(raw_);
+    }
+    SKIPLIST_METRICS_LAP(timer, kLoadRead);
+    return true;
+  }
+
+  // 解码一个 block 中的所有记录，对每条记录调用 func(K&, V&)
+  template <typename Func>
+  bool decode_block(const std::string& payload, std::uint32_t records,
+                    Func&& func) const {
+    SKIPLIST_METRICS_TIMER(timer);
+    std::size_t size;
+    if (!snapshot::records_size(payload.data(), payload.size(), flags_,
+                                size)) {
+      return false;
+    }
+    const char* p = payload.data();
+    const char* end = p + size;
+    K key{};
+    V value{};
+    // 前缀压缩时解码依赖上一条记录的 key，func 可能移走 key，另存一份
+    const bool prefix = (flags_ & snapshot::kFlagPrefixKeys) != 0;
+    K last{};
+    for (std::uint32_t n = 0; n < records; ++n) {
+      if (prefix) {
+        if (!snapshot::read_key(p, end, flags_, last)) return false;
+        key = last;
+      } else if (!Serializer<K>::read(p, end, key)) {
+        return false;
+      }
+      if (!Serializer<V>::read(p, end, value)) return false;
+      func(key, value);
+    }
+    SKIPLIST_METRICS_LAP(timer, kLoadDecode);
+    return p == end;
+  }
+
+  // 按文件顺序遍历全部记录；遇到损坏的 block 立即停止并返回 false
+  template <typename Func>
+  bool for_each(Func&& func) {
+    std::string payload;
+    std::uint32_t records = 0;
+    for (std::size_t i = 0; i < block_offsets_.size(); ++i) {
+      if (!read_block(i, payload, records)) return false;
+      if (!decode_block(payload, records, func)) return false;
+    }
+    return true;
+  }
+};
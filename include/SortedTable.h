@@ -0,0 +1,193 @@
+// include/SortedTable.h - 分层存储（LSM）中落盘的有序表与清单文件
+#pragma once
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <fstream>
+#include <optional>
+#include <string>
+#include <system_error>
+#include <utility>
+#include <vector>
+
+#include "AsyncIO.h"
+#include "BloomFilter.h"
+#include "MmapSnapshot.h"
+#include "Snapshot.h"
+
+// 有序表沿用快照文件格式（见 Snapshot.h），value 为 std::optional<V>，
+// std::nullopt 表示删除标记，用于遮蔽更旧的表中的同一 key：
+// - 记录按 key 严格升序，block 的首 key 与 restart 点即稀疏索引；
+// - 最后一个 block 之后附加全部 key 的 Bloom filter，
+//   不含该 key 的表无需访问任何 block；
+// - 文件写完后不再修改，打开时映射进内存，可被多个线程并发查询。
+template <typename K, typename V>
+class SortedTable {
+ public:
+  using Record = std::optional<V>;
+  using Cursor = typename MmapSnapshot<K, Record>::Cursor;
+
+  enum class Lookup {
+    kFound,    // 表中有该 key 的值
+    kDeleted,  // 表中有该 key 的删除标记
+    kMissing,  // 表中没有该 key，需要继续查更旧的表
+  };
+
+  SortedTable() = default;
+  SortedTable(const SortedTable&) = delete;
+  SortedTable& operator=(const SortedTable&) = delete;
+
+  bool open(const std::string& path, std::uint64_t id) {
+    path_ = path;
+    id_ = id;
+    return snapshot_.open(path);
+  }
+
+  std::uint64_t id() const { return id_; }
+  const std::string& path() const { return path_; }
+  std::uint64_t record_count() const { return snapshot_.record_count(); }
+  std::size_t file_size() const { return snapshot_.file_size(); }
+
+  // hash 为 bloom::hash_key(key)，查多张表时只需计算一次
+  bool may_contain(std::uint64_t hash) const {
+    return BloomFilter::may_contain(snapshot_.filter(), hash);
+  }
+
+  // Q 为 K 或能与 K 比较的类型（如 std::string_view）
+  template <typename Q>
+  Lookup get(const Q& key, std::uint64_t hash, V& value) const {
+    if (!may_contain(hash)) return Lookup::kMissing;
+    Record record;
+    if (!snapshot_.get(key, record)) return Lookup::kMissing;
+    if (!record) return Lookup::kDeleted;
+    value = std::move(*record);
+    return Lookup::kFound;
+  }
+
+  // 按 key 升序遍历，value() 为 std::nullopt 的记录是删除标记
+  Cursor begin() const { return snapshot_.begin(); }
+  Cursor seek(const K& key) const { return snapshot_.seek(key); }
+
+ private:
+  MmapSnapshot<K, Record> snapshot_;
+  std::string path_;
+  std::uint64_t id_ = 0;
+};
+
+// 按 key 严格升序写出有序表，finish() 时根据写入的 key 生成 Bloom filter。
+// 有序表只做 key 的前缀压缩，不压缩 block：点查询直接读取映射内存，
+// 不必为每张表保留解压后的 block
+template <typename K, typename V>
+class SortedTableWriter {
+ public:
+  bool open(const std::string& path, bool prefix_keys = false) {
+    if (prefix_keys) writer_.set_compression(SnapshotCompression::kKeys);
+    return writer_.open(path);
+  }
+
+  // 在 open() 之前调用，见 SnapshotWriter::set_direct_io
+  void set_direct_io(bool direct) { writer_.set_direct_io(direct); }
+
+  // value 为 nullptr 时写入删除标记
+  void add(const K& key, const V* value) {
+    hashes_.push_back(bloom::hash_key(key));
+    writer_.add(key, value ? std::optional<V>(*value) : std::nullopt);
+  }
+
+  bool finish(int bloom_bits_per_key) {
+    BloomFilter filter(hashes_.size(), bloom_bits_per_key);
+    for (std::uint64_t h : hashes_) filter.add_hash(h);
+    writer_.set_filter(filter.serialize());
+    return writer_.finish();
+  }
+
+  std::uint64_t record_count() const { return writer_.record_count(); }
+
+ private:
+  SnapshotWriter<K, std::optional<V>> writer_;
+  std::vector<std::uint64_t> hashes_;
+};
+
+namespace sorted_table {
+
+// 清单：当前有效的有序表编号，从旧到新排列。
+// 有序表与清单都先写完并同步，再通过 rename 原子替换，
+// 不在清单中的 .sst 文件是崩溃时未提交的残留，启动时删除
+struct Manifest {
+  std::uint64_t next_id = 1;
+  std::vector<std::uint64_t> tables;
+};
+
+inline std::string table_path(const std::string& base, std::uint64_t id) {
+  return base + "." + std::to_string(id) + ".sst";
+}
+
+inline std::string manifest_path(const std::string& base) {
+  return base + ".manifest";
+}
+
+// 文本格式："SKVMANIFEST1 <next_id> <表数>"，其后每行一个编号
+inline bool read_manifest(const std::string& path, Manifest& manifest) {
+  std::ifstream in(path);
+  if (!in.is_open()) return false;
+  std::string magic;
+  std::size_t count = 0;
+  if (!(in >> magic >> manifest.next_id >> count) || magic != "SKVMANIFEST1") {
+    return false;
+  }
+  manifest.tables.clear();
+  for (std::size_t i = 0; i < count; ++i) {
+    std::uint64_t id;
+    if (!(in >> id) || id >= manifest.next_id) return false;
+    manifest.tables.push_back(id);
+  }
+  return true;
+}
+
+inline bool write_manifest(const std::string& path, const Manifest& manifest) {
+  const std::string tmp_path = path + ".tmp";
+  {
+    std::ofstream out(tmp_path, std::ios::trunc);
+    if (!out.is_open()) return false;
+    out << "SKVMANIFEST1 " << manifest.next_id << " "
+        << manifest.tables.size() << "\n";
+    for (std::uint64_t id : manifest.tables) out << id << "\n";
+    out.close();
+    if (out.fail()) return false;
+  }
+  // 提交之后调用方会删除被替换的表与旧日志，清单及其目录项必须先落盘；
+  // 同步目录也使此前写出的新表的目录项落盘（表的数据在写完时已同步）
+  if (!aio::sync_path(tmp_path)) return false;
+  std::error_code ec;
+  std::filesystem::rename(tmp_path, path, ec);
+  return !ec && aio::sync_parent_directory(path);
+}
+
+// 删除 base 所在目录中不属于 manifest 的 <base>.<id>.sst 文件
+inline void remove_orphans(const std::string& base, const Manifest& manifest) {
+  std::filesystem::path base_path(base);
+  std::filesystem::path dir = base_path.parent_path();
+  if (dir.empty()) dir = ".";
+  const std::string prefix = base_path.filename().string() + ".";
+  std::error_code ec;
+  for (const auto& entry : std::filesystem::directory_iterator(dir, ec)) {
+    std::string name = entry.path().filename().string();
+    if (name.size() <= prefix.size() + 4 ||
+        name.compare(0, prefix.size(), prefix) != 0 ||
+        name.compare(name.size() - 4, 4, ".sst") != 0) {
+      continue;
+    }
+    std::string digits =
+        name.substr(prefix.size(), name.size() - prefix.size() - 4);
+    if (digits.size() > 19 ||
+        digits.find_first_not_of("0123456789") != std::string::npos) {
+      continue;
+    }
+    std::uint64_t id = std::stoull(digits);
+    bool live = false;
+    for (std::uint64_t table : manifest.tables) live = live || table == id;
+    if (!live) std::filesystem::remove(entry.path(), ec);
+  }
+}
+
+}  // namespace sorted_table
@@ -0,0 +1,630 @@
+// include/WriteAheadLog.h - KVStore 写操作的预写日志 (WAL)
+#pragma once
+#include <cerrno>
+#include <chrono>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <iterator>
+#include <limits>
+#include <mutex>
+#include <random>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#if !defined(_WIN32)
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+#include "AsyncIO.h"
+#include "Crc32.h"
+#include "Metrics.h"
+#include "Serializer.h"
+
+// 日志文件只追加，由连续的记录组成（多字节整数均为小端）：
+//
+//   Record : body_size u32 | crc32c(body) u32 | body
+//   body   : type u8 | Serializer<K> | Serializer<V>（仅 kPut / kPutTtl 携带
+//            value）| expire_at i64（仅 kPutTtl，过期时间的毫秒时间戳）
+//
+// 崩溃时文件末尾可能残留半条记录，回放在第一条不完整或校验失败的记录处停止，
+// 重新打开时截掉这段无效的尾部。
+// 主从复制时副本收到的也是同样编码的记录（见 Replication.h）。
+
+// 日志的同步策略
+enum class WalMode {
+  kOff,       // 不写日志，只在 dump() 时持久化（默认）
+  kNoSync,    // 每次写入都交给内核缓冲区：进程崩溃不丢数据，掉电可能丢失
+  kSync,      // 写入返回前已 fdatasync；并发的写入者合并为一次同步
+  kPeriodic,  // 写入只进入内存缓冲，后台线程每隔 sync_interval 写出并同步
+  kAsync,     // 写入只进入内存缓冲后立即返回，由异步 I/O 引擎写出并同步；
+              // 上一批落盘期间追加的记录合并为下一批，
+              // 需要确认持久化时使用 commit_async
+};
+
+namespace wal {
+
+enum RecordType : std::uint8_t {
+  kPut = 1,
+  kDelete = 2,
+  kClear = 3,
+  kPutTtl = 4,  // 带过期时间的 kPut
+};
+
+constexpr std::size_t kRecordHeaderSize = 8;
+
+template <typename K, typename V>
+inline void encode(std::string& out, RecordType type, const K* key,
+                   const V* value, const std::int64_t* expire_at = nullptr) {
+  std::size_t start = out.size();
+  out.append(kRecordHeaderSize, '\0');
+  out.push_back(static_cast<char>(type));
+  if (key != nullptr) Serializer<K>::write(out, *key);
+  if (value != nullptr) Serializer<V>::write(out, *value);
+  if (expire_at != nullptr) serial::put_fixed(out, *expire_at);
+  std::string header;
+  serial::put_fixed<std::uint32_t>(
+      header, static_cast<std::uint32_t>(out.size() - start - 8));
+  serial::put_fixed<std::uint32_t>(
+      header, crc32c::value(out.data() + start + 8, out.size() - start - 8));
+  out.replace(start, kRecordHeaderSize, header);
+}
+
+// 按顺序解码 [p, end) 中的记录，对每条记录调用
+// func(RecordType, K&, V&, std::int64_t expire_at)（kClear 的 key / value
+// 无意义，expire_at 只对 kPutTtl 有意义）；
+// 返回第一条不完整或校验失败的记录的位置，全部有效时为 end
+template <typename K, typename V, typename Func>
+inline const char* decode_all(const char* p, const char* end, Func&& func) {
+  K key{};
+  V value{};
+  std::int64_t expire_at = 0;
+  while (static_cast<std::size_t>(end - p) >= kRecordHeaderSize) {
+    std::uint32_t size = serial::decode_fixed<std::uint32_t>(p);
+    std::uint32_t crc = serial::decode_fixed<std::uint32_t>(p + 4);
+    const char* body = p + kRecordHeaderSize;
+    if (size == 0 || static_cast<std::size_t>(end - body) < size) break;
+    if (crc32c::value(body, size) != crc) break;
+    const char* q = body + 1;
+    const char* body_end = body + size;
+    RecordType type = static_cast<RecordType>(*body);
+    bool ok = false;
+    if (type == kPut) {
+      ok = Serializer<K>::read(q, body_end, key) &&
+           Serializer<V>::read(q, body_end, value);
+    } else if (type == kPutTtl) {
+      ok = Serializer<K>::read(q, body_end, key) &&
+           Serializer<V>::read(q, body_end, value) &&
+           serial::get_fixed(q, body_end, expire_at);
+    } else if (type == kDelete) {
+      ok = Serializer<K>::read(q, body_end, key);
+    } else if (type == kClear) {
+      ok = true;
+    }
+    if (!ok || q != body_end) break;
+    func(type, key, value, expire_at);
+    p = body_end;
+  }
+  return p;
+}
+
+// 跳过 [p, end) 开头的 n 条记录，返回其后的位置（只读长度，不校验）
+inline const char* skip(const char* p, const char* end, std::uint64_t n) {
+  for (; n > 0 && static_cast<std::size_t>(end - p) >= kRecordHeaderSize;
+       --n) {
+    std::uint32_t size = serial::decode_fixed<std::uint32_t>(p);
+    if (static_cast<std::size_t>(end - p) - kRecordHeaderSize < size) {
+      return end;
+    }
+    p += kRecordHeaderSize + size;
+  }
+  return p;
+}
+
+// 按顺序回放 path 中的记录（func 同 decode_all）；
+// valid_size 返回有效记录的总长度，文件不存在时为 0
+template <typename K, typename V, typename Func>
+inline void replay(const std::string& path, Func&& func,
+                   std::uint64_t& valid_size) {
+  valid_size = 0;
+  std::ifstream in(path, std::ios::binary);
+  if (!in.is_open()) return;
+  std::string data((std::istreambuf_iterator<char>(in)),
+                   std::istreambuf_iterator<char>());
+  const char* end = data.data() + data.size();
+  const char* p = decode_all<K, V>(data.data(), end, func);
+  valid_size = static_cast<std::uint64_t>(p - data.data());
+  if (p != end) {
+    std::cerr << "WAL has a torn or corrupted tail, ignored "
+              << static_cast<std::size_t>(end - p) << " bytes: " << path
+              << std::endl;
+  }
+}
+
+}  // namespace wal
+
+// 追加写日志。append() 只把记录编号并放入内存缓冲，调用方在持有
+// 保证顺序的锁时调用；commit() 在锁外按同步策略等待记录落盘：
+// 多个线程同时 commit 时由其中一个线程写出整批缓冲并同步一次 (group commit)，
+// 其余线程只需等待。commit_async() 不阻塞：写出与同步交给 aio::Engine，
+// 完成后在引擎线程中回调。
+// 开启复制积压（set_backlog）时，最近写出的记录按批次留在内存中，
+// 供副本用 read_since 按编号增量读取。
+template <typename K, typename V>
+class WriteAheadLog {
+ private:
+  int fd_ = -1;
+  std::string path_;
+  WalMode mode_ = WalMode::kOff;
+  std::chrono::milliseconds interval_{0};
+
+  std::mutex mutex_;
+  std::condition_variable cv_;
+  std::string pending_;         // 已编号但尚未写入文件的记录
+  std::uint64_t appended_ = 0;  // 最后一条记录的编号
+  std::uint64_t written_ = 0;   // 已按策略写出（并同步）的最后编号
+  bool flushing_ = false;       // 是否有线程正在写文件
+  bool failed_ = false;         // 发生过 I/O 错误
+  bool stop_ = false;
+  std::thread syncer_;  // kPeriodic 的后台同步线程
+  // commit_async 的等待者（编号, 回调），按编号升序
+  std::deque<std::pair<std::uint64_t, std::function<void(bool)>>> waiters_;
+  std::string in_flight_;  // 正在异步写出的一批记录
+
+  // 复制积压中的一批记录：编号 [first, last]，按写出顺序排列
+  struct Batch {
+    std::uint64_t first;
+    std::uint64_t last;
+    std::string data;
+  };
+  // 编号只在同一个实例内连续，副本凭 id_ 判断能否从断开处继续
+  std::uint64_t id_ = make_id();
+  std::size_t backlog_limit_ = 0;  // 为 0 时不保留
+  std::size_t backlog_bytes_ = 0;
+  std::deque<Batch> backlog_;
+
+  static std::uint64_t make_id() {
+    std::random_device rd;
+    std::uint64_t id = static_cast<std::uint64_t>(rd()) << 32 | rd();
+    return id != 0 ? id : 1;
+  }
+
+  // 持锁调用：编号 [first, last] 的记录已写出，放入复制积压，
+  // 超出上限时从最旧的批次开始丢弃（至少保留最新的一批）
+  void keep_backlog(std::uint64_t first, std::uint64_t last,
+                    std::string&& data) {
+    if (backlog_limit_ == 0 || data.empty()) return;
+    backlog_bytes_ += data.size();
+    backlog_.push_back({first, last, std::move(data)});
+    while (backlog_bytes_ > backlog_limit_ && backlog_.size() > 1) {
+      backlog_bytes_ -= backlog_.front().data.size();
+      backlog_.pop_front();
+    }
+  }
+
+  bool write_all(const std::string& data) {
+#if defined(_WIN32)
+    (void)data;
+    return false;
+#else
+    const char* p = data.data();
+    std::size_t left = data.size();
+    while (left > 0) {
+      ssize_t n = ::write(fd_, p, left);
+      if (n < 0) {
+        if (errno == EINTR) continue;
+        return false;
+      }
+      p += n;
+      left -= static_cast<std::size_t>(n);
+    }
+    return true;
+#endif
+  }
+
+  bool sync_file() {
+#if defined(_WIN32)
+    return false;
+#elif defined(__APPLE__)
+    return ::fsync(fd_) == 0;
+#else
+    return ::fdatasync(fd_) == 0;
+#endif
+  }
+
+  // 持锁调用：直到编号 seq 之前的记录都已写出；
+  // 写文件期间释放锁，其他线程可以继续追加下一批
+  bool flush_until(std::unique_lock<std::mutex>& lock, std::uint64_t seq,
+                   bool sync) {
+    while (written_ < seq) {
+      if (failed_) return false;
+      if (flushing_) {
+        cv_.wait(lock);
+        continue;
+      }
+      std::string batch;
+      batch.swap(pending_);
+      std::uint64_t last = appended_;
+      flushing_ = true;
+      lock.unlock();
+      SKIPLIST_METRICS_TIMER(timer);
+      bool ok = write_all(batch);
+      SKIPLIST_METRICS_LAP(timer, kWalWrite);
+      if (ok && sync) {
+        ok = sync_file();
+        SKIPLIST_METRICS_LAP(timer, kWalSync);
+      }
+      lock.lock();
+      flushing_ = false;
+      if (ok) {
+        keep_backlog(written_ + 1, last, std::move(batch));
+        written_ = last;
+      } else {
+        failed_ = true;
+        std::cerr << "Error writing WAL: " << path_ << std::endl;
+      }
+      cv_.notify_all();
+      if (!waiters_.empty()) {
+        // 这次写出已经同步（kNoSync 只需写出）时直接完成已满足的异步等待者，
+        // 出错时取出全部等待者；其余的交给一次异步写出与同步确认。
+        // 回调在锁外进行
+        std::vector<std::pair<std::function<void(bool)>, bool>> ready;
+        if (failed_ || sync || mode_ == WalMode::kNoSync) {
+          finish_async(written_, !failed_, ready);
+        }
+        if (!failed_ && !waiters_.empty()) flush_async();
+        if (!ready.empty()) {
+          lock.unlock();
+          for (auto& [done, result] : ready) done(result);
+          lock.lock();
+        }
+      }
+    }
+    return true;
+  }
+
+  // 持锁调用：等待进行中的写出（包括交给异步引擎的）完成。
+  // 关闭、替换或截断文件之前调用，否则引擎的回调会用到已关闭的 fd_
+  // 或已销毁的 this；调用方需保证期间没有新的 append()
+  void wait_idle(std::unique_lock<std::mutex>& lock) {
+    cv_.wait(lock, [this] { return !flushing_; });
+  }
+
+  // 持锁调用：把缓冲的记录交给异步引擎写出（kNoSync 之外再同步一次），
+  // 完成后在引擎线程中更新 written_ 并回调满足条件的等待者
+  void flush_async() {
+    in_flight_.swap(pending_);
+    pending_.clear();
+    const std::uint64_t last = appended_;
+    const bool sync = mode_ != WalMode::kNoSync;
+    flushing_ = true;
+    aio::Engine::shared().submit(
+        {aio::Op::kWrite, fd_, in_flight_.data(), in_flight_.size(), -1,
+         [this, last, sync](long result) {
+           bool ok = result == static_cast<long>(in_flight_.size());
+           if (!ok || !sync) {
+             complete_async(last, ok);
+             return;
+           }
+           aio::Engine::shared().submit(
+               {aio::Op::kSync, fd_, nullptr, 0, -1, [this, last](long r) {
+                  complete_async(last, r == 0);
+                }});
+         }});
+  }
+
+  // 异步写出完成；kAsync 下落盘期间追加的记录紧接着写出
+  void complete_async(std::uint64_t last, bool ok) {
+    std::vector<std::pair<std::function<void(bool)>, bool>> ready;
+    {
+      std::lock_guard<std::mutex> guard(mutex_);
+      flushing_ = false;
+      if (ok) keep_backlog(written_ + 1, last, std::move(in_flight_));
+      in_flight_.clear();
+      finish_async(last, ok, ready);
+      if (!failed_ && written_ < appended_ &&
+          (mode_ == WalMode::kAsync || !waiters_.empty())) {
+        flush_async();
+      }
+      cv_.notify_all();
+    }
+    for (auto& [done, result] : ready) done(result);
+  }
+
+  // 持锁调用：更新写出进度，取出满足条件的等待者放入 ready，
+  // 由调用方在锁外回调；出错时取出全部等待者，结果为 false
+  void finish_async(
+      std::uint64_t last, bool ok,
+      std::vector<std::pair<std::function<void(bool)>, bool>>& ready) {
+    if (ok) {
+      written_ = std::max(written_, last);
+    } else if (!failed_) {
+      failed_ = true;
+      std::cerr << "Error writing WAL: " << path_ << std::endl;
+    }
+    while (!waiters_.empty() &&
+           (failed_ || waiters_.front().first <= written_)) {
+      ready.emplace_back(std::move(waiters_.front().second), !failed_);
+      waiters_.pop_front();
+    }
+  }
+
+  void sync_loop() {
+    std::unique_lock<std::mutex> lock(mutex_);
+    while (!stop_) {
+      cv_.wait_for(lock, interval_, [this] { return stop_; });
+      flush_until(lock, appended_, true);
+    }
+  }
+
+  // 把 from 的全部内容追加到 to 的末尾并同步 to；任何一步失败都返回 false
+  static bool append_file(const std::string& from, const std::string& to) {
+#if defined(_WIN32)
+    (void)from;
+    (void)to;
+    return false;
+#else
+    int in = ::open(from.c_str(), O_RDONLY);
+    if (in < 0) return false;
+    int out = ::open(to.c_str(), O_WRONLY | O_APPEND);
+    bool ok = out >= 0;
+    std::vector<char> buffer(1 << 16);
+    while (ok) {
+      ssize_t n = ::read(in, buffer.data(), buffer.size());
+      if (n < 0 && errno == EINTR) continue;
+      if (n <= 0) {
+        ok = n == 0;
+        break;
+      }
+      for (ssize_t done = 0; ok && done < n;) {
+        ssize_t w = ::write(out, buffer.data() + done, n - done);
+        if (w < 0 && errno == EINTR) continue;
+        ok = w > 0;
+        done += w;
+      }
+    }
+#if defined(__APPLE__)
+    if (ok) ok = ::fsync(out) == 0;
+#else
+    if (ok) ok = ::fdatasync(out) == 0;
+#endif
+    if (out >= 0 && ::close(out) != 0) ok = false;
+    ::close(in);
+    return ok;
+#endif
+  }
+
+  // valid_size 之后的内容被截掉；传入最大值表示保留原文件
+  bool open_file(std::uint64_t valid_size) {
+#if defined(_WIN32)
+    (void)valid_size;
+    return false;  // 暂不支持 Windows
+#else
+    fd_ = ::open(path_.c_str(), O_WRONLY | O_CREAT | O_APPEND, 0644);
+    if (fd_ < 0) return false;
+    // 截掉回放时被忽略的无效尾部，保证新记录紧跟在有效记录之后
+    struct stat st;
+    if (::fstat(fd_, &st) == 0 &&
+        static_cast<std::uint64_t>(st.st_size) > valid_size &&
+        ::ftruncate(fd_, static_cast<off_t>(valid_size)) != 0) {
+      ::close(fd_);
+      fd_ = -1;
+      return false;
+    }
+    return true;
+#endif
+  }
+
+  void close_file() {
+#if !defined(_WIN32)
+    if (fd_ >= 0) ::close(fd_);
+#endif
+    fd_ = -1;
+  }
+
+ public:
+  WriteAheadLog() = default;
+  ~WriteAheadLog() { close(); }
+
+  WriteAheadLog(const WriteAheadLog&) = delete;
+  WriteAheadLog& operator=(const WriteAheadLog&) = delete;
+
+  // 打开（或创建）日志文件并截断到 valid_size（回放得到的有效长度）
+  bool open(const std::string& path, WalMode mode,
+            std::chrono::milliseconds interval, std::uint64_t valid_size) {
+    close();
+    path_ = path;
+    mode_ = mode;
+    interval_ = interval;
+    failed_ = false;
+    stop_ = false;
+    if (!open_file(valid_size)) return false;
+    if (mode_ == WalMode::kPeriodic) {
+      syncer_ = std::thread([this] { sync_loop(); });
+    }
+    return true;
+  }
+
+  bool is_open() const { return fd_ >= 0; }
+
+  // 写出并同步全部缓冲的记录后关闭文件
+  void close() {
+    if (fd_ < 0) return;
+    {
+      std::lock_guard<std::mutex> guard(mutex_);
+      stop_ = true;
+    }
+    cv_.notify_all();
+    if (syncer_.joinable()) syncer_.join();
+    sync();
+    std::unique_lock<std::mutex> lock(mutex_);
+    wait_idle(lock);
+    close_file();
+  }
+
+  // 追加一条记录到内存缓冲，返回其编号；value / expire_at 为 nullptr 时
+  // 不写入该字段
+  std::uint64_t append(wal::RecordType type, const K* key, const V* value,
+                       const std::int64_t* expire_at = nullptr) {
+    std::string record;
+    wal::encode<K, V>(record, type, key, value, expire_at);
+    std::lock_guard<std::mutex> guard(mutex_);
+    pending_.append(record);
+    return ++appended_;
+  }
+
+  // 追加一批已由 wal::encode 编码的 count 条记录，返回最后一条的编号
+  std::uint64_t append_encoded(const std::string& records, std::size_t count) {
+    std::lock_guard<std::mutex> guard(mutex_);
+    pending_.append(records);
+    appended_ += count;
+    return appended_;
+  }
+
+  // 按同步策略等待编号 seq 及之前的记录持久化；I/O 出错时返回 false。
+  // kAsync 时不等待，只在没有写出在进行时启动一次异步写出
+  bool commit(std::uint64_t seq) {
+    if (mode_ == WalMode::kPeriodic) return true;
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (mode_ == WalMode::kAsync) {
+      if (!flushing_ && !failed_ && written_ < seq) flush_async();
+      return !failed_;
+    }
+    return flush_until(lock, seq, mode_ == WalMode::kSync);
+  }
+
+  // commit 的非阻塞版本：编号 seq 及之前的记录写出（kNoSync）或同步
+  // （kSync / kAsync）后调用 done(true)，出错时调用 done(false)。
+  // 已经满足时在当前线程中立即调用，否则在 I/O 引擎的线程中调用，
+  // done 中不能调用阻塞的 commit / sync。kPeriodic 与 commit 一致，立即返回
+  void commit_async(std::uint64_t seq, std::function<void(bool)> done) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (mode_ == WalMode::kPeriodic || failed_ || written_ >= seq) {
+      bool ok = !failed_;
+      lock.unlock();
+      done(ok);
+      return;
+    }
+    waiters_.emplace_back(seq, std::move(done));
+    if (!flushing_) flush_async();
+  }
+
+  // 最后一条已追加记录的编号
+  std::uint64_t last_seq() {
+    std::lock_guard<std::mutex> guard(mutex_);
+    return appended_;
+  }
+
+  // ---------- 复制 ----------
+
+  // 本实例的复制标识
+  std::uint64_t id() {
+    std::lock_guard<std::mutex> guard(mutex_);
+    return id_;
+  }
+
+  // 复制积压保留最近写出的至多约 bytes 字节记录，为 0 时关闭
+  void set_backlog(std::size_t bytes) {
+    std::lock_guard<std::mutex> guard(mutex_);
+    backlog_limit_ = bytes;
+    while (!backlog_.empty() && (bytes == 0 || backlog_bytes_ > bytes)) {
+      backlog_bytes_ -= backlog_.front().data.size();
+      backlog_.pop_front();
+    }
+  }
+
+  // 把编号大于 after 的已写出记录追加到 out，达到 max_bytes 后不再取下一批；
+  // last 为取到的最后一条的编号（没有取到时为 after）。没有新记录时至多等待
+  // timeout。after 之后的记录已移出积压、after 超过已写出的编号或
+  // 日志出错时返回 false，副本需要全量同步
+  bool read_since(std::uint64_t after, std::string& out, std::uint64_t& last,
+                  std::size_t max_bytes, std::chrono::milliseconds timeout) {
+    std::unique_lock<std::mutex> lock(mutex_);
+    last = after;
+    if (failed_ || after > written_) return false;
+    if (after == written_) {
+      cv_.wait_for(lock, timeout,
+                   [&] { return written_ > after || failed_ || stop_; });
+      if (failed_) return false;
+      if (written_ == after) return true;
+    }
+    if (backlog_.empty() || backlog_.front().first > after + 1) return false;
+    for (const Batch& batch : backlog_) {
+      if (batch.last <= after) continue;
+      const char* p = batch.data.data();
+      const char* end = p + batch.data.size();
+      if (batch.first <= after) p = wal::skip(p, end, after + 1 - batch.first);
+      out.append(p, end);
+      last = batch.last;
+      if (out.size() >= max_bytes) break;
+    }
+    return true;
+  }
+
+  // 丢弃全部记录并清空文件，编号继续递增；复制标识随之改变，
+  // 下游的副本需要重新全量同步。调用方需保证期间没有新的 append()
+  bool reset() {
+    if (!sync()) return false;
+    std::unique_lock<std::mutex> lock(mutex_);
+    wait_idle(lock);
+#if defined(_WIN32)
+    return false;
+#else
+    if (::ftruncate(fd_, 0) != 0) {
+      std::cerr << "Error truncating WAL: " << path_ << std::endl;
+      return false;
+    }
+#endif
+    id_ = make_id();
+    backlog_.clear();
+    backlog_bytes_ = 0;
+    return true;
+  }
+
+  // 写出并同步全部缓冲的记录
+  bool sync() {
+    if (fd_ < 0) return false;
+    std::unique_lock<std::mutex> lock(mutex_);
+    if (!flush_until(lock, appended_, false)) return false;
+    return sync_file();
+  }
+
+  // 检查点：把当前日志并入 old_path 后清空当前日志。
+  // 调用方需保证期间没有新的 append()；
+  // old_path 中的记录在新快照落盘后才能删除
+  bool rotate(const std::string& old_path) {
+    if (!sync()) return false;
+    std::unique_lock<std::mutex> lock(mutex_);
+    wait_idle(lock);
+    close_file();
+    std::error_code ec;
+    bool ok = true;
+    if (std::filesystem::exists(old_path, ec)) {
+      // 上一次检查点没有完成，旧日志仍然需要，把当前日志追加到其后
+      // 追加的内容落盘之后才能清空当前日志
+      if (std::filesystem::file_size(path_, ec) > 0 && !ec) {
+        ok = append_file(path_, old_path);
+      }
+      if (ok && !ec) std::filesystem::resize_file(path_, 0, ec);
+    } else {
+      std::filesystem::rename(path_, old_path, ec);
+    }
+    if (!ok || ec) {
+      std::cerr << "Error rotating WAL: " << path_ << std::endl;
+      // 保留当前日志的全部内容继续追加
+      open_file(std::numeric_limits<std::uint64_t>::max());
+      return false;
+    }
+    return open_file(0);
+  }
+};
@@ -0,0 +1,873 @@
+/**
+ * server.cpp - KVStore<std::string, std::string> 的网络服务（RESP2 协议）
+ *
+ * 兼容 redis-cli / redis-benchmark 及各语言的 Redis 客户端，支持的命令：
+ *   GET key | MGET key... | SET key value [EX s | PX ms] | MSET key value...
+ *   DEL key... | EXISTS key... | SCAN begin end [COUNT n] | DBSIZE
+ *   SAVE | BGSAVE | FLUSHDB | FLUSHALL | PING [msg] | ECHO msg | QUIT
+ *   INFO [replication] | METRICS [RESET]
+ * 以及客户端连接时探测用的 COMMAND / CONFIG GET / SELECT 0。
+ * SCAN 与 Redis 的游标式 SCAN 不同：按 key 升序返回 [begin, end) 内至多
+ * COUNT 条（默认 1000）记录，回复为 key、value 交替排列的数组，
+ * 下一页以最后一个 key 加 "\0" 为 begin 继续。
+ *
+ * 每个线程运行一个 epoll 事件循环，各自的监听 socket 以 SO_REUSEPORT 绑定
+ * 同一端口，由内核在线程间分配连接；所有线程共享同一个 KVStore。
+ * 一次 epoll_wait 返回后先读完所有就绪连接并解析出其中全部完整的请求
+ * （pipelining：客户端不必等待回复即可连续发送），再按轮执行：
+ * 每轮每个连接取出开头连续的同类请求，所有连接的 GET / MGET 合并为一次
+ * multi_get，SET / MSET 合并为一次 multi_put，DEL 以连接为单位调用
+ * multi_del，其余命令逐条执行。同一连接的请求按发送顺序执行、按顺序回复，
+ * 不同连接的请求本来就是并发的，合并后的先后不影响语义。
+ *
+ * 主从复制（见 Replication.h）：--replication-port 使本服务作为主节点，
+ * 在该端口上向副本推送预写日志（需要开启 --wal）；--replicaof=host:port
+ * 使本服务作为该主节点的副本，拒绝写命令，读命令照常执行。
+ * INFO 按 Redis 的字段名报告角色、副本数与复制进度。
+ * METRICS 以 Prometheus 文本格式返回分阶段的延迟直方图（需要以
+ * -DSKIPLIST_METRICS=ON 构建，见 Metrics.h），METRICS RESET 清零。
+ *
+ * 用法示例：
+ *   ./skiplist_server --port=6380 --threads=4 --wal=sync
+ * --help 列出全部参数；SIGINT / SIGTERM 时关闭连接并落盘后退出
+ */
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <netinet/tcp.h>
+#include <pthread.h>
+#include <signal.h>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <unordered_set>
+#include <utility>
+#include <vector>
+
+#include "KVStore.h"
+#include "Metrics.h"
+#include "Replication.h"
+#include "Resp.h"
+
+namespace {
+
+using Store = KVStore<std::string, std::string>;
+using Primary = ReplicationPrimary<std::string, std::string>;
+using StoreReplica = Replica<std::string, std::string>;
+
+struct Config {
+  std::string bind = "0.0.0.0";
+  int port = 6380;
+  int threads = 0;  // 事件循环线程数，0 为 CPU 核数
+  std::string path = "./store/serverFile";
+  std::size_t shards = 16;
+  WalMode wal_mode = WalMode::kOff;
+  std::size_t memory_budget = 0;
+  std::size_t memtable_bytes = 0;
+  int replication_port = 0;  // 0 表示不作为主节点
+  std::size_t replication_backlog = 64 << 20;
+  std::string primary_host;  // 非空时作为副本
+  int primary_port = 0;
+};
+
+// 复制角色，两者至多一个不为空
+struct Roles {
+  Primary* primary = nullptr;
+  StoreReplica* replica = nullptr;
+};
+
+constexpr int kMaxEvents = 256;
+// 每次 recv 的大小与每个连接每轮最多读取的字节数，避免一个连接独占事件循环
+constexpr std::size_t kReadChunk = 64 << 10;
+constexpr std::size_t kReadBudget = 1 << 20;
+// 待发送的回复超过该值时暂停读取该连接，直到客户端取走回复
+constexpr std::size_t kMaxPendingOutput = 64 << 20;
+// SCAN 未指定 COUNT 时返回的条数
+constexpr std::size_t kDefaultScanCount = 1000;
+
+// 可以跨连接合并执行的请求类别
+enum class Kind { kGet, kSet, kDel, kOther };
+
+struct Command {
+  std::size_t arg_begin;  // 在 Connection::args 中的下标
+  std::size_t argc;
+  Kind kind;
+};
+
+struct Connection {
+  int fd = -1;
+  std::uint32_t events = 0;  // 当前在 epoll 中关注的事件
+  std::string in;            // 尚未执行完的输入，args 指向其中
+  std::size_t parsed = 0;    // in 中已解析的字节数
+  std::vector<std::string_view> args;
+  std::vector<Command> commands;
+  std::size_t next = 0;      // 下一条待执行的请求
+  std::string out;
+  std::size_t sent = 0;      // out 中已发送的字节数
+  bool eof = false;          // 对端已关闭写方向
+  bool quit = false;         // 收到 QUIT 或协议错误：发完回复后关闭
+  bool protocol_error = false;
+  bool dead = false;         // 读写出错，立即关闭
+
+  std::size_t pending_output() const { return out.size() - sent; }
+  std::string_view arg(const Command& c, std::size_t i) const {
+    return args[c.arg_begin + i];
+  }
+};
+
+// ASCII 大小写不敏感的比较，target 为小写
+bool is(std::string_view name, std::string_view target) {
+  if (name.size() != target.size()) return false;
+  for (std::size_t i = 0; i < name.size(); ++i) {
+    char c = name[i];
+    if (c >= 'A' && c <= 'Z') c = static_cast<char>(c - 'A' + 'a');
+    if (c != target[i]) return false;
+  }
+  return true;
+}
+
+bool parse_integer(std::string_view s, long long& value) {
+  auto [ptr, ec] = std::from_chars(s.data(), s.data() + s.size(), value);
+  return ec == std::errc() && ptr == s.data() + s.size();
+}
+
+Kind classify(std::string_view name, std::size_t argc) {
+  if ((is(name, "get") && argc == 2) || (is(name, "mget") && argc >= 2)) {
+    return Kind::kGet;
+  }
+  // 带 EX / PX 的 SET 逐条执行
+  if ((is(name, "set") && argc == 3) ||
+      (is(name, "mset") && argc >= 3 && argc % 2 == 1)) {
+    return Kind::kSet;
+  }
+  if (is(name, "del") && argc >= 2) return Kind::kDel;
+  return Kind::kOther;
+}
+
+// 副本上拒绝执行的命令
+bool is_write(std::string_view name) {
+  return is(name, "set") || is(name, "mset") || is(name, "del") ||
+         is(name, "flushdb") || is(name, "flushall");
+}
+
+void put_arity_error(std::string& out, std::string_view name) {
+  std::string message = "ERR wrong number of arguments for '";
+  for (char c : name) {
+    message.push_back(c >= 'A' && c <= 'Z' ? static_cast<char>(c - 'A' + 'a')
+                                           : c);
+  }
+  message.append("' command");
+  resp::put_error(out, message);
+}
+
+class EventLoop {
+ public:
+  EventLoop(Store& store, const Roles& roles, std::atomic<bool>& stop)
+      : store_(store), roles_(roles), stop_(stop), read_buffer_(kReadChunk) {}
+
+  EventLoop(const EventLoop&) = delete;
+  EventLoop& operator=(const EventLoop&) = delete;
+
+  ~EventLoop() {
+    for (auto& [fd, conn] : connections_) ::close(fd);
+    if (listen_fd_ >= 0) ::close(listen_fd_);
+    if (wake_fd_ >= 0) ::close(wake_fd_);
+    if (epoll_fd_ >= 0) ::close(epoll_fd_);
+  }
+
+  bool open(const Config& config) {
+    epoll_fd_ = ::epoll_create1(EPOLL_CLOEXEC);
+    wake_fd_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+    if (epoll_fd_ < 0 || wake_fd_ < 0) {
+      std::cerr << "epoll / eventfd: " << std::strerror(errno) << std::endl;
+      return false;
+    }
+    listen_fd_ = ::socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK | SOCK_CLOEXEC,
+                          0);
+    int one = 1;
+    sockaddr_in addr{};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(static_cast<std::uint16_t>(config.port));
+    if (::inet_pton(AF_INET, config.bind.c_str(), &addr.sin_addr) != 1) {
+      std::cerr << "invalid bind address: " << config.bind << std::endl;
+      return false;
+    }
+    if (listen_fd_ < 0 ||
+        ::setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEADDR, &one,
+                     sizeof(one)) != 0 ||
+        ::setsockopt(listen_fd_, SOL_SOCKET, SO_REUSEPORT, &one,
+                     sizeof(one)) != 0 ||
+        ::bind(listen_fd_, reinterpret_cast<sockaddr*>(&addr),
+               sizeof(addr)) != 0 ||
+        ::listen(listen_fd_, SOMAXCONN) != 0) {
+      std::cerr << "listen on " << config.bind << ":" << config.port << ": "
+                << std::strerror(errno) << std::endl;
+      return false;
+    }
+    // data.ptr 为 nullptr 表示监听 socket，指向 wake_fd_ 表示唤醒
+    return watch(listen_fd_, EPOLLIN, nullptr) &&
+           watch(wake_fd_, EPOLLIN, &wake_fd_);
+  }
+
+  // 在其他线程中调用，使 run() 检查 stop 标志
+  void wake() {
+    std::uint64_t one = 1;
+    [[maybe_unused]] ssize_t n = ::write(wake_fd_, &one, sizeof(one));
+  }
+
+  void run() {
+    epoll_event events[kMaxEvents];
+    std::vector<Connection*> touched;
+    while (!stop_.load(std::memory_order_acquire)) {
+      int n = ::epoll_wait(epoll_fd_, events, kMaxEvents, -1);
+      if (n < 0) {
+        if (errno == EINTR) continue;
+        std::cerr << "epoll_wait: " << std::strerror(errno) << std::endl;
+        return;
+      }
+      touched.clear();
+      for (int i = 0; i < n; ++i) {
+        void* ptr = events[i].data.ptr;
+        if (ptr == nullptr) {
+          accept_all();
+        } else if (ptr != &wake_fd_) {
+          auto* conn = static_cast<Connection*>(ptr);
+          if (events[i].events & EPOLLOUT) flush(*conn);
+          if (events[i].events & (EPOLLIN | EPOLLHUP | EPOLLERR)) {
+            read_input(*conn);
+          }
+          touched.push_back(conn);
+        }
+      }
+      execute(touched);
+      for (Connection* conn : touched) finish(*conn);
+    }
+  }
+
+ private:
+  // 一轮中某个连接开头连续的同类请求 [begin, end)
+  struct Run {
+    Connection* conn;
+    std::size_t begin;
+    std::size_t end;
+    Kind kind;
+  };
+
+  bool watch(int fd, std::uint32_t events, void* ptr) {
+    epoll_event ev{};
+    ev.events = events;
+    ev.data.ptr = ptr;
+    if (::epoll_ctl(epoll_fd_, EPOLL_CTL_ADD, fd, &ev) != 0) {
+      std::cerr << "epoll_ctl: " << std::strerror(errno) << std::endl;
+      return false;
+    }
+    return true;
+  }
+
+  void accept_all() {
+    for (;;) {
+      int fd = ::accept4(listen_fd_, nullptr, nullptr,
+                         SOCK_NONBLOCK | SOCK_CLOEXEC);
+      if (fd < 0) {
+        if (errno == EINTR) continue;
+        // EAGAIN：已全部接受；其他错误（如 EMFILE）留到下次就绪时重试
+        if (errno != EAGAIN && errno != EWOULDBLOCK) {
+          std::cerr << "accept: " << std::strerror(errno) << std::endl;
+        }
+        return;
+      }
+      int one = 1;
+      ::setsockopt(fd, IPPROTO_TCP, TCP_NODELAY, &one, sizeof(one));
+      auto conn = std::make_unique<Connection>();
+      conn->fd = fd;
+      conn->events = EPOLLIN;
+      if (!watch(fd, EPOLLIN, conn.get())) {
+        ::close(fd);
+        continue;
+      }
+      connections_.emplace(fd, std::move(conn));
+    }
+  }
+
+  void read_input(Connection& conn) {
+    if (conn.eof || conn.quit || conn.dead) return;
+    std::size_t budget = kReadBudget;
+    while (budget > 0) {
+      ssize_t n = ::recv(conn.fd, read_buffer_.data(), read_buffer_.size(), 0);
+      if (n > 0) {
+        conn.in.append(read_buffer_.data(), static_cast<std::size_t>(n));
+        budget -= std::min(budget, static_cast<std::size_t>(n));
+        // 没有读满说明内核缓冲区已空，省去一次返回 EAGAIN 的调用
+        if (static_cast<std::size_t>(n) < read_buffer_.size()) break;
+        continue;
+      }
+      if (n == 0) {
+        conn.eof = true;
+      } else if (errno == EINTR) {
+        continue;
+      } else if (errno != EAGAIN && errno != EWOULDBLOCK) {
+        conn.dead = true;
+      }
+      break;
+    }
+    parse(conn);
+  }
+
+  void parse(Connection& conn) {
+    const char* data = conn.in.data();
+    const char* end = data + conn.in.size();
+    while (!conn.protocol_error) {
+      std::size_t first = conn.args.size();
+      std::size_t consumed = 0;
+      resp::Parse r = resp::parse_command(data + conn.parsed, end, conn.args,
+                                          consumed);
+      if (r == resp::Parse::kIncomplete) break;
+      if (r == resp::Parse::kError) {
+        conn.protocol_error = true;
+        break;
+      }
+      conn.parsed += consumed;
+      std::size_t argc = conn.args.size() - first;
+      if (argc == 0) continue;  // 空的内联命令
+      Kind kind = classify(conn.args[first], argc);
+      // 副本的写命令由 run_other 回复错误
+      if (roles_.replica != nullptr && kind != Kind::kGet) kind = Kind::kOther;
+      conn.commands.push_back({first, argc, kind});
+    }
+  }
+
+  void execute(const std::vector<Connection*>& touched) {
+    std::vector<Run> runs;
+    for (;;) {
+      runs.clear();
+      for (Connection* conn : touched) {
+        if (conn->quit || conn->next == conn->commands.size()) continue;
+        std::size_t end = conn->next + 1;
+        Kind kind = conn->commands[conn->next].kind;
+        if (kind != Kind::kOther) {
+          while (end < conn->commands.size() &&
+                 conn->commands[end].kind == kind) {
+            ++end;
+          }
+        }
+        runs.push_back({conn, conn->next, end, kind});
+      }
+      if (runs.empty()) return;
+      run_gets(runs);
+      run_sets(runs);
+      for (const Run& run : runs) {
+        if (run.kind == Kind::kDel) run_del(run);
+        if (run.kind == Kind::kOther) run_other(*run.conn, run.begin);
+      }
+      for (const Run& run : runs) {
+        if (!run.conn->quit) run.conn->next = run.end;
+      }
+    }
+  }
+
+  void run_gets(const std::vector<Run>& runs) {
+    keys_.clear();
+    for (const Run& run : runs) {
+      if (run.kind != Kind::kGet) continue;
+      for (std::size_t i = run.begin; i < run.end; ++i) {
+        const Command& c = run.conn->commands[i];
+        for (std::size_t a = 1; a < c.argc; ++a) {
+          keys_.emplace_back(run.conn->arg(c, a));
+        }
+      }
+    }
+    if (keys_.empty()) return;
+    std::vector<std::optional<std::string>> values = store_.multi_get(keys_);
+    std::size_t pos = 0;
+    for (const Run& run : runs) {
+      if (run.kind != Kind::kGet) continue;
+      std::string& out = run.conn->out;
+      for (std::size_t i = run.begin; i < run.end; ++i) {
+        const Command& c = run.conn->commands[i];
+        bool multi = is(run.conn->arg(c, 0), "mget");
+        if (multi) resp::put_array(out, c.argc - 1);
+        for (std::size_t a = 1; a < c.argc; ++a) {
+          const auto& value = values[pos++];
+          if (value) {
+            resp::put_bulk(out, *value);
+          } else {
+            resp::put_null(out);
+          }
+        }
+      }
+    }
+  }
+
+  void run_sets(const std::vector<Run>& runs) {
+    entries_.clear();
+    for (const Run& run : runs) {
+      if (run.kind != Kind::kSet) continue;
+      for (std::size_t i = run.begin; i < run.end; ++i) {
+        const Command& c = run.conn->commands[i];
+        for (std::size_t a = 1; a + 1 < c.argc; a += 2) {
+          entries_.emplace_back(run.conn->arg(c, a), run.conn->arg(c, a + 1));
+        }
+        resp::put_simple(run.conn->out, "OK");
+      }
+    }
+    // 同一连接的请求按顺序排列，multi_put 中重复的 key 以最后一个为准
+    if (!entries_.empty()) store_.multi_put(entries_);
+  }
+
+  // DEL 回复实际删除的个数，要先查询 key 是否存在；以连接为单位执行，
+  // 同一 key 在一个连接的多条 DEL 中只计一次
+  void run_del(const Run& run) {
+    keys_.clear();
+    std::unordered_set<std::string_view> removed;
+    for (std::size_t i = run.begin; i < run.end; ++i) {
+      const Command& c = run.conn->commands[i];
+      long long count = 0;
+      for (std::size_t a = 1; a < c.argc; ++a) {
+        std::string_view key = run.conn->arg(c, a);
+        if (removed.insert(key).second && exists(key)) ++count;
+        keys_.emplace_back(key);
+      }
+      resp::put_integer(run.conn->out, count);
+    }
+    store_.multi_del(keys_);
+  }
+
+  bool exists(std::string_view key) {
+    return store_.read(key, [](const std::string&) {});
+  }
+
+  void run_other(Connection& conn, std::size_t index) {
+    const Command& c = conn.commands[index];
+    std::string_view name = conn.arg(c, 0);
+    std::string& out = conn.out;
+    auto arity = [&](bool ok) {
+      if (!ok) put_arity_error(out, name);
+      return ok;
+    };
+    if (roles_.replica != nullptr && is_write(name)) {
+      resp::put_error(out, "READONLY You can't write against a read only "
+                           "replica.");
+    } else if (is(name, "get") || is(name, "mget") || is(name, "mset") ||
+               is(name, "del")) {
+      // 参数个数正确的已在 classify 中归入可合并的类别
+      put_arity_error(out, name);
+    } else if (is(name, "set")) {
+      if (arity(c.argc >= 3)) set_with_options(conn, c);
+    } else if (is(name, "exists")) {
+      if (!arity(c.argc >= 2)) return;
+      long long count = 0;
+      for (std::size_t a = 1; a < c.argc; ++a) count += exists(conn.arg(c, a));
+      resp::put_integer(out, count);
+    } else if (is(name, "scan")) {
+      scan(conn, c);
+    } else if (is(name, "dbsize")) {
+      resp::put_integer(out, static_cast<long long>(store_.size()));
+    } else if (is(name, "ping")) {
+      if (!arity(c.argc <= 2)) return;
+      if (c.argc == 2) {
+        resp::put_bulk(out, conn.arg(c, 1));
+      } else {
+        resp::put_simple(out, "PONG");
+      }
+    } else if (is(name, "echo")) {
+      if (arity(c.argc == 2)) resp::put_bulk(out, conn.arg(c, 1));
+    } else if (is(name, "save")) {
+      if (store_.dump()) {
+        resp::put_simple(out, "OK");
+      } else {
+        resp::put_error(out, "ERR snapshot failed");
+      }
+    } else if (is(name, "bgsave")) {
+      if (store_.dump_async()) {
+        resp::put_simple(out, "Background saving started");
+      } else {
+        resp::put_error(out, "ERR Background save already in progress");
+      }
+    } else if (is(name, "flushdb") || is(name, "flushall")) {
+      store_.clear();
+      resp::put_simple(out, "OK");
+    } else if (is(name, "info")) {
+      if (arity(c.argc <= 2)) resp::put_bulk(out, info());
+    } else if (is(name, "metrics")) {
+      if (c.argc == 1) {
+        resp::put_bulk(out, metrics::Registry::shared().prometheus_text());
+      } else if (c.argc == 2 && is(conn.arg(c, 1), "reset")) {
+        metrics::Registry::shared().reset();
+        resp::put_simple(out, "OK");
+      } else {
+        resp::put_error(out, "ERR syntax error, expected METRICS [RESET]");
+      }
+    } else if (is(name, "select")) {
+      if (!arity(c.argc == 2)) return;
+      if (conn.arg(c, 1) == "0") {
+        resp::put_simple(out, "OK");
+      } else {
+        resp::put_error(out, "ERR DB index is out of range");
+      }
+    } else if (is(name, "command") || is(name, "config")) {
+      // 客户端连接时的探测：没有可报告的命令表与配置项
+      resp::put_array(out, 0);
+    } else if (is(name, "quit")) {
+      resp::put_simple(out, "OK");
+      conn.quit = true;
+    } else {
+      std::string message = "ERR unknown command '";
+      message.append(name.substr(0, 128));
+      message.append("'");
+      resp::put_error(out, message);
+    }
+  }
+
+  // 只有 replication 一节，字段名与 Redis 相同，便于已有的工具解析
+  std::string info() const {
+    std::string s = "# Replication\r\n";
+    auto field = [&s](std::string_view name, const std::string& value) {
+      s.append(name);
+      s.push_back(':');
+      s.append(value);
+      s.append("\r\n");
+    };
+    if (roles_.replica != nullptr) {
+      const StoreReplica& r = *roles_.replica;
+      field("role", "slave");
+      field("master_link_status", r.connected() ? "up" : "down");
+      field("master_repl_offset", std::to_string(r.primary_seq()));
+      field("slave_repl_offset", std::to_string(r.applied_seq()));
+    } else {
+      field("role", "master");
+      field("connected_slaves",
+            std::to_string(roles_.primary ? roles_.primary->replica_count()
+                                          : 0));
+      field("master_repl_id", std::to_string(store_.replication_id()));
+    }
+    return s;
+  }
+
+  // SET key value [EX seconds | PX milliseconds]
+  void set_with_options(Connection& conn, const Command& c) {
+    std::optional<std::chrono::milliseconds> ttl;
+    for (std::size_t a = 3; a < c.argc; a += 2) {
+      long long n = 0;
+      std::string_view option = conn.arg(c, a);
+      if (a + 1 >= c.argc || !(is(option, "ex") || is(option, "px")) ||
+          ttl.has_value()) {
+        resp::put_error(conn.out, "ERR syntax error");
+        return;
+      }
+      // 与 Redis 一样拒绝换算成毫秒、或加上当前时间后会溢出的值
+      const long long scale = is(option, "ex") ? 1000 : 1;
+      const long long limit = std::numeric_limits<long long>::max() -
+                              ExpiryIndex<std::string>::now();
+      if (!parse_integer(conn.arg(c, a + 1), n) || n <= 0 ||
+          n > limit / scale) {
+        resp::put_error(conn.out, "ERR invalid expire time in 'set' command");
+        return;
+      }
+      ttl = std::chrono::milliseconds(n * scale);
+    }
+    std::string key(conn.arg(c, 1));
+    std::string value(conn.arg(c, 2));
+    if (ttl) {
+      store_.put(std::move(key), std::move(value), *ttl);
+    } else {
+      store_.put(std::move(key), std::move(value));
+    }
+    resp::put_simple(conn.out, "OK");
+  }
+
+  // SCAN begin end [COUNT n]
+  void scan(Connection& conn, const Command& c) {
+    long long count = kDefaultScanCount;
+    if (c.argc != 3 && !(c.argc == 5 && is(conn.arg(c, 3), "count"))) {
+      resp::put_error(conn.out, "ERR syntax error, expected SCAN begin end "
+                                "[COUNT n]");
+      return;
+    }
+    if (c.argc == 5 && (!parse_integer(conn.arg(c, 4), count) || count <= 0)) {
+      resp::put_error(conn.out, "ERR value is not an integer or out of range");
+      return;
+    }
+    // 回复的元素个数在访问结束后才知道，先写到临时缓冲区
+    scan_buffer_.clear();
+    std::size_t n = store_.scan(
+        std::string(conn.arg(c, 1)), std::string(conn.arg(c, 2)),
+        static_cast<std::size_t>(count),
+        [this](const std::string& key, const std::string& value) {
+          resp::put_bulk(scan_buffer_, key);
+          resp::put_bulk(scan_buffer_, value);
+        });
+    resp::put_array(conn.out, n * 2);
+    conn.out.append(scan_buffer_);
+  }
+
+  void flush(Connection& conn) {
+    while (conn.pending_output() > 0) {
+      ssize_t n = ::send(conn.fd, conn.out.data() + conn.sent,
+                         conn.pending_output(), MSG_NOSIGNAL);
+      if (n >= 0) {
+        conn.sent += static_cast<std::size_t>(n);
+        continue;
+      }
+      if (errno == EINTR) continue;
+      if (errno != EAGAIN && errno != EWOULDBLOCK) conn.dead = true;
+      break;
+    }
+    if (conn.pending_output() == 0) {
+      conn.out.clear();
+      conn.sent = 0;
+    }
+  }
+
+  // 本轮结束：丢弃已执行的输入，发送回复，更新关注的事件或关闭连接
+  void finish(Connection& conn) {
+    if (conn.parsed > 0) {
+      conn.in.erase(0, conn.parsed);
+      conn.parsed = 0;
+    }
+    conn.args.clear();
+    conn.commands.clear();
+    conn.next = 0;
+    if (conn.protocol_error && !conn.quit) {
+      resp::put_error(conn.out, "ERR Protocol error");
+      conn.quit = true;
+    }
+    if (!conn.dead) flush(conn);
+    bool done = conn.eof || conn.quit;
+    if (conn.dead || (done && conn.pending_output() == 0)) {
+      close(conn);
+      return;
+    }
+    std::uint32_t events = 0;
+    if (!done && conn.pending_output() < kMaxPendingOutput) events |= EPOLLIN;
+    if (conn.pending_output() > 0) events |= EPOLLOUT;
+    if (events != conn.events) {
+      epoll_event ev{};
+      ev.events = events;
+      ev.data.ptr = &conn;
+      ::epoll_ctl(epoll_fd_, EPOLL_CTL_MOD, conn.fd, &ev);
+      conn.events = events;
+    }
+  }
+
+  void close(Connection& conn) {
+    int fd = conn.fd;
+    ::epoll_ctl(epoll_fd_, EPOLL_CTL_DEL, fd, nullptr);
+    ::close(fd);
+    connections_.erase(fd);
+  }
+
+  Store& store_;
+  const Roles& roles_;
+  std::atomic<bool>& stop_;
+  int epoll_fd_ = -1;
+  int listen_fd_ = -1;
+  int wake_fd_ = -1;
+  std::unordered_map<int, std::unique_ptr<Connection>> connections_;
+  std::vector<char> read_buffer_;
+  // 合并执行时复用的缓冲区
+  std::vector<std::string> keys_;
+  std::vector<std::pair<std::string, std::string>> entries_;
+  std::string scan_buffer_;
+};
+
+// ---------- 命令行 ----------
+
+void print_usage(const char* prog) {
+  std::cout
+      << "Usage: " << prog << " [options]\n"
+      << "  --bind=ADDR        IPv4 address to listen on (default 0.0.0.0)\n"
+      << "  --port=N           TCP port (default 6380)\n"
+      << "  --threads=N        event loop threads (default: number of"
+         " cores)\n"
+      << "  --path=PATH        snapshot file (default ./store/serverFile)\n"
+      << "  --shards=N         KVStore shard count (default 16)\n"
+      << "  --wal=MODE         off, nosync, sync, periodic, async"
+         " (default off)\n"
+      << "  --memory-budget=N  bytes kept in memory, 0 for unlimited\n"
+      << "  --memtable-bytes=N enable tiered storage with this memtable"
+         " size\n"
+      << "  --replication-port=N\n"
+      << "                     serve replicas on this port (needs --wal)\n"
+      << "  --replication-backlog=N\n"
+      << "                     bytes of recent WAL kept for partial resync"
+         " (default 64MB)\n"
+      << "  --replicaof=HOST:PORT\n"
+      << "                     run as a read-only replica of that primary\n";
+}
+
+bool parse_args(int argc, char* argv[], Config& config) {
+  for (int i = 1; i < argc; ++i) {
+    std::string arg = argv[i];
+    std::size_t eq = arg.find('=');
+    std::string name = arg.substr(0, eq);
+    std::string value = eq == std::string::npos ? "" : arg.substr(eq + 1);
+    if (name == "--help" || name == "-h") {
+      print_usage(argv[0]);
+      std::exit(0);
+    } else if (name == "--bind") {
+      config.bind = value;
+    } else if (name == "--port") {
+      config.port = std::atoi(value.c_str());
+    } else if (name == "--threads") {
+      config.threads = std::atoi(value.c_str());
+    } else if (name == "--path") {
+      config.path = value;
+    } else if (name == "--shards") {
+      config.shards = std::strtoull(value.c_str(), nullptr, 10);
+    } else if (name == "--wal") {
+      if (value == "off") {
+        config.wal_mode = WalMode::kOff;
+      } else if (value == "nosync") {
+        config.wal_mode = WalMode::kNoSync;
+      } else if (value == "sync") {
+        config.wal_mode = WalMode::kSync;
+      } else if (value == "periodic") {
+        config.wal_mode = WalMode::kPeriodic;
+      } else if (value == "async") {
+        config.wal_mode = WalMode::kAsync;
+      } else {
+        std::cerr << "unknown wal mode: " << value << std::endl;
+        return false;
+      }
+    } else if (name == "--memory-budget") {
+      config.memory_budget = std::strtoull(value.c_str(), nullptr, 10);
+    } else if (name == "--memtable-bytes") {
+      config.memtable_bytes = std::strtoull(value.c_str(), nullptr, 10);
+    } else if (name == "--replication-port") {
+      config.replication_port = std::atoi(value.c_str());
+    } else if (name == "--replication-backlog") {
+      config.replication_backlog = std::strtoull(value.c_str(), nullptr, 10);
+    } else if (name == "--replicaof") {
+      std::size_t colon = value.rfind(':');
+      if (colon == std::string::npos) {
+        std::cerr << "--replicaof expects HOST:PORT" << std::endl;
+        return false;
+      }
+      config.primary_host = value.substr(0, colon);
+      config.primary_port = std::atoi(value.c_str() + colon + 1);
+    } else {
+      std::cerr << "unknown option: " << arg << std::endl;
+      return false;
+    }
+  }
+  if (config.threads <= 0) {
+    config.threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+  if (config.port <= 0 || config.port > 65535 || config.shards == 0) {
+    std::cerr << "--port must be in [1, 65535] and --shards positive"
+              << std::endl;
+    return false;
+  }
+  if (config.replication_port != 0 && !config.primary_host.empty()) {
+    std::cerr << "--replication-port and --replicaof are exclusive"
+              << std::endl;
+    return false;
+  }
+  if (config.replication_port != 0 &&
+      (config.wal_mode == WalMode::kOff || config.memtable_bytes != 0 ||
+       config.replication_backlog == 0)) {
+    std::cerr << "--replication-port needs --wal, a positive "
+                 "--replication-backlog and no --memtable-bytes"
+              << std::endl;
+    return false;
+  }
+  if (!config.primary_host.empty() &&
+      (config.memtable_bytes != 0 || config.primary_port <= 0)) {
+    std::cerr << "--replicaof needs a valid port and no --memtable-bytes"
+              << std::endl;
+    return false;
+  }
+  return true;
+}
+
+}  // namespace
+
+int main(int argc, char* argv[]) {
+  Config config;
+  if (!parse_args(argc, argv, config)) {
+    print_usage(argv[0]);
+    return 1;
+  }
+  // 在创建任何线程之前屏蔽退出信号，由主线程 sigwait 接收
+  sigset_t signals;
+  sigemptyset(&signals);
+  sigaddset(&signals, SIGINT);
+  sigaddset(&signals, SIGTERM);
+  pthread_sigmask(SIG_BLOCK, &signals, nullptr);
+
+  // 带指标构建时记录快照、落盘、合并与加载的耗时，从加载开始
+  if (metrics::kEnabled) {
+    metrics::Registry::shared().set_trace_sink(
+        [](const metrics::TraceEvent& e) {
+          if (e.begin) return;
+          std::cout << metrics::kSpanNames[static_cast<int>(e.span)] << " "
+                    << e.path << (e.ok ? " done in " : " failed after ")
+                    << e.duration.count() / 1e6 << " ms, " << e.records
+                    << " records" << std::endl;
+        });
+  }
+
+  KVStoreOptions<std::string> options;
+  options.shard_count = config.shards;
+  options.wal_mode = config.wal_mode;
+  options.memory_budget = config.memory_budget;
+  options.memtable_bytes = config.memtable_bytes;
+  if (config.replication_port != 0) {
+    options.replication_backlog = config.replication_backlog;
+  }
+  Store store(config.path, options);
+
+  // 在事件循环之前启动、之后停止，二者都要在 store 析构之前停止
+  std::unique_ptr<Primary> primary;
+  std::unique_ptr<StoreReplica> replica;
+  if (config.replication_port != 0) {
+    primary = std::make_unique<Primary>(store);
+    if (!primary->start(config.bind, config.replication_port)) return 1;
+  } else if (!config.primary_host.empty()) {
+    replica = std::make_unique<StoreReplica>(store, config.primary_host,
+                                             config.primary_port);
+    replica->start();
+  }
+  Roles roles{primary.get(), replica.get()};
+
+  std::atomic<bool> stop{false};
+  std::vector<std::unique_ptr<EventLoop>> loops;
+  for (int i = 0; i < config.threads; ++i) {
+    loops.push_back(std::make_unique<EventLoop>(store, roles, stop));
+    if (!loops.back()->open(config)) return 1;
+  }
+  std::vector<std::thread> threads;
+  for (auto& loop : loops) threads.emplace_back([&loop] { loop->run(); });
+  std::cout << "listening on " << config.bind << ":" << config.port << " with "
+            << config.threads << " event loop(s), " << store.size()
+            << " records loaded" << std::endl;
+
+  int sig = 0;
+  sigwait(&signals, &sig);
+  std::cout << "signal " << sig << " received, shutting down" << std::endl;
+  stop.store(true, std::memory_order_release);
+  for (auto& loop : loops) loop->wake();
+  for (auto& t : threads) t.join();
+  loops.clear();
+  if (primary) primary->stop();
+  if (replica) replica->stop();
+  return 0;  // store 析构时落盘
+}
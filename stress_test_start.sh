@@ -1,3 +1,5 @@
 #!/bin/bash
-g++ stress-test/stress_test.cpp -o ./bin/stress  --std=c++17 -pthread  
-./bin/stress
+# 编译并运行基准测试，参数原样传给 skiplist_bench（--help 查看全部参数）
+mkdir -p ./bin
+g++ benchmark/benchmark.cpp -o ./bin/skiplist_bench -I./include --std=c++20 -O2 -pthread
+./bin/skiplist_bench "$@"